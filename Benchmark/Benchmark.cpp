@@ -0,0 +1,565 @@
+#include "DocumentWriter.h"
+#include "LineScanner.h"
+#include "LineStore.h"
+#include "NodePool.h"
+#include "StoreBenchmark.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+const char *TEMP_PATH = "benchmark_output.tmp";
+
+// The heap memory in use, as counted by the allocation functions below.
+static long long heapBytes = 0;
+
+/**
+	Gets the size of a heap block, including what the allocator rounded it up to.
+	@param memory The block.
+	@returns The size in bytes.
+*/
+static size_t blockSize(void *memory) {
+#ifdef _WIN32
+	return _msize(memory);
+#else
+	return malloc_usable_size(memory);
+#endif
+}
+
+/*
+	Replacements for the global allocation functions that keep track of the heap
+	memory in use, for the memory benchmark. The array and sized forms forward to
+	these.
+*/
+void* operator new(size_t size) {
+	void *memory = malloc(size > 0 ? size : 1);
+
+	if (memory == NULL) {
+		throw bad_alloc();
+	}
+
+	heapBytes += blockSize(memory);
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	if (memory != NULL) {
+		heapBytes -= blockSize(memory);
+		free(memory);
+	}
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+// The layouts the stores used before lines were made compact: a std::string per
+// node, plus a view into the loaded file for the rope.
+struct StringNode
+{
+public:
+	StringNode() : next(NULL) {}
+
+	string data;
+	StringNode *next;
+};
+
+struct StringRopeNode
+{
+public:
+	StringRopeNode() : view(NULL), viewLength(0), left(NULL), right(NULL), priority(0), count(1) {}
+
+	string data;
+	const char *view;
+	size_t viewLength;
+	StringRopeNode *left;
+	StringRopeNode *right;
+	unsigned int priority;
+	int count;
+};
+
+/**
+	Builds a document of log-like lines of varying length.
+	@param numLines The number of lines to generate.
+	@param lines Receives the lines.
+*/
+void generateLines(int numLines, LineSnapshot& lines) {
+	unsigned int seed = 12345;
+
+	lines.clear();
+
+	for (int i = 0; i < numLines; i++) {
+		seed = seed * 1103515245 + 12345;
+		string line = "2024-01-01 12:00:00 INFO worker-" + to_string(seed % 64)
+			+ " processed request " + to_string(i) + string((seed >> 16) % 48, 'x');
+		lines.addCopy(line);
+	}
+}
+
+/**
+	Prints one result line of the save benchmark, as tab separated key=value fields:
+	the name of the method, the bytes written and the throughput.
+	@param name The name of the method measured.
+	@param numLines The number of lines written.
+	@param bytes The number of bytes written.
+	@param seconds The time taken.
+*/
+void report(string name, int numLines, long long bytes, double seconds) {
+	cout << "suite=save\tmethod=" << name << "\tlines=" << numLines << "\tbytes=" << bytes << "\tseconds=" << seconds
+		<< "\tMB/s=" << (seconds > 0 ? bytes / seconds / (1024 * 1024) : 0) << endl;
+}
+
+/**
+	Gets the size of the file written by the last benchmark.
+	@returns The size in bytes.
+*/
+long long outputSize() {
+	ifstream in(TEMP_PATH, ios::binary | ios::ate);
+	return (long long)in.tellg();
+}
+
+/**
+	The save path as it was: one endl, and therefore one flush, per line.
+	@param lines The lines to save.
+	@returns The time taken, in seconds.
+*/
+double saveWithEndl(LineSnapshot& lines) {
+	auto start = chrono::steady_clock::now();
+	ofstream out(TEMP_PATH);
+
+	for (size_t i = 0; i < lines.lines.size(); i++) {
+		out.write(lines.lines[i].text, lines.lines[i].length);
+		if (i + 1 < lines.lines.size()) {
+			out << endl;
+		}
+	}
+	out.close();
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/**
+	The save path through a buffered ofstream without flushes.
+	@param lines The lines to save.
+	@returns The time taken, in seconds.
+*/
+double saveWithStream(LineSnapshot& lines) {
+	auto start = chrono::steady_clock::now();
+	ofstream out(TEMP_PATH);
+
+	for (size_t i = 0; i < lines.lines.size(); i++) {
+		out.write(lines.lines[i].text, lines.lines[i].length);
+		if (i + 1 < lines.lines.size()) {
+			out << '\n';
+		}
+	}
+	out.close();
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/**
+	The save path used by the editor.
+	@param lines The lines to save.
+	@returns The time taken, in seconds.
+*/
+double saveWithDocumentWriter(LineSnapshot& lines) {
+	auto start = chrono::steady_clock::now();
+	DocumentWriter writer;
+
+	writer.open(TEMP_PATH);
+	writer.writeLines(lines.lines.data(), lines.lines.size());
+	writer.close();
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/**
+	Prints one result line of the scan benchmark, as tab separated key=value fields:
+	the name of the method, the number of lines found and the throughput.
+	@param name The name of the method measured.
+	@param numLines The number of lines found.
+	@param bytes The number of bytes scanned.
+	@param seconds The time taken.
+*/
+void reportScan(string name, size_t numLines, long long bytes, double seconds) {
+	cout << "suite=scan\tmethod=" << name << "\tlines=" << numLines << "\tbytes=" << bytes << "\tseconds=" << seconds
+		<< "\tGB/s=" << (seconds > 0 ? bytes / seconds / (1024 * 1024 * 1024) : 0) << endl;
+}
+
+/**
+	The line splitting path as it was: getline over a stream.
+	@param text The document.
+	@param numLines Receives the number of lines found.
+	@returns The time taken, in seconds.
+*/
+double scanWithGetline(const string& text, size_t& numLines) {
+	auto start = chrono::steady_clock::now();
+	istringstream in(text);
+	string line;
+
+	numLines = 0;
+	while (getline(in, line)) {
+		numLines++;
+	}
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/**
+	Builds a line index with one of the scanner implementations.
+	@param text The document.
+	@param method The scanner implementation.
+	@param numLines Receives the number of lines found.
+	@returns The time taken, in seconds.
+*/
+double scanWithLineScanner(const string& text, ScanMethod method, size_t& numLines) {
+	auto start = chrono::steady_clock::now();
+	LineIndex index;
+
+	index.build(text.data(), text.size(), method);
+	numLines = index.size();
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+/**
+	Builds one line of a document for the memory benchmark.
+	@param document "log" for log lines of 40 to 90 characters, or "short" for lines
+	of up to 30 characters, such as code or CSV.
+	@param i The number of the line.
+	@param line Receives the line.
+*/
+void makeMemoryLine(const string& document, int i, string& line) {
+	unsigned int seed = (unsigned int)i * 2654435761u;
+
+	seed ^= seed >> 15;
+
+	if (document == "log") {
+		line = "2024-01-01 12:00:00 INFO worker-" + to_string(seed % 64) + " request " + to_string(i);
+		line.append(seed % 40, 'x');
+	}
+	else {
+		line.assign(seed % 31, ' ');
+
+		for (size_t j = 0; j < line.size(); j++) {
+			line[j] = "abcdefghij ;(){}=,"[(seed >> (j % 24)) % 18];
+		}
+	}
+}
+
+/**
+	Prints one result line of the memory benchmark, as tab separated key=value fields.
+	@param document The kind of lines.
+	@param layout The line layout measured.
+	@param numLines The number of lines held.
+	@param textBytes The number of characters in the lines.
+	@param bytes The heap memory the lines took.
+	@param baseline The heap memory the lines took in the std::string per node
+	linked list, which the saving is reported against.
+*/
+void reportMemory(string document, string layout, int numLines, long long textBytes, long long bytes, long long baseline) {
+	cout << "suite=memory\tdocument=" << document << "\tlayout=" << layout << "\tlines=" << numLines
+		<< "\ttext_bytes=" << textBytes << "\tbytes=" << bytes
+		<< "\tbytes/line=" << (double)bytes / numLines
+		<< "\toverhead/line=" << (double)(bytes - textBytes) / numLines
+		<< "\tsaved_bytes=" << baseline - bytes
+		<< "\tsaved%=" << (baseline > 0 ? 100.0 * (baseline - bytes) / baseline : 0) << endl;
+}
+
+/**
+	Measures the heap memory taken by the lines of a document in a layout that
+	stores a std::string per node, as the stores did before lines were made compact.
+	@param document The kind of lines.
+	@param numLines The number of lines.
+	@param textBytes Receives the number of characters in the lines.
+	@returns The memory taken, in bytes.
+*/
+template <typename T>
+long long measureStringNodes(const string& document, int numLines, long long& textBytes) {
+	NodePool<T> pool;
+	vector<T*> nodes;
+	long long before;
+	long long bytes;
+	string line;
+
+	// the vector only keeps the nodes so they can be destroyed; it is not counted
+	nodes.reserve(numLines);
+	line.reserve(128);
+	before = heapBytes;
+	textBytes = 0;
+
+	for (int i = 0; i < numLines; i++) {
+		makeMemoryLine(document, i, line);
+		nodes.push_back(pool.create());
+		nodes.back()->data = line;
+		textBytes += line.size();
+	}
+
+	bytes = heapBytes - before;
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		pool.destroy(nodes[i]);
+	}
+
+	return bytes;
+}
+
+/**
+	Measures the heap memory taken by the lines of a document in a line store.
+	@param document The kind of lines.
+	@param type The store.
+	@param numLines The number of lines.
+	@param textBytes Receives the number of characters in the lines.
+	@returns The memory taken, in bytes.
+*/
+long long measureStore(const string& document, StoreType type, int numLines, long long& textBytes) {
+	LineStore *store = LineStore::create(type);
+	long long before;
+	long long bytes;
+	string line;
+
+	line.reserve(128);
+	before = heapBytes;
+	textBytes = 0;
+
+	// inserted into the linked list at the front, last first, since add walks the
+	// whole list; paged stores only append cheaply
+	for (int n = 0; n < numLines; n++) {
+		int i = type == LINKED_LIST_STORE ? numLines - 1 - n : n;
+
+		makeMemoryLine(document, i, line);
+		if (type == LINKED_LIST_STORE) {
+			store->insertAt(0, line);
+		}
+		else {
+			store->add(line);
+		}
+		textBytes += line.size();
+	}
+
+	bytes = heapBytes - before;
+	delete store;
+
+	return bytes;
+}
+
+/**
+	Compares the heap memory taken by the lines of a document in the compact line
+	stores, and in the compressed store with its default cache, with the
+	std::string per node layout they replaced.
+	@param numLines The number of lines in each document.
+*/
+void runMemorySuite(int numLines) {
+	const char *documents[] = { "log", "short" };
+	long long textBytes;
+	long long bytes;
+	long long baseline;
+
+	cout << "# memory benchmark, " << numLines << " lines" << endl;
+
+	for (const char *document : documents) {
+		baseline = measureStringNodes<StringNode>(document, numLines, textBytes);
+		reportMemory(document, "list/string", numLines, textBytes, baseline, baseline);
+
+		bytes = measureStore(document, LINKED_LIST_STORE, numLines, textBytes);
+		reportMemory(document, "list/compact", numLines, textBytes, bytes, baseline);
+
+		bytes = measureStringNodes<StringRopeNode>(document, numLines, textBytes);
+		reportMemory(document, "rope/string", numLines, textBytes, bytes, baseline);
+
+		bytes = measureStore(document, ROPE_STORE, numLines, textBytes);
+		reportMemory(document, "rope/compact", numLines, textBytes, bytes, baseline);
+
+		bytes = measureStore(document, COMPRESSED_STORE, numLines, textBytes);
+		reportMemory(document, "compressed", numLines, textBytes, bytes, baseline);
+	}
+}
+
+/**
+	Compares the ways of saving a document.
+	@param lines The document.
+*/
+void runSaveSuite(LineSnapshot& lines) {
+	int numLines = (int)lines.lines.size();
+
+	cout << "# save benchmark, " << numLines << " lines" << endl;
+
+	double seconds = saveWithEndl(lines);
+	report("ofstream+endl", numLines, outputSize(), seconds);
+
+	seconds = saveWithStream(lines);
+	report("ofstream", numLines, outputSize(), seconds);
+
+	seconds = saveWithDocumentWriter(lines);
+	report("DocumentWriter", numLines, outputSize(), seconds);
+
+	remove(TEMP_PATH);
+}
+
+/**
+	Compares the ways of splitting a document into lines.
+	@param lines The document.
+*/
+void runScanSuite(LineSnapshot& lines) {
+	string text;
+	size_t numFound = 0;
+	ScanMethod methods[] = { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+
+	for (size_t i = 0; i < lines.lines.size(); i++) {
+		text.append(lines.lines[i].text, lines.lines[i].length);
+		text += '\n';
+	}
+	cout << "# scan benchmark, " << text.size() << " bytes" << endl;
+
+	double seconds = scanWithGetline(text, numFound);
+	reportScan("getline", numFound, text.size(), seconds);
+
+	for (ScanMethod method : methods) {
+		if (LineScanner::isSupported(method)) {
+			seconds = scanWithLineScanner(text, method, numFound);
+			reportScan(string("LineScanner/") + LineScanner::methodName(method), numFound, text.size(), seconds);
+		}
+	}
+}
+
+/**
+	Measures the operations of a line store at every power of ten from 10^3 lines
+	up to a maximum.
+	@param storeName The store to measure: "list", "rope", "paged", "compressed" or
+	"all".
+	@param maxLines The largest number of lines to measure.
+	@param budget The longest time to spend on one measurement, in seconds.
+	@param maxOps The most operations to run in one measurement.
+*/
+void runStoreSuite(string storeName, int maxLines, double budget, int maxOps) {
+	// The indexed list measures deleteValue and insertAfterValue through the value
+	// index, against the plain list's linear scan.
+	const char *names[] = { "list", "list", "rope", "paged", "compressed" };
+	const char *resultNames[] = { "list", "list+index", "rope", "paged", "compressed" };
+	const bool indexValues[] = { false, true, false, false, false };
+
+	cout << "# store benchmark, up to " << maxLines << " lines, " << budget << " s per measurement" << endl;
+
+	for (int i = 0; i < 5; i++) {
+		StoreType type;
+
+		if (storeName != "all" && storeName != names[i]) {
+			continue;
+		}
+		LineStore::parseStoreType(names[i], type);
+
+		StoreBenchmark benchmark(type, resultNames[i], indexValues[i], budget, maxOps);
+
+		for (long long numLines = 1000; numLines <= maxLines; numLines *= 10) {
+			benchmark.run((int)numLines);
+		}
+	}
+}
+
+/**
+	Prints the command line options.
+	@param program The name the program was started with.
+*/
+void printUsage(const char *program) {
+	cerr << "usage: " << program << " [options]" << endl
+		<< "  --suite=save|scan|store|memory|all  the benchmarks to run (default all)" << endl
+		<< "  --lines=N                           lines in the save and scan documents (default 1000000)" << endl
+		<< "  --max-lines=N                       largest store measured, from 1000 up by tens (default 10000000)" << endl
+		<< "  --store=list|rope|paged|compressed|all" << endl
+		<< "                                      the stores measured (default all)" << endl
+		<< "  --budget=MS                         longest time per store measurement (default 200)" << endl
+		<< "  --max-ops=N                         most operations per store measurement (default 1000000)" << endl
+		<< "  --memory-lines=N                    lines in the memory documents (default 10000000)" << endl
+		<< "Results are printed one per line as tab separated key=value fields; lines" << endl
+		<< "starting with # are comments." << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string suite = "all";
+	string storeName = "all";
+	int numLines = 1000000;
+	int maxLines = 10000000;
+	int budget = 200;
+	int maxOps = 1000000;
+	int memoryLines = 10000000;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		size_t equals = arg.find('=');
+		string name = arg.substr(0, equals);
+		string value = equals == string::npos ? "" : arg.substr(equals + 1);
+
+		if (name == "--suite") {
+			suite = value;
+		}
+		else if (name == "--lines") {
+			numLines = atoi(value.c_str());
+		}
+		else if (name == "--max-lines") {
+			maxLines = atoi(value.c_str());
+		}
+		else if (name == "--store") {
+			storeName = value;
+		}
+		else if (name == "--budget") {
+			budget = atoi(value.c_str());
+		}
+		else if (name == "--max-ops") {
+			maxOps = atoi(value.c_str());
+		}
+		else if (name == "--memory-lines") {
+			memoryLines = atoi(value.c_str());
+		}
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	StoreType type;
+
+	if (suite != "all" && suite != "save" && suite != "scan" && suite != "store" && suite != "memory") {
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (storeName != "all" && !LineStore::parseStoreType(storeName, type)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (suite == "all" || suite == "save" || suite == "scan") {
+		LineSnapshot lines;
+
+		generateLines(numLines, lines);
+
+		if (suite != "scan") {
+			runSaveSuite(lines);
+		}
+		if (suite != "save") {
+			runScanSuite(lines);
+		}
+	}
+
+	if (suite == "all" || suite == "store") {
+		runStoreSuite(storeName, maxLines, budget / 1000.0, maxOps);
+	}
+
+	if (suite == "all" || suite == "memory") {
+		runMemorySuite(memoryLines);
+	}
+
+	return 0;
+}
@@ -0,0 +1,345 @@
+#include "StoreBenchmark.h"
+#include "StringLinkedList.h"
+#include <algorithm>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+/*
+	Counts what is written to it and throws it away, so that serialization can be
+	measured without the cost of a disk or a growing string.
+*/
+class CountingBuffer : public streambuf
+{
+public:
+	long long count;
+
+	CountingBuffer() : count(0) {}
+
+protected:
+	int_type overflow(int_type c) {
+		if (c != traits_type::eof()) {
+			count++;
+		}
+		return traits_type::not_eof(c);
+	}
+
+	streamsize xsputn(const char *, streamsize length) {
+		count += length;
+		return length;
+	}
+};
+
+/**
+	Main constructor.
+	@param type The kind of store to measure.
+	@param typeName The name of the store, as printed in the results.
+	@param indexValues Whether the store keeps a value index; only linked lists can.
+	@param budget The longest time to spend on one measurement, in seconds.
+	@param maxOps The most operations to run in one measurement.
+*/
+StoreBenchmark::StoreBenchmark(StoreType type, string typeName, bool indexValues, double budget, int maxOps) :
+	store(NULL), type(type), typeName(typeName), indexValues(indexValues), budget(budget), maxOps(maxOps),
+	numLines(0), seed(1) {
+}
+
+/**
+	Virtual destructor.
+*/
+StoreBenchmark::~StoreBenchmark() {
+	delete store;
+}
+
+/**
+	Runs every operation, with each access pattern that applies to it, on a store
+	of the given size, printing one result line per measurement. Operations that
+	change the store start from a freshly filled one, so that each measurement
+	sees the same document.
+	@param numLines The number of lines in the store.
+*/
+void StoreBenchmark::run(int numLines) {
+	AccessPattern patterns[] = { SEQUENTIAL_ACCESS, RANDOM_ACCESS };
+	int half = max(numLines / 2, 1);
+
+	this->numLines = numLines;
+	fill();
+	measureWrite();
+
+	if (indexValues) {
+		measureValueIndex();
+	}
+
+	for (AccessPattern pattern : patterns) {
+		measure("get", pattern, maxOps, [&](int op) {
+			store->get(pickPosition(pattern, op, numLines));
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		measure("getView", pattern, maxOps, [&](int op) {
+			store->getView(pickPosition(pattern, op, numLines));
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		measure("updateValue", pattern, maxOps, [&](int op) {
+			store->updateValue(pickPosition(pattern, op, numLines), makeLine(numLines + op));
+		});
+	}
+
+	fill();
+	measure("add", SEQUENTIAL_ACCESS, maxOps, [&](int op) {
+		store->add(makeLine(numLines + op));
+	});
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("insertAt", pattern, maxOps, [&](int op) {
+			store->insertAt(pickPosition(pattern, op, numLines + op + 1), makeLine(numLines + op));
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("deleteNode", pattern, half, [&](int op) {
+			store->deleteNode(pickPosition(pattern, op, numLines - op));
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("deleteRange", pattern, max(half / DELETE_RANGE_LINES, 1), [&](int op) {
+			int remaining = numLines - op * DELETE_RANGE_LINES;
+			store->deleteRange(pickPosition(pattern, op, max(remaining - DELETE_RANGE_LINES + 1, 1)), DELETE_RANGE_LINES);
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("deleteValue", pattern, half, [&](int op) {
+			store->deleteValue(makeLine(pickId(pattern, op)));
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("insertAfterValue", pattern, half, [&](int op) {
+			store->insertAfterValue(makeLine(pickId(pattern, op)), makeLine(numLines + op));
+		});
+	}
+
+	// a value no line holds, so every line is compared and the new line appended
+	fill();
+	measure("insertAfterMissingValue", SEQUENTIAL_ACCESS, maxOps, [&](int op) {
+		store->insertAfterValue(makeLine(-1), makeLine(numLines + op));
+	});
+
+	vector<string> block;
+	vector<LineView> views;
+	int numBlocks = max(maxOps / BLOCK_LINES, 1);
+
+	for (int i = 0; i < BLOCK_LINES; i++) {
+		block.push_back(makeLine(numLines + i));
+	}
+	views.assign(block.begin(), block.end());
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("insertRange", pattern, numBlocks, [&](int op) {
+			store->insertRange(pickPosition(pattern, op, numLines + op * BLOCK_LINES + 1), views);
+		});
+	}
+
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("copyPaste", pattern, numBlocks, [&](int op) {
+			int size = numLines + op * BLOCK_LINES;
+			LineStore *copy = store->copy(pickPosition(pattern, op, max(size - BLOCK_LINES + 1, 1)), BLOCK_LINES);
+
+			store->paste(pickPosition(pattern, op, size + 1), *copy);
+			delete copy;
+		});
+	}
+
+	// moves keep the size of the store, so the source and the target range over it
+	for (AccessPattern pattern : patterns) {
+		fill();
+		measure("splice", pattern, numBlocks, [&](int op) {
+			int range = max(numLines - BLOCK_LINES + 1, 1);
+			int start = pickPosition(pattern, op, range);
+
+			store->splice(pattern == RANDOM_ACCESS ? pickPosition(pattern, op, range) : range - 1 - start, *store, start, BLOCK_LINES);
+		});
+	}
+
+	delete store;
+	store = NULL;
+}
+
+/**
+	Builds the text of a line. Every id gives a different line, so that lines can
+	be found again by value.
+	@param id The id of the line.
+	@returns The line.
+*/
+string StoreBenchmark::makeLine(int id) {
+	return "2024-01-01 12:00:00 INFO processed request " + to_string(id);
+}
+
+/**
+	Gets the name of an access pattern, as printed in the results.
+	@param pattern The access pattern.
+	@returns The name.
+*/
+const char* StoreBenchmark::patternName(AccessPattern pattern) {
+	return pattern == RANDOM_ACCESS ? "random" : "sequential";
+}
+
+/**
+	Steps the random number generator (xorshift), which restarts from the same seed
+	for every measurement so that runs can be compared.
+	@returns The next random number.
+*/
+unsigned int StoreBenchmark::nextRandom() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/**
+	Chooses the position an operation works on. Sequential operations walk forward
+	from the middle of the store, wrapping around at the end.
+	@param pattern The access pattern.
+	@param op The number of the operation within the measurement.
+	@param range The number of valid positions.
+	@returns A position from 0 to range - 1.
+*/
+int StoreBenchmark::pickPosition(AccessPattern pattern, int op, int range) {
+	if (pattern == RANDOM_ACCESS) {
+		return (int)(nextRandom() % (unsigned int)range);
+	}
+	return (int)(((long long)numLines / 2 + op) % range);
+}
+
+/**
+	Chooses the id of a line that was in the freshly filled store and that no
+	earlier operation of the measurement has looked for, so every search succeeds.
+	Random ids step through the lines by a large prime, which visits each of them
+	once in a scattered order.
+	@param pattern The access pattern.
+	@param op The number of the operation within the measurement.
+	@returns The id of the line.
+*/
+int StoreBenchmark::pickId(AccessPattern pattern, int op) {
+	if (pattern == RANDOM_ACCESS) {
+		return (int)(((long long)op * 1000003 + numLines / 3) % numLines);
+	}
+	return (int)(((long long)numLines / 2 + op) % numLines);
+}
+
+/**
+	Replaces the store with a new one holding lines with ids 0 to numLines - 1 in
+	order, indexed by value if the benchmark asks for it.
+*/
+void StoreBenchmark::fill() {
+	delete store;
+	store = LineStore::create(type);
+
+	for (int i = 0; i < numLines; i++) {
+		store->add(makeLine(i));
+	}
+
+	if (indexValues) {
+		((StringLinkedList*)store)->setValueIndex(true);
+	}
+}
+
+/**
+	Prints one result line, as tab separated key=value fields.
+	@param op The name of the operation.
+	@param pattern The name of the access pattern.
+	@param ops The number of operations run.
+	@param seconds The time taken.
+	@param bytes The number of bytes produced, or -1 if the operation produces none.
+*/
+void StoreBenchmark::report(string op, string pattern, int ops, double seconds, long long bytes) {
+	cout << "suite=store\tstore=" << typeName << "\top=" << op << "\tpattern=" << pattern
+		<< "\tlines=" << numLines << "\tops=" << ops << "\tseconds=" << seconds
+		<< "\tns/op=" << (ops > 0 ? seconds * 1e9 / ops : 0);
+
+	if (bytes >= 0) {
+		cout << "\tbytes=" << bytes << "\tMB/s=" << (seconds > 0 ? bytes / seconds / (1024 * 1024) : 0);
+	}
+	cout << endl;
+}
+
+/**
+	Runs an operation until the time budget or the operation limit is reached and
+	reports the average time per operation.
+	@param op The name of the operation.
+	@param pattern The access pattern.
+	@param limit The most operations the store can take; capped by maxOps.
+	@param body Runs one operation; receives its number within the measurement.
+*/
+void StoreBenchmark::measure(string op, AccessPattern pattern, int limit, const function<void(int)>& body) {
+	auto start = chrono::steady_clock::now();
+	int ops = 0;
+
+	limit = min(limit, maxOps);
+	seed = 2463534242u;
+
+	while (ops < limit) {
+		body(ops++);
+
+		// reading the clock costs about as much as a fast operation
+		if ((ops & 7) == 0) {
+			chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+			if (elapsed.count() >= budget) {
+				break;
+			}
+		}
+	}
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	report(op, patternName(pattern), ops, elapsed.count());
+}
+
+/**
+	Measures writing the whole store through operator<<, repeated until the time
+	budget is spent.
+*/
+void StoreBenchmark::measureWrite() {
+	auto start = chrono::steady_clock::now();
+	chrono::duration<double> elapsed(0);
+	CountingBuffer buffer;
+	ostream output(&buffer);
+	int ops = 0;
+
+	while (ops < maxOps && (ops == 0 || elapsed.count() < budget)) {
+		output << *store;
+		ops++;
+		elapsed = chrono::steady_clock::now() - start;
+	}
+
+	report("operator<<", patternName(SEQUENTIAL_ACCESS), ops, elapsed.count(), buffer.count);
+}
+
+/**
+	Measures building the value index of the freshly filled store, and reports the
+	memory it takes.
+*/
+void StoreBenchmark::measureValueIndex() {
+	StringLinkedList *list = (StringLinkedList*)store;
+
+	list->setValueIndex(false);
+
+	auto start = chrono::steady_clock::now();
+	list->setValueIndex(true);
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+	report("buildValueIndex", patternName(SEQUENTIAL_ACCESS), 1, elapsed.count());
+	cout << "suite=store\tstore=" << typeName << "\top=valueIndexMemory\tlines=" << numLines
+		<< "\tbytes=" << list->valueIndexMemoryUsage()
+		<< "\tbytes/line=" << (double)list->valueIndexMemoryUsage() / max(numLines, 1) << endl;
+}
@@ -0,0 +1,50 @@
+#ifndef STOREBENCHMARK_H
+#define STOREBENCHMARK_H
+
+#include "LineStore.h"
+#include <chrono>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+// The number of lines removed by each deleteRange operation.
+const int DELETE_RANGE_LINES = 10;
+
+// The number of lines in the blocks inserted, copied and moved by bulk operations.
+const int BLOCK_LINES = 100;
+
+enum AccessPattern { SEQUENTIAL_ACCESS, RANDOM_ACCESS };
+
+class StoreBenchmark
+{
+private:
+	LineStore *store;
+	StoreType type;
+	string typeName;
+	bool indexValues;
+	double budget;
+	int maxOps;
+	int numLines;
+	unsigned int seed;
+
+	static string makeLine(int id);
+	static const char* patternName(AccessPattern pattern);
+	unsigned int nextRandom();
+	int pickPosition(AccessPattern pattern, int op, int range);
+	int pickId(AccessPattern pattern, int op);
+	void fill();
+	void report(string op, string pattern, int ops, double seconds, long long bytes = -1);
+	void measure(string op, AccessPattern pattern, int limit, const function<void(int)>& body);
+	void measureWrite();
+	void measureValueIndex();
+
+public:
+	StoreBenchmark(StoreType type, string typeName, bool indexValues, double budget, int maxOps);
+	StoreBenchmark(const StoreBenchmark&) = delete;
+	StoreBenchmark& operator=(const StoreBenchmark&) = delete;
+	virtual ~StoreBenchmark();
+	void run(int numLines);
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include "BackgroundSaver.h"
+#include "DocumentWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Progress is published every this many lines, to keep the counter off the hot path.
+const long long PROGRESS_INTERVAL = 4096;
+// The number of names tried for the temporary file before the save fails.
+const int TEMPORARY_ATTEMPTS = 16;
+
+/**
+	Default constructor.
+*/
+BackgroundSaver::BackgroundSaver() : linesWritten(0), totalLines(0), running(false), succeeded(true), bytesWritten(0), secondsElapsed(0) {}
+
+/**
+	Virtual destructor. Waits for the save in progress, if any.
+*/
+BackgroundSaver::~BackgroundSaver() {
+	wait();
+}
+
+/**
+	Starts saving a store on a worker thread. The store's contents are captured
+	before this returns, so it can be modified while the save runs. A save already
+	in progress is finished first. Capturing the contents copies every line that no
+	longer points into the loaded file, on the calling thread: a buffer loaded with
+	--load=stream, or edited throughout, is copied whole before the save starts,
+	which takes time and as much memory again. A store that lost lines is not saved, and the
+	save fails at once, so that the file keeps the lines.
+	@param store The store to save.
+	@param path The path of the file to save to.
+*/
+void BackgroundSaver::start(LineStore& store, string path) {
+	wait();
+
+	store.snapshot(lines);
+	this->path = path;
+	linesWritten = 0;
+	totalLines = (long long)lines.lines.size();
+	succeeded = false;
+
+	if (!store.isIntact()) {
+		lines.clear();
+		running = false;
+		return;
+	}
+
+	running = true;
+
+	worker = thread(&BackgroundSaver::run, this);
+}
+
+/**
+	Blocks until the save in progress, if any, has finished.
+*/
+void BackgroundSaver::wait() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+/**
+	Checks if a save is in progress.
+	@returns True while the worker thread is writing.
+*/
+bool BackgroundSaver::isRunning() {
+	return running;
+}
+
+/**
+	Checks how the last save went.
+	@returns True if the last save finished and replaced the file.
+*/
+bool BackgroundSaver::lastSucceeded() {
+	return succeeded;
+}
+
+/**
+	Gets the progress of the save in progress.
+	@returns The percentage of lines written.
+*/
+int BackgroundSaver::getProgress() {
+	long long total = totalLines;
+
+	if (total == 0) {
+		return running ? 0 : 100;
+	}
+
+	return (int)(linesWritten * 100 / total);
+}
+
+/**
+	Gets the write throughput of the last save. Only meaningful once it has finished.
+	@returns The number of bytes written per second.
+*/
+double BackgroundSaver::getBytesPerSecond() {
+	return secondsElapsed > 0 ? bytesWritten / secondsElapsed : 0;
+}
+
+/**
+	Gets the path of the last save started.
+	@returns The path.
+*/
+string BackgroundSaver::getPath() {
+	return path;
+}
+
+/**
+	Finds the file a path ends up at once symbolic links are followed, so that saving
+	through a link replaces the file it points to rather than the link.
+	@param path The path.
+	@returns The path of the file, or the path itself if it does not exist yet or
+	the platform has no such links.
+*/
+string BackgroundSaver::resolveLinks(string path) {
+#ifdef _WIN32
+	return path;
+#else
+	char *resolved = realpath(path.c_str(), NULL);
+
+	if (resolved == NULL) {
+		return path;
+	}
+
+	string result = resolved;
+
+	free(resolved);
+	return result;
+#endif
+}
+
+/**
+	Makes up the path of a temporary file next to a file, with a random part so that
+	it does not name a file of the user's.
+	@param path The path of the file.
+	@returns The path of the temporary file.
+*/
+string BackgroundSaver::temporaryPath(string path) {
+	// saves of different documents may run at once
+	static thread_local mt19937 generator(random_device{}());
+	stringstream ss;
+
+	ss << path << "." << hex << generator() << ".tmp";
+	return ss.str();
+}
+
+/**
+	Replaces a file with another one, in a single step where the platform allows it.
+	The rename reaches the disk before this returns: on POSIX systems that takes
+	syncing the directory holding the file. On Windows, an existing file keeps its
+	attributes and security.
+	@param from The path of the new file.
+	@param to The path of the file to replace.
+	@returns True if the file was replaced.
+*/
+bool BackgroundSaver::replaceFile(string from, string to) {
+#ifdef _WIN32
+	if (GetFileAttributesA(to.c_str()) != INVALID_FILE_ATTRIBUTES
+		&& ReplaceFileA(to.c_str(), from.c_str(), NULL, REPLACEFILE_WRITE_THROUGH, NULL, NULL)) {
+		return true;
+	}
+
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	if (rename(from.c_str(), to.c_str()) != 0) {
+		return false;
+	}
+
+	size_t slash = to.find_last_of('/');
+	string directory = slash == string::npos ? "." : to.substr(0, slash > 0 ? slash : 1);
+	int handle = open(directory.c_str(), O_RDONLY);
+
+	// some file systems can't sync a directory; the file is replaced all the same
+	if (handle >= 0) {
+		fsync(handle);
+		close(handle);
+	}
+
+	return true;
+#endif
+}
+
+/**
+	Worker thread body. Writes the snapshot to a new temporary file next to the
+	target, with the target's permissions, then renames it over the target, so that
+	the target is never left half written. The temporary file is synced first: the
+	journal is rebased once the save has succeeded, so the new contents must not be
+	lost to a crash after the rename.
+*/
+void BackgroundSaver::run() {
+	string target = resolveLinks(path);
+	string tempPath;
+	DocumentWriter writer;
+	auto start = chrono::steady_clock::now();
+	bool ok = false;
+
+	// the name is taken only if no file has it
+	for (int i = 0; i < TEMPORARY_ATTEMPTS && !ok; i++) {
+		tempPath = temporaryPath(target);
+		ok = writer.open(tempPath, false);
+	}
+
+	if (!ok) {
+		tempPath.clear();
+	}
+	ok = ok && writer.copyPermissions(target);
+
+	for (size_t i = 0; ok && i < lines.lines.size(); i += PROGRESS_INTERVAL) {
+		size_t count = min(lines.lines.size() - i, (size_t)PROGRESS_INTERVAL);
+
+		ok = writer.writeLines(&lines.lines[i], count);
+		linesWritten = (long long)(i + count);
+	}
+
+	ok = ok && writer.sync();
+	ok = writer.close() && ok;
+
+	if (ok) {
+		ok = replaceFile(tempPath, target);
+	}
+	if (!ok && !tempPath.empty()) {
+		remove(tempPath.c_str());
+	}
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	bytesWritten = writer.getBytesWritten();
+	secondsElapsed = elapsed.count();
+
+	linesWritten = totalLines.load();
+	lines.clear();
+	succeeded = ok;
+	running = false;
+}
@@ -0,0 +1,43 @@
+#ifndef BACKGROUNDSAVER_H
+#define BACKGROUNDSAVER_H
+
+#include "LineStore.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+class BackgroundSaver
+{
+private:
+	thread worker;
+	LineSnapshot lines;
+	string path;
+	atomic<long long> linesWritten;
+	atomic<long long> totalLines;
+	atomic<bool> running;
+	atomic<bool> succeeded;
+	long long bytesWritten;
+	double secondsElapsed;
+
+	static bool replaceFile(string from, string to);
+	static string resolveLinks(string path);
+	static string temporaryPath(string path);
+	void run();
+
+public:
+	BackgroundSaver();
+	BackgroundSaver(const BackgroundSaver&) = delete;
+	BackgroundSaver& operator=(const BackgroundSaver&) = delete;
+	virtual ~BackgroundSaver();
+	bool isRunning();
+	bool lastSucceeded();
+	double getBytesPerSecond();
+	int getProgress();
+	string getPath();
+	void start(LineStore& store, string path);
+	void wait();
+};
+
+#endif
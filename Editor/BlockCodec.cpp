@@ -0,0 +1,214 @@
+#include "BlockCodec.h"
+#include <cstring>
+#include <vector>
+
+// Matches are at least this long; shorter repeats are left as literals.
+static const size_t MIN_MATCH = 4;
+// The last bytes of a block are always literals, and no match starts in the bytes
+// before them, so that the match finder may read 4 bytes past any position.
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_MARGIN = 12;
+static const size_t MAX_DISTANCE = 65535;
+
+/**
+	Reads 4 bytes of text, whatever their alignment.
+	@param text The first byte.
+	@returns The bytes.
+*/
+static unsigned int read32(const char *text) {
+	unsigned int value;
+
+	memcpy(&value, text, sizeof(value));
+	return value;
+}
+
+/**
+	Hashes 4 bytes of text into a position of the table of the match finder.
+	@param sequence The bytes.
+	@returns The position.
+*/
+static size_t hashSequence(unsigned int sequence) {
+	return (sequence * 2654435761u) >> (32 - CODEC_HASH_BITS);
+}
+
+/**
+	Writes what a length field of a token leaves over.
+	@param output The block to append to.
+	@param length The length minus 15.
+*/
+void BlockCodec::writeLength(string& output, size_t length) {
+	while (length >= 255) {
+		output += (char)255;
+		length -= 255;
+	}
+
+	output += (char)length;
+}
+
+/**
+	Reads what a length field of a token left over, adding it to the length.
+	@param input The next byte to read; moved past the bytes read.
+	@param end The end of the block.
+	@param length The length, 15 when called.
+	@returns False if the block ends first.
+*/
+bool BlockCodec::readLength(const unsigned char *&input, const unsigned char *end, size_t& length) {
+	unsigned char next;
+
+	do {
+		if (input == end) {
+			return false;
+		}
+
+		next = *input++;
+		length += next;
+	} while (next == 255);
+
+	return true;
+}
+
+/**
+	Compresses a block of text. The block must be smaller than 4 GB.
+	@param text The text.
+	@param length The size of the text, in bytes.
+	@param output Receives the compressed block; it is cleared first.
+*/
+void BlockCodec::compress(const char *text, size_t length, string& output) {
+	vector<int> table((size_t)1 << CODEC_HASH_BITS, -1);
+	unsigned int size = (unsigned int)length;
+	size_t anchor = 0;
+	size_t position = 0;
+
+	output.clear();
+	output.reserve(sizeof(size) + length + length / 255 + 16);
+	output.append((const char*)&size, sizeof(size));
+
+	if (length > MATCH_MARGIN) {
+		size_t matchEnd = length - LAST_LITERALS;
+
+		while (position < length - MATCH_MARGIN) {
+			unsigned int sequence = read32(text + position);
+			size_t hash = hashSequence(sequence);
+			int candidate = table[hash];
+
+			table[hash] = (int)position;
+
+			if (candidate < 0 || position - candidate > MAX_DISTANCE || read32(text + candidate) != sequence) {
+				// skip ahead faster through text that does not compress
+				position += 1 + ((position - anchor) >> 6);
+				continue;
+			}
+
+			size_t matchLength = MIN_MATCH;
+
+			while (position + matchLength < matchEnd && text[candidate + matchLength] == text[position + matchLength]) {
+				matchLength++;
+			}
+
+			size_t literals = position - anchor;
+			size_t matchCode = matchLength - MIN_MATCH;
+			size_t distance = position - candidate;
+
+			output += (char)(((literals < 15 ? literals : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+			if (literals >= 15) {
+				writeLength(output, literals - 15);
+			}
+			output.append(text + anchor, literals);
+			output += (char)(distance & 0xff);
+			output += (char)(distance >> 8);
+			if (matchCode >= 15) {
+				writeLength(output, matchCode - 15);
+			}
+
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	size_t literals = length - anchor;
+
+	output += (char)((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15) {
+		writeLength(output, literals - 15);
+	}
+	output.append(text + anchor, literals);
+}
+
+/**
+	Restores a block of text compressed by compress.
+	@param input The compressed block.
+	@param output Receives the text; it is cleared first.
+	@returns False if the block is corrupt.
+*/
+bool BlockCodec::decompress(const string& input, string& output) {
+	const unsigned char *next = (const unsigned char*)input.data();
+	const unsigned char *end = next + input.size();
+	unsigned int size;
+
+	output.clear();
+
+	if (input.size() < sizeof(size)) {
+		return false;
+	}
+
+	memcpy(&size, next, sizeof(size));
+	next += sizeof(size);
+
+	// no byte of a block stands for more than 255 bytes of text
+	if (size / 255 > input.size()) {
+		return false;
+	}
+
+	output.resize(size);
+
+	char *out = &output[0];
+	size_t written = 0;
+
+	while (next < end) {
+		unsigned char token = *next++;
+		size_t literals = token >> 4;
+		size_t matchLength = token & 15;
+
+		if ((literals == 15 && !readLength(next, end, literals))
+			|| literals > (size_t)(end - next) || literals > size - written) {
+			return false;
+		}
+
+		memcpy(out + written, next, literals);
+		next += literals;
+		written += literals;
+
+		if (next == end) {
+			break;
+		}
+
+		if (end - next < 2) {
+			return false;
+		}
+
+		size_t distance = next[0] | (next[1] << 8);
+
+		next += 2;
+
+		if (matchLength == 15 && !readLength(next, end, matchLength)) {
+			return false;
+		}
+
+		matchLength += MIN_MATCH;
+
+		if (distance == 0 || distance > written || matchLength > size - written) {
+			return false;
+		}
+
+		// the match may overlap the bytes it produces, so it is copied a byte at a time
+		const char *match = out + written - distance;
+
+		for (size_t i = 0; i < matchLength; i++) {
+			out[written + i] = match[i];
+		}
+
+		written += matchLength;
+	}
+
+	return written == size;
+}
@@ -0,0 +1,36 @@
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+// The number of bits of the hash of the match finder; its table has 2^bits entries.
+const int CODEC_HASH_BITS = 12;
+
+/**
+	A fast LZ77 compressor for blocks of text, in the spirit of LZ4: repeated byte
+	sequences are replaced by a reference to their previous occurrence, found
+	through a hash table of the positions of 4 byte sequences. Logs and exports,
+	whose lines share most of their structure, shrink several times over.
+
+	A compressed block starts with the size of the original text, as 4 bytes, and
+	continues with sequences of a token byte, literals, and a match. The high half
+	of the token holds the number of literals and the low half the length of the
+	match minus 4; either is followed by bytes of 255 and a last smaller byte adding
+	to it when it is 15. The match is given as 2 bytes of distance back from the
+	current position, and the last sequence of a block has no match.
+*/
+class BlockCodec
+{
+private:
+	static void writeLength(string& output, size_t length);
+	static bool readLength(const unsigned char *&input, const unsigned char *end, size_t& length);
+
+public:
+	static void compress(const char *text, size_t length, string& output);
+	static bool decompress(const string& input, string& output);
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "CommandParser.h"
+#include <climits>
+
+/*
+	Every command is a single letter (either case) followed by up to maxArgs numeric
+	parameters. Each parameter may be preceded by a single whitespace character, so
+	"D12", "D 12", "D1 2" and "D 1 2" are all valid, exactly as with the regular
+	expressions this table replaces.
+
+	C and M copy and move a block of lines; their last parameter is the line the block
+	goes after, so "M 3 9 20" moves lines 3 to 9 after line 20. Y and X do the same
+	across buffers: their last parameter is the number of the buffer.
+
+	The one exception is s/pattern/replacement/, which replaces text across the
+	buffer. It may be followed by a line or a range of lines, like D. A '/' or a '\'
+	inside the pattern or the replacement is escaped with a '\'.
+*/
+static const CommandSpec COMMAND_TABLE[] = {
+	{ 'A', CMD_PASTE, 1 },
+	{ 'B', CMD_BUFFER, 1 },
+	{ 'C', CMD_COPY, 3 },
+	{ 'D', CMD_DELETE, 2 },
+	{ 'E', CMD_SAVE_EXIT, 0 },
+	{ 'F', CMD_FIND, 0 },
+	{ 'G', CMD_GOTO, 1 },
+	{ 'H', CMD_HELP, 0 },
+	{ 'I', CMD_INSERT, 1 },
+	{ 'K', CMD_CLOSE, 1 },
+	{ 'L', CMD_LIST, 2 },
+	{ 'M', CMD_MOVE, 3 },
+	{ 'N', CMD_FIND_NEXT, 0 },
+	{ 'O', CMD_OPEN, 0 },
+	{ 'P', CMD_POSITION, 1 },
+	{ 'Q', CMD_QUIT, 0 },
+	{ 'R', CMD_REDO, 0 },
+	{ 'S', CMD_SUBSTITUTE, 1 },
+	{ 'T', CMD_INDEX, 0 },
+	{ 'U', CMD_UNDO, 0 },
+	{ 'V', CMD_VIEW, 0 },
+	{ 'W', CMD_WRITE, 0 },
+	{ 'X', CMD_MOVE_TO, 3 },
+	{ 'Y', CMD_COPY_TO, 3 },
+	{ 'Z', CMD_STATS, 0 }
+};
+
+/**
+	Looks up the command associated with a letter.
+	@param letter The command letter, in either case.
+	@returns The command's entry in the command table, or NULL if there is none.
+*/
+const CommandSpec* CommandParser::findSpec(char letter) {
+	if (letter >= 'a' && letter <= 'z') {
+		letter = letter - 'a' + 'A';
+	}
+
+	for (size_t i = 0; i < sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]); i++) {
+		if (COMMAND_TABLE[i].letter == letter) {
+			return &COMMAND_TABLE[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+	Gets the letter of a command.
+	@param type The command type.
+	@returns The upper case letter of the command, or 's' for CMD_REPLACE.
+*/
+char CommandParser::getLetter(CommandType type) {
+	if (type == CMD_REPLACE) {
+		return 's';
+	}
+
+	for (size_t i = 0; i < sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]); i++) {
+		if (COMMAND_TABLE[i].type == type) {
+			return COMMAND_TABLE[i].letter;
+		}
+	}
+
+	return '?';
+}
+
+/**
+	Checks if a character is whitespace, as matched by \s.
+	@param c The character to check.
+	@returns True if the character is whitespace.
+*/
+bool CommandParser::isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/**
+	Parses a command without allocating memory.
+	@param text The command text.
+	@param length The number of characters in text.
+	@param command Receives the command type and its parameters. Parameters are
+	positional: numArgs is the number of leading parameters that were given.
+	@returns True if the text is a valid command, false otherwise.
+*/
+bool CommandParser::parse(const char *text, size_t length, Command& command) {
+	const CommandSpec *spec = length > 0 ? findSpec(text[0]) : NULL;
+	size_t pos = 1;
+	int maxArgs;
+
+	if (spec == NULL) {
+		return false;
+	}
+
+	command.type = spec->type;
+	command.numArgs = 0;
+	maxArgs = spec->maxArgs;
+
+	if (spec->type == CMD_SUBSTITUTE && pos < length && text[pos] == '/') {
+		command.type = CMD_REPLACE;
+		maxArgs = 2;
+
+		if (!parseDelimited(text, length, pos, command.pattern)
+			|| !parseDelimited(text, length, pos, command.replacement)) {
+			return false;
+		}
+		pos++;
+	}
+
+	return parseArgs(text, length, pos, maxArgs, command) && pos == length;
+}
+
+/**
+	Parses the numeric parameters of a command.
+	@param text The command text.
+	@param length The number of characters in text.
+	@param pos The position of the first parameter; moved past the last one.
+	@param maxArgs The number of parameters the command takes.
+	@param command Receives the parameters.
+	@returns False if a parameter is invalid.
+*/
+bool CommandParser::parseArgs(const char *text, size_t length, size_t& pos, int maxArgs, Command& command) {
+	for (int i = 0; i < maxArgs; i++) {
+		long long value = 0;
+		size_t digits = 0;
+
+		if (pos < length && isSpace(text[pos])) {
+			pos++;
+		}
+
+		while (pos < length && text[pos] >= '0' && text[pos] <= '9') {
+			value = value * 10 + (text[pos] - '0');
+			if (value > INT_MAX) {
+				return false;
+			}
+			digits++;
+			pos++;
+		}
+
+		if (digits > 0) {
+			// a parameter can't be given without the ones before it
+			if (command.numArgs != i) {
+				return false;
+			}
+			command.args[command.numArgs++] = (int)value;
+		}
+	}
+
+	return true;
+}
+
+/**
+	Finds the end of a field of an s/pattern/replacement/ command.
+	@param text The command text.
+	@param length The number of characters in text.
+	@param pos The position of the '/' that opens the field; moved to the one that
+	closes it.
+	@param field Receives the position of the field, escapes included.
+	@returns False if the field is not closed.
+*/
+bool CommandParser::parseDelimited(const char *text, size_t length, size_t& pos, CommandText& field) {
+	field.start = ++pos;
+
+	while (pos < length && text[pos] != '/') {
+		if (text[pos] == '\\' && pos + 1 < length) {
+			pos++;
+		}
+		pos++;
+	}
+
+	field.length = pos - field.start;
+	return pos < length;
+}
+
+/**
+	Gets the text of a field of an s/pattern/replacement/ command, with its escapes
+	removed.
+	@param text The command text.
+	@param field The field.
+	@returns The field's text.
+*/
+string CommandParser::unescape(const string& text, CommandText field) {
+	string value;
+
+	for (size_t i = field.start; i < field.start + field.length; i++) {
+		if (text[i] == '\\' && i + 1 < field.start + field.length) {
+			i++;
+		}
+		value += text[i];
+	}
+
+	return value;
+}
+
+/**
+	Parses a command without allocating memory.
+	@param text The command text.
+	@param command Receives the command type and its parameters.
+	@returns True if the text is a valid command, false otherwise.
+*/
+bool CommandParser::parse(const string& text, Command& command) {
+	return parse(text.data(), text.size(), command);
+}
@@ -0,0 +1,80 @@
+#ifndef COMMANDPARSER_H
+#define COMMANDPARSER_H
+
+#include <string>
+
+using namespace std;
+
+const int MAX_COMMAND_ARGS = 3;
+
+enum CommandType {
+	CMD_BUFFER,
+	CMD_CLOSE,
+	CMD_COPY,
+	CMD_COPY_TO,
+	CMD_DELETE,
+	CMD_FIND,
+	CMD_FIND_NEXT,
+	CMD_GOTO,
+	CMD_HELP,
+	CMD_INDEX,
+	CMD_INSERT,
+	CMD_LIST,
+	CMD_MOVE,
+	CMD_MOVE_TO,
+	CMD_OPEN,
+	CMD_PASTE,
+	CMD_POSITION,
+	CMD_QUIT,
+	CMD_REDO,
+	CMD_REPLACE,
+	CMD_SAVE_EXIT,
+	CMD_STATS,
+	CMD_SUBSTITUTE,
+	CMD_UNDO,
+	CMD_VIEW,
+	CMD_WRITE,
+	// Not a command; the number of command types.
+	CMD_COUNT
+};
+
+struct CommandSpec
+{
+	char letter;
+	CommandType type;
+	int maxArgs;
+};
+
+// A piece of the command text, as an offset and a length.
+struct CommandText
+{
+	size_t start;
+	size_t length;
+};
+
+struct Command
+{
+	CommandType type;
+	int numArgs;
+	int args[MAX_COMMAND_ARGS];
+	// Only set for CMD_REPLACE; still escaped, see unescape.
+	CommandText pattern;
+	CommandText replacement;
+};
+
+class CommandParser
+{
+private:
+	static const CommandSpec* findSpec(char letter);
+	static bool isSpace(char c);
+	static bool parseArgs(const char *text, size_t length, size_t& pos, int maxArgs, Command& command);
+	static bool parseDelimited(const char *text, size_t length, size_t& pos, CommandText& field);
+
+public:
+	static char getLetter(CommandType type);
+	static bool parse(const char *text, size_t length, Command& command);
+	static bool parse(const string& text, Command& command);
+	static string unescape(const string& text, CommandText field);
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "CompactLine.h"
+
+/**
+	Replaces the line with a copy of a text, stored in place if it is short enough
+	or in the arena otherwise. The text is copied before the old one is released,
+	so it may be a view of this line or of any other line.
+	@param text The text.
+	@param length The number of characters in the text, under 4 GB.
+	@param arena The arena the line's text is stored in.
+*/
+void CompactLine::assign(const char *text, size_t length, TextArena& arena) {
+	if (length <= INLINE_CAPACITY) {
+		char copy[INLINE_CAPACITY];
+
+		memcpy(copy, text, length);
+		release(arena);
+		memcpy(bytes, copy, length);
+		bytes[COMPACT_LINE_SIZE - 1] = (char)length;
+		return;
+	}
+
+	const char *stored = arena.store(text, length);
+
+	release(arena);
+	setReference(stored, length, ARENA_TAG);
+}
+
+/**
+	Replaces the line with a reference to text owned by someone else, such as a
+	mapped file, without copying it. The text must outlive the line.
+	@param text The text.
+	@param length The number of characters in the text, under 4 GB.
+	@param arena The arena the line's text is stored in.
+*/
+void CompactLine::assignView(const char *text, size_t length, TextArena& arena) {
+	release(arena);
+	setReference(text, length, VIEW_TAG);
+}
+
+/**
+	Empties the line, returning its text to the arena if it was stored there.
+	@param arena The arena the line's text is stored in.
+*/
+void CompactLine::release(TextArena& arena) {
+	if (tag() == ARENA_TAG) {
+		arena.release(data(), size());
+	}
+
+	bytes[COMPACT_LINE_SIZE - 1] = 0;
+}
+
+/**
+	Replaces the line with a copy of another line of the same arena, sharing its
+	text if it is stored in the arena. The text of a view is stored in the arena, as
+	the copy may outlive the memory the view points to.
+	@param source The line to copy.
+	@param arena The arena the text of both lines is stored in.
+*/
+void CompactLine::share(const CompactLine& source, TextArena& arena) {
+	char copy[COMPACT_LINE_SIZE];
+
+	if (&source == this) {
+		return;
+	}
+
+	if (source.isView()) {
+		assign(source.data(), source.size(), arena);
+		return;
+	}
+
+	if (source.tag() == ARENA_TAG) {
+		arena.share(source.data());
+	}
+
+	memcpy(copy, source.bytes, COMPACT_LINE_SIZE);
+	release(arena);
+	memcpy(bytes, copy, COMPACT_LINE_SIZE);
+}
+
+/**
+	Makes the line point to its text.
+	@param text The text.
+	@param length The number of characters in the text.
+	@param tag Where the text lives.
+*/
+void CompactLine::setReference(const char *text, size_t length, unsigned char tag) {
+	unsigned int shortLength = (unsigned int)length;
+
+	memcpy(bytes, &text, sizeof(text));
+	memcpy(bytes + sizeof(text), &shortLength, sizeof(shortLength));
+	bytes[COMPACT_LINE_SIZE - 1] = (char)tag;
+}
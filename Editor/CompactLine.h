@@ -0,0 +1,94 @@
+#ifndef COMPACTLINE_H
+#define COMPACTLINE_H
+
+#include "LineStore.h"
+#include "TextArena.h"
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+const size_t COMPACT_LINE_SIZE = 16;
+const size_t INLINE_CAPACITY = COMPACT_LINE_SIZE - 1;
+
+/**
+	The text of a line in 16 bytes. Lines of up to 15 characters are stored in place;
+	longer lines point to their text, either in a TextArena or, for lines of a loaded
+	file that have not been modified, in the file itself. The last byte holds the
+	length of an inline line, or a tag saying where the text lives.
+
+	The line does not free its text: its owner must call release with the arena the
+	text was stored in before discarding it, unless the arena is being destroyed too.
+	Copies made with share refer to the same arena text, which is never modified.
+*/
+class CompactLine
+{
+private:
+	static const unsigned char ARENA_TAG = 0x40;
+	static const unsigned char VIEW_TAG = 0x80;
+
+	// Inline text, or a pointer followed by a 32 bit length; the tag is last.
+	char bytes[COMPACT_LINE_SIZE];
+
+	unsigned char tag() const {
+		return (unsigned char)bytes[COMPACT_LINE_SIZE - 1];
+	}
+
+	void setReference(const char *text, size_t length, unsigned char tag);
+
+public:
+	CompactLine() {
+		bytes[COMPACT_LINE_SIZE - 1] = 0;
+	}
+
+	CompactLine(const CompactLine&) = delete;
+	CompactLine& operator=(const CompactLine&) = delete;
+
+	const char* data() const {
+		if (tag() <= INLINE_CAPACITY) {
+			return bytes;
+		}
+
+		const char *text;
+		memcpy(&text, bytes, sizeof(text));
+		return text;
+	}
+
+	size_t size() const {
+		if (tag() <= INLINE_CAPACITY) {
+			return tag();
+		}
+
+		unsigned int length;
+		memcpy(&length, bytes + sizeof(const char*), sizeof(length));
+		return length;
+	}
+
+	bool isView() const {
+		return tag() == VIEW_TAG;
+	}
+
+	LineView view() const {
+		return LineView(data(), size());
+	}
+
+	LineSpan span() const {
+		LineSpan span = { data(), size() };
+		return span;
+	}
+
+	string str() const {
+		return string(data(), size());
+	}
+
+	bool equals(LineView value) const {
+		return value.size() == size() && memcmp(value.data(), data(), value.size()) == 0;
+	}
+
+	void assign(const char *text, size_t length, TextArena& arena);
+	void assignView(const char *text, size_t length, TextArena& arena);
+	void release(TextArena& arena);
+	void share(const CompactLine& source, TextArena& arena);
+};
+
+#endif
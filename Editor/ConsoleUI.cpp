@@ -1,12 +1,39 @@
 #include "ConsoleUI.h"
+#include "LineScanner.h"
 #include <iostream>
 #include <Windows.h>
 #include <string>
-#include <iomanip>
+#include <cstdio>
 #include <algorithm>
 
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
 using namespace std;
 
+const int TEXT_COLOR = 15;
+const int HEADER_COLOR = 112;
+const int HEADER_FILL_COLOR = 119;
+const int LINE_NUMBER_COLOR = 3;
+const int CURRENT_LINE_NUMBER_COLOR = 11;
+const int CURRENT_LINE_COLOR = 13;
+const int STATUS_COLOR = 143;
+const int STATUS_FILL_COLOR = 136;
+
+/**
+	Default constructor. Enables escape sequence processing on the console, which
+	the frame renderer relies on for cursor positioning and colors.
+*/
+ConsoleUI::ConsoleUI() : input(&cin), metrics(NULL), headless(false), scrollPosition(1), bufferSize(0), currentLine(1) {
+	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD mode = 0;
+
+	if (GetConsoleMode(output, &mode)) {
+		SetConsoleMode(output, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+	}
+}
+
 /**
 	Gets the width (in columns) of the console window.
 	@returns An int representing the number of colums of width of the console window.
@@ -29,48 +56,79 @@ int ConsoleUI::getConsoleHeight() {
 	return csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
 }
 
+/**
+	Starts composing a new frame, sized to the console window. The command prompt
+	row is always redrawn since the user's typing is echoed into it.
+*/
+void ConsoleUI::beginFrame() {
+	if (headless) {
+		return;
+	}
+
+	screen.resize(getConsoleWidth(), getConsoleHeight());
+	screen.clear();
+	screen.invalidateRow(screen.getHeight() - 3);
+}
+
+/**
+	Sends the differences between the composed frame and the screen to the console,
+	in a single write.
+*/
+void ConsoleUI::present() {
+	if (headless) {
+		return;
+	}
+
+	const string& frame = screen.render();
+	DWORD written = 0;
+
+	cout.flush();
+	WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), frame.data(), (DWORD)frame.size(), &written, NULL);
+}
+
 /**
 	Draws the UI header.
 */
 void ConsoleUI::drawHeader() {
-	int width = getConsoleWidth() - headerInfo.size() - 3;
+	int x = screen.write(0, 0, "-> " + headerInfo, HEADER_COLOR);
 
-	setConsoleColor(112);
-	cout << "-> " << headerInfo;
-	setConsoleColor(119);
-	cout << setfill('*') << setw(width) << "" << endl << endl << setfill(' ');
+	screen.fill(x, 0, screen.getWidth() - x, '*', HEADER_FILL_COLOR);
+}
+
+/**
+	Draws a numbered line of the buffer into the frame.
+	@param row The row of the frame to draw into.
+	@param line The line number of the buffer.
+	@param value The text of the line.
+	@param isCurrentLine Indicates whether the line is the current line.
+*/
+void ConsoleUI::drawLine(int row, int line, LineView value, bool isCurrentLine) {
+	char number[16];
+	int length = snprintf(number, sizeof(number), "%3d |", line);
+	int x = screen.write(0, row, number, length, isCurrentLine ? CURRENT_LINE_NUMBER_COLOR : LINE_NUMBER_COLOR);
 
-	resetConsoleColor();
+	x = screen.write(x, row, " ", 1, TEXT_COLOR);
+	screen.write(x, row, value.data(), value.size(), isCurrentLine ? CURRENT_LINE_COLOR : TEXT_COLOR);
 }
 
 /**
 	Draws a line of the buffer into the console.
-	@param value The value of the string to be drawn into the console.
+	@param value The text of the line, which is not copied.
 	@param line The line number of the buffer to be written into the console.
 	@param isCurrentline Indicated whether the line that is being drawn is the current line.
 */
-void ConsoleUI::drawBuffer(string value, int line, bool isCurrentLine) {
-	system("cls");
-	drawHeader();
+void ConsoleUI::drawBuffer(LineView value, int line, bool isCurrentLine) {
+	PhaseTimer timer(metrics, PHASE_RENDER);
 
-	if (isCurrentLine) {
-		setConsoleColor(11);
-	}
-	else {
-		setConsoleColor(3);
+	if (headless) {
+		statusMessage = "";
+		return;
 	}
 
-	cout << setw(3) << line << " |";
-	resetConsoleColor();
-
-	if (isCurrentLine) {
-		setConsoleColor(13);
-	}
-
-	cout << " " << value << endl;
-
-	resetConsoleColor();
-	drawFooter(1);
+	beginFrame();
+	drawHeader();
+	drawLine(2, line, value, isCurrentLine);
+	drawFooter();
 }
 
 /**
@@ -79,184 +137,143 @@ void ConsoleUI::drawBuffer(string value, int line, bool isCurrentLine) {
 	@param currentLine The currently selected line in the editor.
 */
 void ConsoleUI::drawBuffer(stringstream& ss, int currentLine) {
-	int line = 1;
+	PhaseTimer timer(metrics, PHASE_RENDER);
 	int height = 0;
-	string temp;
+	string text = ss.str();
+	LineIndex index;
 
 	this->currentLine = currentLine;
 
-	system("cls");
+	if (headless) {
+		statusMessage = "";
+		return;
+	}
 
+	beginFrame();
 	drawHeader();
+	index.build(text.data(), text.size());
 
-	while (getline(ss, temp)) {
-		if (line >= scrollPosition) {
-
-			if (height > calcAvailableBufferRoom()) {
-				break;
-			}
-
-			if (line == currentLine) {
-				setConsoleColor(11);
-			}
-			else {
-				setConsoleColor(3);
-			}
-
-			cout << setw(3) << line << " |";
-			resetConsoleColor();
-
-			if (line == currentLine) {
-				setConsoleColor(13);
-			}
-
-			cout << " " << temp << endl;
-
-			resetConsoleColor();
-
-			height++;
+	for (int line = max(scrollPosition, 1); line <= (int)index.size(); line++) {
+		if (height > calcAvailableBufferRoom()) {
+			break;
 		}
 
-		line++;
+		LineSpan span = index.line(text.data(), line - 1);
+		drawLine(2 + height, line, LineView(span.text, span.length), line == currentLine);
+		height++;
 	}
 
-	drawFooter(height);
+	drawFooter();
 }
 
 /**
-	Draws a range of lines into the buffer.
-	@param ss The stringstream that contains the file buffer.
+	Draws a window of lines into the console. Only the lines passed in are visited,
+	so the cost of a redraw depends on the console height rather than on the size
+	of the document.
+	@param lines The lines to draw, in order. They are views, so drawing copies no text.
+	@param firstLine The line number of the first entry of lines.
 	@param currentLine The currently selected line in the editor.
-	@param start The starting position of the range.
-	@param end The end position of the range.
 */
-void ConsoleUI::drawBuffer(stringstream& ss, int currentLine, int start, int end) {
-	int line = 1;
+void ConsoleUI::drawBuffer(const vector<LineView>& lines, int firstLine, int currentLine) {
+	PhaseTimer timer(metrics, PHASE_RENDER);
 	int height = 0;
-	string temp;
-
-	system("cls");
-	drawHeader();
 
-	while (getline(ss, temp)) {
-		if (line >= min(start, end) && line <= max(start, end)) {
-			if (height > calcAvailableBufferRoom()) {
-				break;
-			}
-
-			if (line == currentLine) {
-				setConsoleColor(11);
-			}
-			else {
-				setConsoleColor(3);
-			}
+	this->currentLine = currentLine;
 
-			cout << setw(3) << line << " |";
-			resetConsoleColor();
+	if (headless) {
+		statusMessage = "";
+		return;
+	}
 
-			if (line == currentLine) {
-				setConsoleColor(13);
-			}
+	beginFrame();
+	drawHeader();
 
-			cout << " " << temp << endl;
+	for (size_t i = 0; i < lines.size(); i++) {
+		int line = firstLine + (int)i;
 
-			height++;
+		if (height > calcAvailableBufferRoom()) {
+			break;
 		}
-		resetConsoleColor();
-		line++;
-		bufferSize = line;
+
+		drawLine(2 + height, line, lines[i], line == currentLine);
+		height++;
 	}
 
-	drawFooter(height);
+	drawFooter();
 }
 
 /**
-	Draws the command prompt UI element into the console window.
+	Draws the command prompt UI element into the frame and leaves the cursor after it.
 */
 void ConsoleUI::drawCommandPrompt() {
-	COORD pos = { 0, (short)getConsoleHeight() - 3 };
-	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
-	SetConsoleCursorPosition(output, pos);
-	cout << " >> ";
+	int row = screen.getHeight() - 3;
+	int x = screen.write(0, row, " >> ", TEXT_COLOR);
+
+	screen.setCursor(x, row);
 }
 
 /**
-	Draws the footer portion of the UI into the console window.
-	@param padding The amount of padding (empty lines) to be drawn after the 
-	buffer.
+	Draws the footer portion of the UI, the status bar and the command prompt, then
+	sends the finished frame to the console.
 */
-void ConsoleUI::drawFooter(int padding) {
-	int width = getConsoleWidth() - footerInfo.size() - 3;
-
-	int fillHeight = getConsoleHeight() - padding - 7;
+void ConsoleUI::drawFooter() {
+	int row = screen.getHeight() - 4;
+	int x = screen.write(0, row, "<- " + footerInfo, HEADER_COLOR);
 
-	for (int i = 0; i < fillHeight; i++) {
-		cout << endl;
-	}
+	screen.fill(x, row, screen.getWidth() - x, '*', HEADER_FILL_COLOR);
 
-	cout << endl;
-	setConsoleColor(112);
-	cout << "<- " << footerInfo;
-	setConsoleColor(119);
-	cout << setfill('*') << setw(width) << "" << endl << setfill(' ');
-
-	resetConsoleColor();
 	drawStatusBar();
 	drawCommandPrompt();
+	present();
 }
 
 /**
-	Draws the status bar UI element into the console window.
+	Draws the status bar UI element into the frame.
 */
 void ConsoleUI::drawStatusBar() {
 	stringstream ss;
 
+	if (!progressMessage.empty()) {
+		ss << " " << progressMessage << " |";
+	}
 	ss << " lines : " << bufferSize << " SEL : " << this->currentLine << " ";
 	string lines = ss.str();
-	int width = getConsoleWidth() - statusMessage.size() - lines.size() - 1;
+	int row = screen.getHeight() - 1;
+	int width = screen.getWidth() - (int)statusMessage.size() - (int)lines.size() - 1;
+	int x = screen.write(0, row, " " + statusMessage, STATUS_COLOR);
 
-	cout << endl << endl;
-	setConsoleColor(143);
-	cout << " " << statusMessage;
-	setConsoleColor(136);
-	cout << setfill('*') << setw(width) << "";
-	setConsoleColor(143);
-	cout << lines << setfill(' ');
-	resetConsoleColor();
+	screen.fill(x, row, width, '*', STATUS_FILL_COLOR);
+	screen.write(x + max(width, 0), row, lines, STATUS_COLOR);
 
 	statusMessage = "";
 }
 
 /**
-	Prompts the user for input.
+	Prompts the user for input. In headless mode the next line of the input stream
+	is returned without drawing anything.
 */
 string ConsoleUI::promptForInput() {
-	string input;
+	PhaseTimer timer(metrics, PHASE_INPUT);
+	string text;
 
-	COORD pos = { 0, (short)getConsoleHeight() - 3 };
-	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
-	SetConsoleCursorPosition(output, pos);
-	cout << setw(getConsoleWidth()) << "\r : ";
-	getline(cin, input);
+	if (headless) {
+		getline(*input, text);
+		return text;
+	}
 
-	return input;
-}
+	int row = screen.getHeight() - 3;
+	int x = screen.write(0, row, " : ", TEXT_COLOR);
 
-/**
-	Sets the color of the console window.
-	@param color An integer representing the color to be used for drawing.
-*/
-void ConsoleUI::setConsoleColor(int color) {
-	HANDLE hstdout = GetStdHandle(STD_OUTPUT_HANDLE);
-	FlushConsoleInputBuffer(hstdout);
-	SetConsoleTextAttribute(hstdout, color);
-}
+	screen.fill(x, row, screen.getWidth() - x, ' ', TEXT_COLOR);
+	screen.setCursor(x, row);
+	present();
 
-/**
-	Resets the console window colors to their original state.
-*/
-void ConsoleUI::resetConsoleColor() {
-	setConsoleColor(15);
+	getline(cin, text);
+
+	// the typed text was echoed over the prompt row
+	screen.invalidateRow(row);
+
+	return text;
 }
 
 /**
@@ -283,6 +300,15 @@ void ConsoleUI::setHeaderInfo(string value) {
 	headerInfo = value;
 }
 
+/**
+	Gets the scroll position.
+	@returns The line number of the first line drawn by drawBuffer.
+*/
+int ConsoleUI::getScrollPosition()
+{
+	return scrollPosition;
+}
+
 /**
 	Sets the scrol position.
 	@param pos The new scroll position.
@@ -292,6 +318,32 @@ void ConsoleUI::setScrollPosition(int pos)
 	scrollPosition = pos;
 }
 
+/**
+	Checks whether the UI is headless.
+	@returns True if nothing is drawn and input comes from a stream other than the console.
+*/
+bool ConsoleUI::isHeadless() {
+	return headless;
+}
+
+/**
+	Turns the UI headless: nothing is drawn to the console anymore, and any text
+	the editor prompts for is read from the specified stream instead.
+	@param input The stream to read prompted text from.
+*/
+void ConsoleUI::setHeadless(istream& input) {
+	this->input = &input;
+	headless = true;
+}
+
+/**
+	Sets the metrics that drawing and prompting are timed into.
+	@param metrics The metrics, or NULL to stop timing.
+*/
+void ConsoleUI::setMetrics(Metrics *metrics) {
+	this->metrics = metrics;
+}
+
 /**
 	Sets the information to be displayed in the footer bar.
 */
@@ -299,10 +351,19 @@ void ConsoleUI::setFooterInfo(string value) {
 	footerInfo = value;
 }
 
+/**
+	Sets a message that stays in the status bar, next to the line count, until it is
+	changed. Used to report the progress of background work.
+	@param value The message to be displayed, or an empty string to remove it.
+*/
+void ConsoleUI::setProgressMessage(string value) {
+	progressMessage = value;
+}
+
 /**
 	Sets the message to be displayed in the status bar when the buffer has been redrawn.
 	@param value The message to be displayed.
 */
 void ConsoleUI::setStatusMessage(string value) {
 	statusMessage = value;
-}
\ No newline at end of file
+}
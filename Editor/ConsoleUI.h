@@ -1,7 +1,11 @@
 #ifndef CONSOLEUI_H
 #define CONSOLEUI_H
 
+#include "LineView.h"
+#include "Metrics.h"
+#include "ScreenBuffer.h"
 #include <sstream>
+#include <vector>
 using namespace std;
 
 class ConsoleUI
@@ -10,31 +14,43 @@ private:
 	string headerInfo;
 	string footerInfo;
 	string statusMessage = "";
+	string progressMessage = "";
+	ScreenBuffer screen;
+	istream *input;
+	Metrics *metrics;
+	bool headless;
+
+	void beginFrame();
+	void drawLine(int row, int line, LineView value, bool isCurrentLine);
+	void present();
 	
 protected:
 	int scrollPosition;
 	int bufferSize;
 	int currentLine;
 public:
-	ConsoleUI() : scrollPosition(1), bufferSize(0), currentLine(1) {};
+	ConsoleUI();
 	int calcAvailableBufferRoom();
 	int getConsoleHeight();
 	int getConsoleWidth();
+	int getScrollPosition();
+	bool isHeadless();
 	string promptForInput();
-	void drawBuffer(string, int, bool);
+	void drawBuffer(LineView, int, bool);
 	void drawBuffer(stringstream& ss, int);
-	void drawBuffer(stringstream& ss, int, int, int);
+	void drawBuffer(const vector<LineView>& lines, int, int);
 	void drawCommandPrompt();
-	void drawFooter(int);
+	void drawFooter();
 	void drawHeader();
 	void drawStatusBar();
-	void resetConsoleColor();
 	void setBufferSize(int);
-	void setConsoleColor(int);
 	void setFooterInfo(string);
 	void setHeaderInfo(string);
+	void setHeadless(istream& input);
+	void setMetrics(Metrics *metrics);
+	void setProgressMessage(string);
 	void setScrollPosition(int);
 	void setStatusMessage(string);
 };
 
-#endif CONSOLEUI_H
+#endif
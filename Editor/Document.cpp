@@ -0,0 +1,44 @@
+#include "Document.h"
+
+/**
+	Main constructor.
+	@param buffer The store holding the lines of the document, which the document
+	takes ownership of.
+	@param inPath The path of the file the document is loaded from.
+	@param outPath The path of the file the document is saved to.
+*/
+Document::Document(LineStore *buffer, string inPath, string outPath) :
+	buffer(buffer), inPath(inPath), outPath(outPath), currentLine(1), scrollPosition(1),
+	modified(false), saveReported(true), journalCheckpoint(-1), recoveredChanges(0) {
+}
+
+/**
+	Virtual destructor. Stops loading and waits for any save in progress before the
+	lines are freed, and frees them before the file they may point to is unmapped.
+*/
+Document::~Document() {
+	loader.stop();
+	saver.wait();
+	delete buffer;
+}
+
+/**
+	Records a change that was just applied to the buffer, in the undo history and in
+	the journal.
+	@param change The change.
+*/
+void Document::record(const Change& change) {
+	history.record(change, currentLine);
+	track(change);
+}
+
+/**
+	Keeps the journal and the trigram index up to date with a change that was just
+	applied to the buffer.
+	@param change The change.
+*/
+void Document::track(const Change& change) {
+	journal.append(change);
+	index.apply(change, *buffer);
+	modified = true;
+}
@@ -0,0 +1,50 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include "BackgroundSaver.h"
+#include "DocumentLoader.h"
+#include "EditHistory.h"
+#include "Journal.h"
+#include "LineStore.h"
+#include "MappedFile.h"
+#include "TrigramIndex.h"
+#include <string>
+
+using namespace std;
+
+/**
+	A file open in the editor: its lines, and everything that follows them, such as
+	their history, their journal and the line selected in them. The editor can hold
+	several documents and works on one at a time.
+*/
+class Document
+{
+public:
+	LineStore *buffer;
+	EditHistory history;
+	Journal journal;
+	MappedFile file;
+	DocumentLoader loader;
+	BackgroundSaver saver;
+	TrigramIndex index;
+	string inPath;
+	string outPath;
+	int currentLine;
+	int scrollPosition;
+	// Set by every change, cleared when a save to the output path starts.
+	bool modified;
+	bool saveReported;
+	long long journalCheckpoint;
+	// The number of changes replayed from the journal when the document was opened.
+	int recoveredChanges;
+
+	Document(LineStore *buffer, string inPath, string outPath);
+	Document(const Document&) = delete;
+	Document& operator=(const Document&) = delete;
+	virtual ~Document();
+
+	void record(const Change& change);
+	void track(const Change& change);
+};
+
+#endif
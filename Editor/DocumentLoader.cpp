@@ -0,0 +1,289 @@
+#include "DocumentLoader.h"
+#include "LineScanner.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iterator>
+
+// The document is split and handed over this many bytes at a time, to keep the lock
+// off the hot path.
+const size_t LOAD_CHUNK = 1024 * 1024;
+
+/**
+	Default constructor.
+*/
+DocumentLoader::DocumentLoader() : text(NULL), bytesRead(0), totalBytes(0), running(false), cancelled(false) {}
+
+/**
+	Virtual destructor. Abandons the load in progress, if any.
+*/
+DocumentLoader::~DocumentLoader() {
+	stop();
+}
+
+/**
+	Starts finding the lines of a document that is already in memory, such as a
+	mapped file, on a worker thread. The lines are added to the store as views, so
+	the memory must outlive both the load and the store's use of those lines. A load
+	already in progress is abandoned first.
+	@param text The contents of the document.
+	@param length The size of the document, in bytes.
+*/
+void DocumentLoader::start(const char *text, size_t length) {
+	stop();
+
+	this->text = text;
+	bytesRead = 0;
+	totalBytes = (long long)length;
+	cancelled = false;
+	running = true;
+
+	worker = thread(&DocumentLoader::readMapped, this);
+}
+
+/**
+	Starts reading a document line by line on a worker thread. A load already in
+	progress is abandoned first.
+	@param path The path of the file to read.
+*/
+void DocumentLoader::start(string path) {
+	stop();
+
+	this->path = path;
+	bytesRead = 0;
+	totalBytes = 0;
+	cancelled = false;
+	running = true;
+
+	worker = thread(&DocumentLoader::readStream, this);
+}
+
+/**
+	Abandons the load in progress, if any. Lines not yet added to a store are dropped.
+*/
+void DocumentLoader::stop() {
+	cancelled = true;
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+
+	pendingViews.clear();
+	pendingLines.clear();
+}
+
+/**
+	Checks if some of the document has yet to be added to a store.
+	@returns True while the worker is reading or lines are waiting to be drained.
+*/
+bool DocumentLoader::isLoading() {
+	lock_guard<mutex> guard(lock);
+	return running || !pendingViews.empty() || !pendingLines.empty();
+}
+
+/**
+	Gets the progress of the load in progress.
+	@returns The percentage of the document read so far.
+*/
+int DocumentLoader::getProgress() {
+	long long total = totalBytes;
+
+	if (total == 0) {
+		return running ? 0 : 100;
+	}
+
+	return (int)(bytesRead * 100 / total);
+}
+
+/**
+	Appends the lines read so far to the end of a store, without waiting for more.
+	Must be called from the thread that owns the store.
+	@param store The store to fill.
+	@returns The number of lines added.
+*/
+int DocumentLoader::drain(LineStore& store) {
+	vector<LineSpan> views;
+	vector<string> lines;
+
+	{
+		lock_guard<mutex> guard(lock);
+		views.swap(pendingViews);
+		lines.swap(pendingLines);
+	}
+
+	for (size_t i = 0; i < views.size(); i++) {
+		store.addView(views[i].text, views[i].length);
+	}
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		store.add(move(lines[i]));
+	}
+
+	return (int)(views.size() + lines.size());
+}
+
+/**
+	Blocks until a store holds at least a number of lines, or the whole document has
+	been added to it.
+	@param store The store to fill.
+	@param numLines The number of lines needed.
+*/
+void DocumentLoader::ensureLoaded(LineStore& store, int numLines) {
+	while (store.size() < numLines) {
+		{
+			unique_lock<mutex> guard(lock);
+			arrived.wait(guard, [this] { return !pendingViews.empty() || !pendingLines.empty() || !running; });
+
+			if (pendingViews.empty() && pendingLines.empty()) {
+				return;
+			}
+		}
+
+		drain(store);
+	}
+}
+
+/**
+	Blocks until the whole document has been added to a store.
+	@param store The store to fill.
+*/
+void DocumentLoader::finish(LineStore& store) {
+	ensureLoaded(store, INT_MAX);
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+/**
+	Hands a batch of lines over to the thread that owns the store.
+	@param views Lines that refer to the document; emptied.
+	@param lines Lines that were copied out of the document; emptied.
+*/
+void DocumentLoader::publish(vector<LineSpan>& views, vector<string>& lines) {
+	{
+		lock_guard<mutex> guard(lock);
+
+		if (pendingViews.empty()) {
+			pendingViews.swap(views);
+		}
+		else {
+			pendingViews.insert(pendingViews.end(), views.begin(), views.end());
+		}
+
+		if (pendingLines.empty()) {
+			pendingLines.swap(lines);
+		}
+		else {
+			pendingLines.insert(pendingLines.end(), make_move_iterator(lines.begin()), make_move_iterator(lines.end()));
+		}
+	}
+
+	views.clear();
+	lines.clear();
+	arrived.notify_all();
+}
+
+/**
+	Worker thread body for documents in memory. Splits the document at line breaks,
+	LF or CRLF, one chunk at a time.
+*/
+void DocumentLoader::readMapped() {
+	size_t length = (size_t)totalBytes.load();
+	size_t scanned = 0;
+	size_t lineStart = 0;
+	vector<size_t> breaks;
+	vector<LineSpan> views;
+	vector<string> none;
+
+	while (scanned < length && !cancelled) {
+		size_t chunk = min(LOAD_CHUNK, length - scanned);
+
+		breaks.clear();
+		LineScanner::findBreaks(text + scanned, chunk, scanned, breaks);
+		scanned += chunk;
+
+		for (size_t i = 0; i < breaks.size(); i++) {
+			views.push_back(LineScanner::trim(text + lineStart, breaks[i] - lineStart));
+			lineStart = breaks[i];
+		}
+
+		// the last line has no line break
+		if (scanned == length && lineStart < length) {
+			views.push_back(LineScanner::trim(text + lineStart, length - lineStart));
+		}
+
+		bytesRead = (long long)scanned;
+		publish(views, none);
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+		running = false;
+	}
+	arrived.notify_all();
+}
+
+/**
+	Worker thread body for documents read from a file. The file is read in chunks,
+	which are split at line breaks like a document in memory; a line that straddles
+	two chunks is put back together before it is handed over.
+*/
+void DocumentLoader::readStream() {
+	ifstream in;
+	vector<char> chunk(LOAD_CHUNK);
+	vector<size_t> breaks;
+	vector<LineSpan> none;
+	vector<string> lines;
+	string partial;
+	long long read = 0;
+
+	in.open(path, ios::binary);
+
+	if (in.is_open()) {
+		in.seekg(0, ios::end);
+		totalBytes = (long long)in.tellg();
+		in.seekg(0, ios::beg);
+
+		while (!cancelled && in.read(chunk.data(), chunk.size()).gcount() > 0) {
+			size_t length = (size_t)in.gcount();
+			size_t lineStart = 0;
+
+			breaks.clear();
+			LineScanner::findBreaks(chunk.data(), length, 0, breaks);
+
+			for (size_t i = 0; i < breaks.size(); i++) {
+				LineSpan line = LineScanner::trim(chunk.data() + lineStart, breaks[i] - lineStart);
+
+				if (!partial.empty()) {
+					partial.append(chunk.data() + lineStart, breaks[i] - lineStart);
+					line = LineScanner::trim(partial.data(), partial.size());
+				}
+
+				lines.push_back(string(line.text, line.length));
+				partial.clear();
+				lineStart = breaks[i];
+			}
+
+			partial.append(chunk.data() + lineStart, length - lineStart);
+			read += (long long)length;
+			bytesRead = read;
+			publish(none, lines);
+		}
+		in.close();
+	}
+
+	if (!cancelled && !partial.empty()) {
+		LineSpan line = LineScanner::trim(partial.data(), partial.size());
+		lines.push_back(string(line.text, line.length));
+	}
+
+	bytesRead = totalBytes.load();
+	publish(none, lines);
+
+	{
+		lock_guard<mutex> guard(lock);
+		running = false;
+	}
+	arrived.notify_all();
+}
@@ -0,0 +1,48 @@
+#ifndef DOCUMENTLOADER_H
+#define DOCUMENTLOADER_H
+
+#include "LineStore.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class DocumentLoader
+{
+private:
+	thread worker;
+	mutex lock;
+	condition_variable arrived;
+	vector<LineSpan> pendingViews;
+	vector<string> pendingLines;
+	const char *text;
+	string path;
+	atomic<long long> bytesRead;
+	atomic<long long> totalBytes;
+	atomic<bool> running;
+	atomic<bool> cancelled;
+
+	void publish(vector<LineSpan>& views, vector<string>& lines);
+	void readMapped();
+	void readStream();
+
+public:
+	DocumentLoader();
+	DocumentLoader(const DocumentLoader&) = delete;
+	DocumentLoader& operator=(const DocumentLoader&) = delete;
+	virtual ~DocumentLoader();
+	bool isLoading();
+	int getProgress();
+	int drain(LineStore& store);
+	void ensureLoaded(LineStore& store, int numLines);
+	void finish(LineStore& store);
+	void start(const char *text, size_t length);
+	void start(string path);
+	void stop();
+};
+
+#endif
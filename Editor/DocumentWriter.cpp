@@ -0,0 +1,272 @@
+#include "DocumentWriter.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Line breaks are written the way a text mode stream would write them.
+#ifdef _WIN32
+static const char LINE_BREAK[] = "\r\n";
+#else
+static const char LINE_BREAK[] = "\n";
+#endif
+static const size_t LINE_BREAK_LENGTH = sizeof(LINE_BREAK) - 1;
+
+/**
+	Main constructor.
+	@param bufferSize The number of bytes gathered before each write to the file.
+*/
+#ifdef _WIN32
+DocumentWriter::DocumentWriter(size_t bufferSize) : buffer(bufferSize), used(0), bytesWritten(0), hasLines(false), failed(false), file(INVALID_HANDLE_VALUE) {}
+#else
+DocumentWriter::DocumentWriter(size_t bufferSize) : buffer(bufferSize), used(0), bytesWritten(0), hasLines(false), failed(false), file(-1) {}
+#endif
+
+/**
+	Virtual destructor. Flushes and closes the file if it is still open.
+*/
+DocumentWriter::~DocumentWriter() {
+	close();
+}
+
+/**
+	Creates (or truncates) the file to write to.
+	@param path The path of the file.
+	@param replace Whether an existing file is truncated; if not, opening fails when
+	the file exists.
+	@returns True if the file was opened.
+*/
+bool DocumentWriter::open(string path, bool replace) {
+	close();
+
+	used = 0;
+	bytesWritten = 0;
+	hasLines = false;
+	failed = false;
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, replace ? CREATE_ALWAYS : CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+	return file != INVALID_HANDLE_VALUE;
+#else
+	file = ::open(path.c_str(), O_WRONLY | O_CREAT | (replace ? O_TRUNC : O_EXCL), 0666);
+	return file >= 0;
+#endif
+}
+
+/**
+	Gives the file the permissions, owner and group of another file, so that it can
+	take the other file's place. Does nothing on Windows, where replacing a file
+	keeps its attributes, or if the other file doesn't exist.
+	@param path The path of the other file.
+	@returns False if the permissions could not be applied.
+*/
+bool DocumentWriter::copyPermissions(string path) {
+#ifdef _WIN32
+	return file != INVALID_HANDLE_VALUE;
+#else
+	struct stat status;
+
+	if (file < 0) {
+		return false;
+	}
+
+	if (stat(path.c_str(), &status) != 0) {
+		return true;
+	}
+
+	if (fchown(file, status.st_uid, status.st_gid) != 0) {
+		// only the superuser may give the file away: the user saving it keeps it,
+		// without the set-id bits, and with the group of the other file if they
+		// belong to it, or else without the permissions of that group
+		status.st_mode &= ~(S_ISUID | S_ISGID);
+
+		if (fchown(file, (uid_t)-1, status.st_gid) != 0) {
+			status.st_mode &= ~S_IRWXG;
+		}
+	}
+
+	return fchmod(file, status.st_mode & 07777) == 0;
+#endif
+}
+
+/**
+	Writes bytes straight to the file, bypassing the buffer.
+	@param data The bytes to write.
+	@param length The number of bytes.
+	@returns True if every byte was written.
+*/
+bool DocumentWriter::writeDirect(const char *data, size_t length) {
+	while (length > 0 && !failed) {
+#ifdef _WIN32
+		DWORD chunk = length > 0x40000000 ? 0x40000000 : (DWORD)length;
+		DWORD written = 0;
+
+		if (!WriteFile(file, data, chunk, &written, NULL) || written == 0) {
+			failed = true;
+		}
+#else
+		ssize_t written = ::write(file, data, length);
+
+		if (written <= 0) {
+			failed = true;
+			written = 0;
+		}
+#endif
+		data += written;
+		length -= written;
+		bytesWritten += written;
+	}
+
+	return !failed;
+}
+
+/**
+	Writes out whatever is gathered in the buffer.
+	@returns True if the write succeeded.
+*/
+bool DocumentWriter::flush() {
+	bool ok = writeDirect(buffer.data(), used);
+
+	used = 0;
+	return ok;
+}
+
+/**
+	Appends lines to the file, separated by line breaks, without a break after the
+	last line of the document. Lines are gathered into the buffer so that the file
+	sees one large write per buffer, rather than one or more per line. Lines larger
+	than the buffer are written in place, without being copied. On POSIX systems
+	the buffered bytes and such a line go out in a single writev call.
+	@param lines The lines to write.
+	@param count The number of lines.
+	@returns False if a write to the file failed.
+*/
+bool DocumentWriter::writeLines(const LineSpan *lines, size_t count) {
+	for (size_t i = 0; i < count && !failed; i++) {
+		size_t needed = lines[i].length + LINE_BREAK_LENGTH;
+
+		if (used + needed > buffer.size() && used > 0) {
+			if (needed <= buffer.size()) {
+				flush();
+			}
+		}
+
+		if (hasLines) {
+			if (used + LINE_BREAK_LENGTH > buffer.size()) {
+				flush();
+			}
+			memcpy(&buffer[used], LINE_BREAK, LINE_BREAK_LENGTH);
+			used += LINE_BREAK_LENGTH;
+		}
+		hasLines = true;
+
+		if (used + lines[i].length <= buffer.size()) {
+			memcpy(&buffer[used], lines[i].text, lines[i].length);
+			used += lines[i].length;
+			continue;
+		}
+
+#ifdef _WIN32
+		flush();
+		writeDirect(lines[i].text, lines[i].length);
+#else
+		struct iovec parts[2];
+		parts[0].iov_base = buffer.data();
+		parts[0].iov_len = used;
+		parts[1].iov_base = (void*)lines[i].text;
+		parts[1].iov_len = lines[i].length;
+
+		ssize_t written = writev(file, parts, 2);
+		size_t total = used + lines[i].length;
+
+		if (written < 0) {
+			failed = true;
+			break;
+		}
+		bytesWritten += written;
+
+		// finish whatever part of the two buffers a short write left behind
+		if ((size_t)written < used) {
+			writeDirect(buffer.data() + written, used - written);
+			writeDirect(lines[i].text, lines[i].length);
+		}
+		else if ((size_t)written < total) {
+			writeDirect(lines[i].text + (written - used), total - written);
+		}
+		used = 0;
+#endif
+	}
+
+	return !failed;
+}
+
+/**
+	Flushes the buffer and waits until the file's contents have reached the disk, so
+	that they survive a crash of the system.
+	@returns True if everything was written and the file was synced.
+*/
+bool DocumentWriter::sync() {
+#ifdef _WIN32
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	if (flush() && !FlushFileBuffers(file)) {
+		failed = true;
+	}
+#else
+	if (file < 0) {
+		return false;
+	}
+
+	if (flush() && fsync(file) != 0) {
+		failed = true;
+	}
+#endif
+
+	return !failed;
+}
+
+/**
+	Flushes the buffer and closes the file.
+	@returns True if everything was written and the file closed cleanly.
+*/
+bool DocumentWriter::close() {
+#ifdef _WIN32
+	if (file == INVALID_HANDLE_VALUE) {
+		return !failed;
+	}
+
+	flush();
+	if (!CloseHandle(file)) {
+		failed = true;
+	}
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (file < 0) {
+		return !failed;
+	}
+
+	flush();
+	if (::close(file) != 0) {
+		failed = true;
+	}
+	file = -1;
+#endif
+
+	return !failed;
+}
+
+/**
+	Gets the number of bytes written to the file so far.
+	@returns The number of bytes.
+*/
+long long DocumentWriter::getBytesWritten() {
+	return bytesWritten;
+}
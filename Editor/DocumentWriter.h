@@ -0,0 +1,42 @@
+#ifndef DOCUMENTWRITER_H
+#define DOCUMENTWRITER_H
+
+#include "LineStore.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const size_t DEFAULT_WRITE_BUFFER_SIZE = 1024 * 1024;
+
+class DocumentWriter
+{
+private:
+	vector<char> buffer;
+	size_t used;
+	long long bytesWritten;
+	bool hasLines;
+	bool failed;
+#ifdef _WIN32
+	void *file;
+#else
+	int file;
+#endif
+
+	bool flush();
+	bool writeDirect(const char *data, size_t length);
+
+public:
+	DocumentWriter(size_t bufferSize = DEFAULT_WRITE_BUFFER_SIZE);
+	DocumentWriter(const DocumentWriter&) = delete;
+	DocumentWriter& operator=(const DocumentWriter&) = delete;
+	virtual ~DocumentWriter();
+	bool close();
+	bool copyPermissions(string path);
+	bool open(string path, bool replace = true);
+	bool sync();
+	bool writeLines(const LineSpan *lines, size_t count);
+	long long getBytesWritten();
+};
+
+#endif
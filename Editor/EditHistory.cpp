@@ -0,0 +1,171 @@
+#include "EditHistory.h"
+
+/**
+	Estimates the memory held by a change: the text of every line it stores plus the
+	bookkeeping of the strings themselves. Unchanged lines are never stored, so the
+	cost of an entry is proportional to the edit, not to the document.
+	@param change The change to measure.
+	@returns The approximate number of bytes.
+*/
+size_t EditHistory::measure(const Change& change) {
+	size_t bytes = sizeof(Change);
+
+	for (size_t i = 0; i < change.removed.size(); i++) {
+		bytes += sizeof(string) + change.removed[i].capacity();
+	}
+	for (size_t i = 0; i < change.inserted.size(); i++) {
+		bytes += sizeof(string) + change.inserted[i].capacity();
+	}
+
+	return bytes;
+}
+
+/**
+	Records a change that has just been applied to the buffer. Recording a change
+	discards everything that could have been redone. When the history grows past its
+	memory limit, the oldest entries are forgotten.
+	@param change The change that was applied.
+	@param selectedLine The line that was selected before the change.
+*/
+void EditHistory::record(const Change& change, int selectedLine) {
+	record(vector<Change>(1, change), selectedLine);
+}
+
+/**
+	Records a group of changes that are undone and redone together, in the order
+	they were applied.
+	@param changes The changes that were applied.
+	@param selectedLine The line that was selected before the changes.
+*/
+void EditHistory::record(vector<Change> changes, int selectedLine) {
+	HistoryEntry entry;
+
+	if (changes.empty()) {
+		return;
+	}
+
+	for (size_t i = 0; i < changes.size(); i++) {
+		entry.memoryUsage += measure(changes[i]);
+	}
+
+	entry.changes = move(changes);
+	entry.selectedLine = selectedLine;
+
+	redoEntries.clear();
+	redoMemory = 0;
+
+	undoMemory += entry.memoryUsage;
+	undoEntries.push_back(move(entry));
+
+	while (undoMemory > memoryLimit && undoEntries.size() > 1) {
+		undoMemory -= undoEntries.front().memoryUsage;
+		undoEntries.pop_front();
+	}
+}
+
+/**
+	Reverts the most recent change, applying the inverse of each of its changes in
+	reverse order.
+	@param store The store the change was applied to.
+	@param selectedLine Receives the line that was selected before the change.
+	@param applied If not NULL, receives the inverse changes, as they were applied.
+	@returns The position (1 based) of the first line affected, or 0 if there was
+	nothing to undo.
+*/
+int EditHistory::undo(LineStore& store, int& selectedLine, vector<Change> *applied) {
+	if (undoEntries.empty()) {
+		return 0;
+	}
+
+	HistoryEntry entry = move(undoEntries.back());
+	undoEntries.pop_back();
+	undoMemory -= entry.memoryUsage;
+
+	for (size_t i = entry.changes.size(); i > 0; i--) {
+		Change& change = entry.changes[i - 1];
+		store.replaceRange(change.position, (int)change.inserted.size(), change.removed);
+
+		if (applied != NULL) {
+			Change inverse;
+			inverse.position = change.position;
+			inverse.removed = change.inserted;
+			inverse.inserted = change.removed;
+			applied->push_back(inverse);
+		}
+	}
+
+	int position = entry.changes[0].position + 1;
+
+	selectedLine = entry.selectedLine;
+	redoMemory += entry.memoryUsage;
+	redoEntries.push_back(move(entry));
+
+	return position;
+}
+
+/**
+	Reapplies the most recently undone change.
+	@param store The store the change was undone on.
+	@param applied If not NULL, receives the changes, as they were applied.
+	@returns The position (1 based) of the first line affected, or 0 if there was
+	nothing to redo.
+*/
+int EditHistory::redo(LineStore& store, vector<Change> *applied) {
+	if (redoEntries.empty()) {
+		return 0;
+	}
+
+	HistoryEntry entry = move(redoEntries.back());
+	redoEntries.pop_back();
+	redoMemory -= entry.memoryUsage;
+
+	for (size_t i = 0; i < entry.changes.size(); i++) {
+		Change& change = entry.changes[i];
+		store.replaceRange(change.position, (int)change.removed.size(), change.inserted);
+
+		if (applied != NULL) {
+			applied->push_back(change);
+		}
+	}
+
+	int position = entry.changes[0].position + 1;
+
+	undoMemory += entry.memoryUsage;
+	undoEntries.push_back(move(entry));
+
+	return position;
+}
+
+/**
+	Checks if there is a change to undo.
+	@returns True if undo would do something.
+*/
+bool EditHistory::canUndo() {
+	return !undoEntries.empty();
+}
+
+/**
+	Checks if there is a change to redo.
+	@returns True if redo would do something.
+*/
+bool EditHistory::canRedo() {
+	return !redoEntries.empty();
+}
+
+/**
+	Gets the approximate memory held by the history.
+	@returns The number of bytes used by the undo and redo entries.
+*/
+size_t EditHistory::memoryUsage() {
+	return undoMemory + redoMemory;
+}
+
+/**
+	Forgets every recorded change.
+*/
+void EditHistory::clear() {
+	undoEntries.clear();
+	redoEntries.clear();
+	undoMemory = 0;
+	redoMemory = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include "LineStore.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const size_t DEFAULT_HISTORY_LIMIT = 64 * 1024 * 1024;
+
+struct Change
+{
+public:
+	Change() : position(0) {}
+
+	int position;
+	vector<string> removed;
+	vector<string> inserted;
+};
+
+struct HistoryEntry
+{
+public:
+	HistoryEntry() : selectedLine(1), memoryUsage(0) {}
+
+	vector<Change> changes;
+	int selectedLine;
+	size_t memoryUsage;
+};
+
+class EditHistory
+{
+private:
+	deque<HistoryEntry> undoEntries;
+	vector<HistoryEntry> redoEntries;
+	size_t memoryLimit;
+	size_t undoMemory;
+	size_t redoMemory;
+
+	static size_t measure(const Change& change);
+
+public:
+	EditHistory(size_t memoryLimit = DEFAULT_HISTORY_LIMIT) : memoryLimit(memoryLimit), undoMemory(0), redoMemory(0) {}
+	bool canRedo();
+	bool canUndo();
+	int redo(LineStore& store, vector<Change> *applied = NULL);
+	int undo(LineStore& store, int& selectedLine, vector<Change> *applied = NULL);
+	size_t memoryUsage();
+	void clear();
+	void record(const Change& change, int selectedLine);
+	void record(vector<Change> changes, int selectedLine);
+};
+
+#endif
@@ -1,191 +1,809 @@
 #include "Editor.h"
 #include "ConsoleUI.h"
 #include <fstream>
-#include <regex>
 #include <Windows.h>
 #include <sstream>
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <iostream>
+#include <vector>
 
 using namespace std;
 
+// Scripts commit their journal in groups instead of once per change.
+const int BATCH_JOURNAL_GROUP = 256;
+const int BATCH_JOURNAL_WINDOW = 100;
+
+// Searches visit this many lines per walk of the buffer.
+const int SEARCH_WINDOW = 4096;
+
+// Replacements split the buffer into this many chunks per thread, so that a thread
+// that finishes early can pick up more work. Chunks are at most a search window,
+// and are handed out a round of this many per thread at a time.
+const int REPLACE_CHUNKS_PER_THREAD = 4;
+const int MIN_REPLACE_CHUNK = 1024;
+
+// A line rewritten by a replacement.
+struct LineEdit
+{
+	int position;
+	string before;
+	string after;
+};
+
+/**
+	Replaces every occurrence of a pattern in a line.
+	@param search The pattern.
+	@param replacement The text to put in its place.
+	@param line The line.
+	@param result Receives the rewritten line, if there was a match.
+	@returns The number of occurrences replaced.
+*/
+static int replaceInLine(const TextSearch& search, const string& replacement, LineSpan line, string& result) {
+	const char *start = line.text;
+	const char *end = line.text + line.length;
+	size_t patternLength = search.getPattern().size();
+	int numMatches = 0;
+
+	while (const char *match = search.find(start, end - start)) {
+		if (numMatches == 0) {
+			result.clear();
+		}
+
+		result.append(start, match - start);
+		result += replacement;
+		start = match + patternLength;
+		numMatches++;
+	}
+
+	if (numMatches > 0) {
+		result.append(start, end - start);
+	}
+
+	return numMatches;
+}
+
 /**
 	Main constructor.
 	@param inPath The path of the file to be loaded.
 	@param outPath The path of the file to output the changes to.
+	@param storeType The container used to hold the lines of the document.
+	@param loadMode How the input file is read into the buffer.
+	@param memoryLimit The memory the lines of all the buffers may take when they are
+	paged or compressed, in bytes, or 0 for the default of the store.
+*/
+Editor::Editor(std::string inPath, std::string outPath, StoreType storeType, LoadMode loadMode, size_t memoryLimit) {
+	this->loadMode = loadMode;
+
+	console.setMetrics(&metrics);
+	addDocument(LineStore::create(storeType, memoryLimit), inPath, outPath);
+	updateProgress();
+}
+
+/**
+	Virtual destructor.
+*/
+Editor::~Editor() {
+	for (size_t i = 0; i < documents.size(); i++) {
+		delete documents[i];
+	}
+
+	if (!statsPath.empty() && !metrics.writeReport(statsPath)) {
+		cerr << "Could not write statistics to : \'" << statsPath << "\'" << endl;
+	}
+}
+
+/**
+	Opens a document in a new buffer and selects it. Changes recovered from the
+	document's journal are reported in the status bar, or on the standard error
+	stream by scripts.
+	@param buffer The empty store to load the document into.
+	@param inPath The path of the file to be loaded.
+	@param outPath The path of the file to output the changes to.
+*/
+void Editor::addDocument(LineStore *buffer, string inPath, string outPath) {
+	documents.push_back(new Document(buffer, inPath, outPath));
+	activate(documents.back());
+
+	if (console.isHeadless()) {
+		doc->journal.setGroupCommit(BATCH_JOURNAL_GROUP, BATCH_JOURNAL_WINDOW);
+	}
+	openDocument(inPath, loadMode);
+
+	// the journal's positions refer to the whole document
+	if (Journal::exists(inPath)) {
+		doc->loader.finish(*doc->buffer);
+	}
+
+	doc->recoveredChanges = doc->journal.recover(inPath, *doc->buffer);
+
+	if (doc->recoveredChanges > 0) {
+		stringstream ss;
+		ss << "Recovered " << doc->recoveredChanges << " changes from the journal";
+		console.setStatusMessage(ss.str());
+		doc->modified = true;
+
+		if (console.isHeadless()) {
+			cerr << ss.str() << " of \'" << inPath << "\'" << endl;
+		}
+	}
+}
+
+/**
+	Makes a document the one commands work on, restoring its scroll position.
+	@param document The document.
 */
-Editor::Editor(std::string inPath, std::string outPath) {
-	this->inPath = inPath;
-	this->outPath = outPath;
+void Editor::activate(Document *document) {
+	if (doc != NULL) {
+		doc->scrollPosition = console.getScrollPosition();
+	}
 
-	console.setHeaderInfo(inPath);
-	console.setFooterInfo(outPath);
-	openDocument(inPath);
+	doc = document;
+	closeRequest = NULL;
+	console.setScrollPosition(doc->scrollPosition);
+	console.setHeaderInfo(doc->inPath);
+	console.setFooterInfo(doc->outPath);
 }
 
 /**
 	Parses incoming commands. If the command is valid, the associated method is called.
 	@param command The command string to parse.
+	@returns True if the command was recognized, false otherwise.
 */
-void Editor::parseCommand(const std::string command) {
-	smatch match;
+bool Editor::parseCommand(const std::string& command) {
+	Command cmd;
+	bool recognized;
+
+	metrics.beginCommand();
+	metrics.enter(PHASE_PARSE);
+	recognized = CommandParser::parse(command, cmd);
+	metrics.leave();
+
+	if (!recognized) {
+		stringstream ss;
+		ss << "Unrecognized command : \'" << command << "\'";
+		console.setStatusMessage(ss.str());
+		displayBuffer();
+		metrics.endCommand(CMD_COUNT, false);
+		return false;
+	}
 
-	// DELETE command (D)
-	if (regex_search(command, match, regex(DELETE_REGEX))) {
-		string paramA = match[1].str();
-		string paramB = match[2].str();
+	metrics.enter(PHASE_IO);
+	ensureLoaded(cmd);
+	metrics.leave();
+	updateProgress();
 
-		if (paramA.empty() && paramB.empty()) {
+	// closing a modified buffer takes two K in a row
+	if (cmd.type != CMD_CLOSE) {
+		closeRequest = NULL;
+	}
+
+	switch (cmd.type) {
+	case CMD_DELETE:
+		if (cmd.numArgs == 0) {
 			deleteLine();
 		}
-		else if (paramB.empty()) {
-			deleteLine(stoi(paramA));
+		else if (cmd.numArgs == 1) {
+			deleteLine(cmd.args[0]);
 		}
 		else {
-			deleteRange(stoi(paramA), stoi(paramB));
+			deleteRange(cmd.args[0], cmd.args[1]);
 		}
-	}
+		break;
 
-	// VIEW command (V)
-	else if (regex_match(command, regex(VIEW_REGEX))) {
+	case CMD_VIEW:
 		displayBuffer();
-	}
+		break;
+
+	case CMD_COPY:
+	case CMD_COPY_TO:
+	case CMD_MOVE:
+	case CMD_MOVE_TO:
+		if (cmd.numArgs == 0) {
+			console.setStatusMessage(cmd.type == CMD_COPY || cmd.type == CMD_MOVE ?
+				"Missing the line to put the block after" : "Missing the buffer to put the block in");
+			displayBuffer();
+			break;
+		}
+
+		{
+			int from = cmd.numArgs == 1 ? doc->currentLine : cmd.args[0];
+			int to = cmd.numArgs == 3 ? cmd.args[1] : from;
+			int target = cmd.args[cmd.numArgs - 1];
+
+			if (cmd.type == CMD_COPY) {
+				copyLines(from, to, target);
+			}
+			else if (cmd.type == CMD_MOVE) {
+				moveLines(from, to, target);
+			}
+			else {
+				transferLines(from, to, target, cmd.type == CMD_MOVE_TO);
+			}
+		}
+		break;
+
+	case CMD_OPEN:
+		openFile();
+		break;
+
+	case CMD_BUFFER:
+		if (cmd.numArgs > 0) {
+			selectDocument(cmd.args[0]);
+		}
+		else {
+			listDocuments();
+		}
+		break;
 
-	// INSERT command (I)
-	else if (regex_search(command, match, regex(INSERT_REGEX))) {
-		string param = match[1].str();
-		if (!param.empty()) {
-			insertLine(std::stoi(param));
+	case CMD_CLOSE:
+		if (cmd.numArgs > 0) {
+			closeDocument(cmd.args[0]);
+		}
+		else {
+			closeDocument((int)(std::find(documents.begin(), documents.end(), doc) - documents.begin()) + 1);
+		}
+		break;
+
+	case CMD_PASTE:
+		pasteFile(cmd.numArgs > 0 ? cmd.args[0] : doc->currentLine);
+		break;
+
+	case CMD_INSERT:
+		if (cmd.numArgs > 0) {
+			insertLine(cmd.args[0]);
 		}
 		else {
 			insertBeforeCurrentLine();
 		}
-	}
+		break;
 
-	// GOTO command (G)
-	else if (regex_search(command, match, regex(GOTO_REGEX))) {
-		string param = match[1].str();
-		if (!param.empty()) {
-			goToLine(std::stoi(param));
+	case CMD_GOTO:
+		if (cmd.numArgs > 0) {
+			goToLine(cmd.args[0]);
 		}
 		else {
 			goToLine();
 		}
-	}
-
-	// LIST command (L)
-	else if (regex_search(command, match, regex(LIST_REGEX))) {
-		string paramA = match[1].str();
-		string paramB = match[2].str();
+		break;
 
-		if (paramA.empty() && paramB.empty()) {
+	case CMD_LIST:
+		if (cmd.numArgs == 0) {
 			list();
 		}
-		else if (paramB.empty()) {
-			list(stoi(paramA));
+		else if (cmd.numArgs == 1) {
+			list(cmd.args[0]);
 		}
 		else {
-			list(stoi(paramA), stoi(paramB));
+			list(cmd.args[0], cmd.args[1]);
 		}
-	}
+		break;
 
-	// SUBSTITUTE command (S)
-	else if (regex_search(command, match, regex(SUB_REGEX))) {
-		string param = match[1].str();
-		if (!param.empty()) {
-			substituteLine(std::stoi(param));
+	case CMD_SUBSTITUTE:
+		if (cmd.numArgs > 0) {
+			substituteLine(cmd.args[0]);
 		}
 		else {
 			substituteCurrentLine();
 		}
-	}
+		break;
 
-	// POSITION command (P)
-	else if (regex_search(command, match, regex(POSITION_REGEX))) {
-		string param = match[1].str();
-		if (!param.empty()) {
-			scrollToPosition(stoi(param));
+	case CMD_POSITION:
+		if (cmd.numArgs > 0) {
+			scrollToPosition(cmd.args[0]);
 		}
 		else {
 			scrollToCurrent();
 		}
-	}
+		break;
 
-	// EXIT command
-	else if (regex_search(command, match, regex(QUIT_REGEX))) {
+	case CMD_QUIT:
+		for (size_t i = 0; i < documents.size(); i++) {
+			documents[i]->journal.discard();
+		}
 		exit();
-	}
+		break;
 
-	// HELP command
-	else if (regex_search(command, match, regex(HELP_REGEX))) {
+	case CMD_HELP:
 		displayHelpInfo();
-	}
+		break;
+
+	case CMD_UNDO:
+		undo();
+		break;
+
+	case CMD_REDO:
+		redo();
+		break;
 
-	else if (regex_search(command, match, regex(SAVE_EXIT_REGEX))) {
-		saveDocument(outPath);
+	case CMD_WRITE:
+		saveInBackground();
+		break;
+
+	case CMD_FIND:
+		find();
+		break;
+
+	case CMD_REPLACE:
+		replace(CommandParser::unescape(command, cmd.pattern), CommandParser::unescape(command, cmd.replacement), cmd);
+		break;
+
+	case CMD_FIND_NEXT:
+		findNext();
+		break;
+
+	case CMD_INDEX:
+		toggleIndex();
+		break;
+
+	case CMD_STATS:
+		showStats();
+		break;
+
+	case CMD_SAVE_EXIT:
+		saveAll();
 		exit();
+		break;
+
+	case CMD_COUNT:
+		// not a command; the parser never produces it
+		break;
+	}
+
+	metrics.enter(PHASE_IO);
+	for (size_t i = 0; i < documents.size(); i++) {
+		documents[i]->journal.commit();
+		// nothing holds views of the lines from one command to the next
+		documents[i]->buffer->expireViews();
+	}
+	metrics.leave();
+	metrics.endCommand(cmd.type, true);
+	return true;
+}
+
+/**
+	Applies a command script to the buffer without drawing anything. Each line of the
+	script is a command; the text of I, S and F commands, and the path of A and O
+	commands, is read from the line that follows them, whether or not the command
+	can be applied. Blank lines and lines starting with '#' are skipped. Unless the script ends with E or Q, the buffers are saved
+	as E saves them once the script is exhausted. A summary is written to the
+	standard error stream, along with every save that failed.
+	@param script The stream to read commands from.
+	@returns The number of unrecognized commands and failed saves.
+*/
+int Editor::runScript(istream& script) {
+	string cmd;
+	int numCommands = 0;
+	int numErrors = 0;
+
+	console.setHeadless(script);
+	failedSaves = 0;
+	for (size_t i = 0; i < documents.size(); i++) {
+		documents[i]->journal.setGroupCommit(BATCH_JOURNAL_GROUP, BATCH_JOURNAL_WINDOW);
+
+		// the commands may have been written for the file without those changes
+		if (documents[i]->recoveredChanges > 0) {
+			cerr << "Recovered " << documents[i]->recoveredChanges << " changes from the journal of \'"
+				<< documents[i]->inPath << "\'" << endl;
+		}
+	}
+	auto start = chrono::steady_clock::now();
+
+	while (!shouldExit && getline(script, cmd)) {
+		if (!cmd.empty() && cmd[cmd.size() - 1] == '\r') {
+			cmd.erase(cmd.size() - 1);
+		}
+
+		if (cmd.empty() || cmd[0] == '#') {
+			continue;
+		}
+
+		if (!parseCommand(cmd)) {
+			cerr << "command " << numCommands + 1 << ": unrecognized command \'" << cmd << "\'" << endl;
+			numErrors++;
+		}
+		numCommands++;
+	}
+
+	if (!shouldExit) {
+		saveAll();
+	}
+	for (size_t i = 0; i < documents.size(); i++) {
+		documents[i]->journal.sync();
+	}
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	double seconds = elapsed.count();
+
+	cerr << "Executed " << numCommands << " commands in " << seconds << " s";
+	if (seconds > 0) {
+		cerr << " (" << (long long)(numCommands / seconds) << " commands/sec)";
+	}
+	cerr << ", " << doc->buffer->size() << " lines in buffer" << endl;
+
+	return numErrors + failedSaves;
+}
+
+/**
+	Prompts for the path of a file and opens it in a new buffer, or selects the
+	buffer it is already open in. The new buffer shares the storage of the others.
+	Unless setBatchRecovery allowed it, scripts don't open files whose journal holds
+	changes to recover.
+*/
+void Editor::openFile() {
+	string path = console.promptForInput();
+	stringstream ss;
+
+	if (path.empty()) {
+		console.setStatusMessage("Nothing to open");
+		displayBuffer();
+		return;
+	}
+
+	for (size_t i = 0; i < documents.size(); i++) {
+		if (documents[i]->inPath == path) {
+			selectDocument((int)i + 1);
+			return;
+		}
 	}
 
+	if (console.isHeadless() && !batchRecovery && Journal::hasChanges(path)) {
+		ss << "Not opening \"" << path << "\" : its journal holds changes to recover";
+		cerr << ss.str() << endl;
+		console.setStatusMessage(ss.str());
+		return;
+	}
+
+	ss << "Opened \"" << path << "\" in buffer " << documents.size() + 1;
+	console.setStatusMessage(ss.str());
+	addDocument(doc->buffer->createSibling(), path, path);
+	updateProgress();
+	displayBuffer();
+}
+
+/**
+	Selects a buffer, which commands work on from then on.
+	@param number The number of the buffer, starting at 1.
+*/
+void Editor::selectDocument(int number) {
+	stringstream ss;
+
+	if (number < 1 || number > (int)documents.size()) {
+		ss << "No buffer " << number;
+	}
 	else {
-		stringstream ss;
-		ss << "Unrecognized command : \'" << command << "\'";
+		activate(documents[number - 1]);
+		ss << "Buffer " << number << " : \"" << doc->inPath << "\"";
+	}
+
+	updateProgress();
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Closes a buffer. A buffer with unsaved changes is only closed if K is given
+	twice in a row; its journal is discarded with it. The last buffer can't be
+	closed.
+	@param number The number of the buffer, starting at 1.
+*/
+void Editor::closeDocument(int number) {
+	stringstream ss;
+
+	if (number < 1 || number > (int)documents.size()) {
+		ss << "No buffer " << number;
 		console.setStatusMessage(ss.str());
 		displayBuffer();
+		return;
+	}
+
+	if (documents.size() == 1) {
+		console.setStatusMessage("Cannot close the only buffer");
+		displayBuffer();
+		return;
+	}
+
+	Document *target = documents[number - 1];
+
+	target->saver.wait();
+	settleSave(*target);
+
+	if (target->modified && closeRequest != target) {
+		closeRequest = target;
+		ss << "Buffer " << number << " has unsaved changes; K again discards them";
+		console.setStatusMessage(ss.str());
+		displayBuffer();
+		return;
+	}
+
+	documents.erase(documents.begin() + (number - 1));
+
+	if (target == doc) {
+		activate(documents[min(number - 1, (int)documents.size() - 1)]);
+	}
+
+	target->journal.discard();
+	delete target;
+	closeRequest = NULL;
+
+	ss << "Closed buffer " << number;
+	updateProgress();
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Lists the open buffers: their number, size and paths, whether they have unsaved
+	changes, and which one is selected.
+*/
+void Editor::listDocuments() {
+	stringstream ss;
+
+	for (size_t i = 0; i < documents.size(); i++) {
+		Document *document = documents[i];
+
+		ss << (document == doc ? "> " : "  ") << i + 1 << (document->modified ? " * " : "   ")
+			<< document->buffer->size() << " lines  \"" << document->inPath << "\"";
+
+		if (document->outPath != document->inPath) {
+			ss << " -> \"" << document->outPath << "\"";
+		}
+		ss << endl;
+	}
+
+	console.setStatusMessage("Open buffers");
+	console.drawBuffer(ss, 0);
+}
+
+/**
+	Starts loading a text-based document into the line store buffer. The document is
+	read on a background thread and its lines are added to the buffer as commands
+	need them, so that the first screen can be drawn before the whole file is read.
+	@param path The path of the file to open.
+	@param loadMode Whether to read the file line by line or to map it into memory.
+*/
+void Editor::openDocument(std::string path, LoadMode loadMode) {
+	if (loadMode == MAPPED_LOAD) {
+		mapDocument(path);
+		return;
 	}
+
+	doc->loader.start(path);
 }
 
 /**
-	Loads a text-based document, saving each line into a StringLinkedList buffer
+	Maps a document into memory and starts adding each line to the buffer as a view
+	into the mapping. Lines are only copied when they are modified, so loading costs
+	little more than finding the line breaks. Falls back to a streamed load if the
+	file cannot be mapped.
 	@param path The path of the file to open.
 */
-void Editor::openDocument(std::string path) {
-	ifstream in;
-	string temp;
+void Editor::mapDocument(std::string path) {
+	if (!doc->file.open(path)) {
+		openDocument(path, STREAM_LOAD);
+		return;
+	}
+
+	doc->loader.start(doc->file.data(), doc->file.size());
+}
+
+/**
+	Adds the lines loaded so far to the buffer, then waits for any line a command
+	refers to that has not been loaded yet, or for the whole document if the command
+	works on all of it.
+	@param cmd The command about to run.
+*/
+void Editor::ensureLoaded(const Command& cmd) {
+	int last = 0;
+
+	switch (cmd.type) {
+	case CMD_FIND:
+	case CMD_FIND_NEXT:
+	case CMD_INDEX:
+	case CMD_REPLACE:
+	case CMD_SAVE_EXIT:
+	case CMD_WRITE:
+		doc->loader.finish(*doc->buffer);
+		return;
+
+	default:
+		doc->loader.drain(*doc->buffer);
+		break;
+	}
+
+	for (int i = 0; i < cmd.numArgs; i++) {
+		last = max(last, cmd.args[i]);
+	}
+
+	if (last > 0) {
+		doc->loader.ensureLoaded(*doc->buffer, last);
+	}
+}
+
+/**
+	Starts saving the buffer on a background thread, once any save in progress has
+	finished. Saving to "-" writes to the standard output instead, synchronously.
+	@param path The path of the file to save the buffer to.
+*/
+void Editor::beginSave(string path) {
+	PhaseTimer timer(&metrics, PHASE_IO);
+
+	doc->loader.finish(*doc->buffer);
+	doc->saveReported = false;
 
-	in.open(path);
-	if (in.fail()) {
-		//throw FileIOException();
+	if (path == doc->outPath) {
+		doc->modified = false;
 	}
 
-	if (in.is_open()) {
-		while (getline(in, temp)) {
-			linkedList.add(temp);
+	if (path == "-") {
+		doc->saver.wait();
+		cout << *doc->buffer;
+		cout.flush();
+
+		// writing stopped at lines that could not be read back
+		if (!doc->buffer->isIntact() && path == doc->outPath) {
+			doc->modified = true;
 		}
-		in.close();
+		return;
+	}
+
+	if (path == doc->inPath) {
+		doc->journalCheckpoint = doc->journal.checkpoint();
+	}
+
+#ifdef _WIN32
+	// A mapped file can't be replaced; detach the buffer from the input first.
+	if (doc->file.isOpen() && path == doc->inPath) {
+		doc->saver.wait();
+		doc->buffer->releaseViews();
+		doc->file.close();
 	}
+#endif
+
+	doc->saver.start(*doc->buffer, path);
 }
 
 /**
-	Saves the buffer to a file specified by the path parameter.
+	Saves the buffer to a file specified by the path parameter, and waits for the
+	save to finish. A buffer that lost lines it could not read back is not saved, and
+	its journal is kept. Failures are also written to the standard error stream when
+	running a script, and counted.
 	@param path The path of the file to save the buffer to.
+	@returns True if the buffer was saved.
 */
-void Editor::saveDocument(string path) {
-	ofstream out;
+bool Editor::saveDocument(string path) {
 	stringstream ss;
+	bool saved = false;
+
+	beginSave(path);
+	metrics.enter(PHASE_IO);
+	doc->saver.wait();
+	metrics.leave();
+	settleSave(*doc);
+	console.setProgressMessage("");
+
+	if (!doc->buffer->isIntact()) {
+		ss << "Lines of the buffer could not be read back, so it was not saved to: \"" << path << "\"";
+	}
+	else if (path == "-" || doc->saver.lastSucceeded()) {
+		doc->journal.discard();
+		ss << "File saved to: \"" << path << "\"";
+		saved = true;
+	}
+	else {
+		ss << "Could not save to: \"" << path << "\"";
+	}
 
-	out.open(path);
+	if (!saved && console.isHeadless()) {
+		cerr << ss.str() << endl;
+		failedSaves++;
+	}
+
+	ss << ". Press ENTER to quit.";
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+	return saved;
+}
+
+/**
+	Saves every buffer that needs it to its output file, and waits for the saves to
+	finish. The selected buffer is always saved, and saved last so that its outcome
+	is the one shown; the others are saved if they were modified or are written to a
+	file other than the one they were loaded from.
+	@returns True if every buffer saved was saved successfully.
+*/
+bool Editor::saveAll() {
+	Document *selected = doc;
+	bool saved = true;
+
+	for (size_t i = 0; i < documents.size(); i++) {
+		if (documents[i] != selected && (documents[i]->modified || documents[i]->outPath != documents[i]->inPath)) {
+			doc = documents[i];
+			saved = saveDocument(doc->outPath) && saved;
+		}
+	}
+
+	doc = selected;
+	return saveDocument(doc->outPath) && saved;
+}
+
+/**
+	Accounts for the outcome of a document's last save once it has finished. The
+	journal is rebased on the input if the save replaced it, and a failed save to
+	the output file leaves the document modified.
+	@param document The document.
+	@returns True if a save had finished that was not accounted for yet.
+*/
+bool Editor::settleSave(Document& document) {
+	if (document.saveReported || document.saver.isRunning()) {
+		return false;
+	}
 
-	if (out.is_open()) {
-		out << linkedList;
+	// the input now holds the checkpointed changes
+	if (document.saver.lastSucceeded() && document.saver.getPath() == document.inPath && document.journalCheckpoint >= 0) {
+		document.journal.rebase(document.journalCheckpoint);
+	}
+	document.journalCheckpoint = -1;
 
-		out.close();
+	if (!document.saver.lastSucceeded() && document.saver.getPath() == document.outPath) {
+		document.modified = true;
 	}
 
-	ss << "File saved to: \"" << outPath << "\". Press ENTER to quit.";
+	document.saveReported = true;
+	return true;
+}
+
+/**
+	Saves the buffer to the output file on a background thread, so that editing can
+	continue while the file is written. Progress is shown in the status bar.
+*/
+void Editor::saveInBackground() {
+	stringstream ss;
+
+	beginSave(doc->outPath);
+	updateProgress();
+
+	ss << "Saving to: \"" << doc->outPath << "\"";
 	console.setStatusMessage(ss.str());
 	displayBuffer();
 }
 
+/**
+	Shows the progress of a background save or load in the status bar, or the
+	outcome of a save once it has finished.
+*/
+void Editor::updateProgress() {
+	stringstream ss;
+
+	if (doc->loader.isLoading()) {
+		ss << "loading " << doc->loader.getProgress() << "%";
+	}
+	else if (doc->saver.isRunning()) {
+		ss << "saving " << doc->saver.getProgress() << "%";
+	}
+	else if (settleSave(*doc)) {
+		if (doc->saver.lastSucceeded()) {
+			ss << "saved, " << (long long)(doc->saver.getBytesPerSecond() / (1024 * 1024)) << " MB/s";
+		}
+		else {
+			ss << "save failed";
+		}
+	}
+
+	console.setProgressMessage(ss.str());
+}
+
 /**
 	Scrolls to the position of the currently selected line.
 */
 void Editor::scrollToCurrent()
 {
-	if (currentLine > 0 && currentLine <= linkedList.size()) {
-		console.setScrollPosition(currentLine);
+	if (doc->currentLine > 0 && doc->currentLine <= doc->buffer->size()) {
+		console.setScrollPosition(doc->currentLine);
 
 		stringstream ss;
-		ss << "Scrolled to position : " << currentLine;
+		ss << "Scrolled to position : " << doc->currentLine;
 		console.setStatusMessage(ss.str());
 		displayBuffer();
 	}
@@ -197,7 +815,7 @@ void Editor::scrollToCurrent()
 */
 void Editor::scrollToPosition(int pos)
 {
-	if (pos > 0 && pos <= linkedList.size()) {
+	if (pos > 0 && pos <= doc->buffer->size()) {
 		console.setScrollPosition(pos);
 
 		stringstream ss;
@@ -212,8 +830,17 @@ void Editor::scrollToPosition(int pos)
 	@param at The location in which to insert the new line.
 */
 void Editor::insertLine(int at) {
-	if (at > 0 && at <= linkedList.size()) {
-		linkedList.insertAt(at - 1, console.promptForInput());
+	// the text is read even if the position is invalid, so that a script goes on
+	// with the next command rather than running the text as one
+	string text = console.promptForInput();
+
+	if (at > 0 && at <= doc->buffer->size()) {
+		Change change;
+		change.position = at - 1;
+		change.inserted.push_back(move(text));
+
+		doc->buffer->insertAt(at - 1, change.inserted[0]);
+		doc->record(change);
 
 		stringstream ss;
 		ss << "Line inserted at position : " << at;
@@ -228,12 +855,19 @@ void Editor::insertLine(int at) {
 */
 void Editor::insertBeforeCurrentLine()
 {
-	if (currentLine > 0 && currentLine <= linkedList.size()) {
-		linkedList.insertAt(currentLine - 1, console.promptForInput());
+	string text = console.promptForInput();
+
+	if (doc->currentLine > 0 && doc->currentLine <= doc->buffer->size()) {
+		Change change;
+		change.position = doc->currentLine - 1;
+		change.inserted.push_back(move(text));
+
+		doc->buffer->insertAt(doc->currentLine - 1, change.inserted[0]);
+		doc->record(change);
 
 		stringstream ss;
 
-		ss << "Line inserted at : " << currentLine;
+		ss << "Line inserted at : " << doc->currentLine;
 		console.setStatusMessage(ss.str());
 		displayBuffer();
 	}
@@ -243,10 +877,18 @@ void Editor::insertBeforeCurrentLine()
 	Displays the current buffer.
 */
 void Editor::displayBuffer() {
-	stringstream ss;
-	ss << linkedList;
-	console.setBufferSize(linkedList.size());
-	console.drawBuffer(ss, currentLine);
+	if (console.isHeadless()) {
+		return;
+	}
+
+	vector<LineView> lines;
+	int first = console.getScrollPosition();
+	int height = console.calcAvailableBufferRoom() + 1;
+
+	doc->loader.ensureLoaded(*doc->buffer, first - 1 + height);
+	doc->buffer->getViews(first - 1, height, lines);
+	console.setBufferSize(doc->buffer->size());
+	console.drawBuffer(lines, first, doc->currentLine);
 }
 
 /**
@@ -258,28 +900,73 @@ void Editor::displayHelpInfo()
 
 	ss << "  CMD   PARAMETERS                  DESCRIPTION                                                             |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| A   | none, <pos>               | Prompts for a file and inserts its lines after <pos>, or after the      |" << endl;
+	ss << "|     |                           | selected line. 0 inserts them before the first line.                    |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| B   | none, <num>               | Selects buffer <num>, or lists the open buffers. Each buffer keeps its  |" << endl;
+	ss << "|     |                           | own selected line, scroll position and undo history.                    |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| C   | <dst>, <pos, dst>,        | Copies the selected line, the line at <pos>, or the lines from <start>  |" << endl;
+	ss << "|     | <start, end, dst>         | to <end>, after the line at <dst>. 0 copies them to the top.            |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| D   | none, <pos>, <start, end> | Delete the line at <pos>, or a range of lines from <start> to <end>, or |" << endl;
 	ss << "|     |                           | the currently selected line.                                            |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| E   | none                      | Saves the buffer and exits the program.                                 |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| F   | none                      | Prompts for text and selects the first line containing it, starting at  |" << endl;
+	ss << "|     |                           | the selected line.                                                      |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| G   | none, <pos>               | Sets the currently selected <pos>, or selects the first line.           |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| H   | none                      | Displays this help screen.                                              |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| I   | none, <pos>               | Inserts new line at <pos>, or inserts it at the selected line.          |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| K   | none, <num>               | Closes buffer <num>, or the selected buffer. A buffer with unsaved      |" << endl;
+	ss << "|     |                           | changes is only closed by a second K.                                   |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| L   | none, <pos>, <start, end> | Display the line at <pos> or a range of line from <start> to <end> or   |" << endl;
 	ss << "|     |                           | the currently selected line.                                            |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| M   | <dst>, <pos, dst>,        | Moves the selected line, the line at <pos>, or the lines from <start>   |" << endl;
+	ss << "|     | <start, end, dst>         | to <end>, after the line at <dst>. 0 moves them to the top.             |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| N   | none                      | Selects the next line containing the text of the last F command.        |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| O   | none                      | Prompts for a file and opens it in a new buffer, or selects the buffer  |" << endl;
+	ss << "|     |                           | it is open in. The file is saved to itself.                             |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| P   | none, <pos>               | Scrolls to the line at <pos>, or to the currently selected line.        |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| Q   | none                      | Quits the program without saving the buffer.                            |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| R   | none                      | Redoes the last change that was undone.                                 |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| S   | none, <pos>               | Substitutes the line at <pos> or the current line.                      |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| s   | /<a>/<b>/, then none,     | Replaces every <a> with <b> in the line at <pos>, in a range of lines   |" << endl;
+	ss << "|     | <pos> or <start, end>     | from <start> to <end>, or in the entire buffer. \\ escapes / and \\.      |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| T   | none                      | Turns the trigram index on or off. It speeds up F and N on large files  |" << endl;
+	ss << "|     |                           | at the cost of memory; its size is shown when it is built.              |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| U   | none                      | Undoes the last change made to the buffer.                              |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 	ss << "| V   | none                      | Displays the entire buffer.                                             |" << endl;
 	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| W   | none                      | Saves the buffer in the background and keeps editing; progress is shown |" << endl;
+	ss << "|     |                           | in the status bar.                                                      |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| X   | <num>, <pos, num>,        | Moves the selected line, the line at <pos>, or the lines from <start>   |" << endl;
+	ss << "|     | <start, end, num>         | to <end>, to buffer <num>, after the line selected in it.               |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| Y   | <num>, <pos, num>,        | Copies the selected line, the line at <pos>, or the lines from <start>  |" << endl;
+	ss << "|     | <start, end, num>         | to <end>, to buffer <num>, after the line selected in it.               |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
+	ss << "| Z   | none                      | Shows the time spent parsing, executing, drawing and waiting on I/O, the|" << endl;
+	ss << "|     |                           | latency and allocations of each command, and a latency histogram.       |" << endl;
+	ss << "-------------------------------------------------------------------------------------------------------------" << endl;
 
 	console.drawBuffer(ss, 0);
 }
@@ -290,16 +977,18 @@ void Editor::displayHelpInfo()
 	@param b The second integer on the range.
 */
 void Editor::list(int a, int b) {
-	int height = max(a, b) - min(a, b);
+	int first = max(min(a, b), 1);
+	int height = min(max(a, b) - first + 1, console.calcAvailableBufferRoom() + 1);
+	vector<LineView> lines;
 
-	stringstream ss;
-	ss << linkedList;
+	doc->buffer->getViews(first - 1, height, lines);
 
 	stringstream msg;
 	msg << "Viewing lines : " << min(a,b) << " through " << max(a,b);
 
 	console.setStatusMessage(msg.str());
-	console.drawBuffer(ss, currentLine, a, b);
+	console.setBufferSize(doc->buffer->size());
+	console.drawBuffer(lines, first, doc->currentLine);
 }
 
 /**
@@ -307,13 +996,13 @@ void Editor::list(int a, int b) {
 	@param line The position of the line to list.
 */
 void Editor::list(int line) {
-	if (line > 0 && line <= linkedList.size()) {
-		string value = linkedList.get(line - 1);
+	if (line > 0 && line <= doc->buffer->size()) {
+		LineView value = doc->buffer->getView(line - 1);
 
 		stringstream msg;
 		msg << "Viewing line : " << line;
 		console.setStatusMessage(msg.str());
-		console.drawBuffer(value, line, (line == currentLine));
+		console.drawBuffer(value, line, (line == doc->currentLine));
 	}
 }
 
@@ -321,13 +1010,13 @@ void Editor::list(int line) {
 	Lists the currently selected line on the buffer.
 */
 void Editor::list() {
-	if (currentLine > 0 && currentLine <= linkedList.size()) {
-		string value = linkedList.get(currentLine - 1);
+	if (doc->currentLine > 0 && doc->currentLine <= doc->buffer->size()) {
+		LineView value = doc->buffer->getView(doc->currentLine - 1);
 
 		stringstream msg;
-		msg << "Viewing selected line : " << currentLine;
+		msg << "Viewing selected line : " << doc->currentLine;
 		console.setStatusMessage(msg.str());
-		console.drawBuffer(value, currentLine, true);
+		console.drawBuffer(value, doc->currentLine, true);
 	}
 }
 
@@ -339,7 +1028,18 @@ void Editor::list() {
 void Editor::deleteRange(int from, int to) {
 	int start = min(from, to);
 	int numItems = max(from, to) - min(from, to);
-	linkedList.deleteRange(start - 1, numItems + 1);
+	Change change;
+
+	if (start > 0) {
+		change.position = start - 1;
+		doc->buffer->getRange(start - 1, numItems + 1, change.removed);
+	}
+
+	doc->buffer->deleteRange(start - 1, numItems + 1);
+
+	if (!change.removed.empty()) {
+		doc->record(change);
+	}
 
 	stringstream ss;
 	ss << "Deleted lines " << min(from, to) << " through " << max(from, to);
@@ -358,13 +1058,23 @@ void Editor::deleteLine(int line) {
 	console.setStatusMessage(ss.str());
 	displayBuffer();
 	if (line == -1) {
-		if (currentLine > 0 && currentLine <= linkedList.size()) {
-			linkedList.deleteNode(currentLine - 1);
-			ss << "Deleted line at position : " << currentLine;
+		if (doc->currentLine > 0 && doc->currentLine <= doc->buffer->size()) {
+			Change change;
+			change.position = doc->currentLine - 1;
+			change.removed.push_back(doc->buffer->get(doc->currentLine - 1));
+
+			doc->buffer->deleteNode(doc->currentLine - 1);
+			doc->record(change);
+			ss << "Deleted line at position : " << doc->currentLine;
 		}
 	}
-	else if (line > 0 && line <= linkedList.size()) {
-		linkedList.deleteNode(line - 1);
+	else if (line > 0 && line <= doc->buffer->size()) {
+		Change change;
+		change.position = line - 1;
+		change.removed.push_back(doc->buffer->get(line - 1));
+
+		doc->buffer->deleteNode(line - 1);
+		doc->record(change);
 		ss << "Deleted line at position : " << line;
 	}
 
@@ -372,16 +1082,232 @@ void Editor::deleteLine(int line) {
 	displayBuffer();
 }
 
+/**
+	Moves a range of lines after another line. The lines are spliced out of the
+	buffer and back in without copying their text.
+	@param from The start position of the range to be moved.
+	@param to The end position of the range to be moved.
+	@param after The line to put the range after, or 0 to put it at the top. It
+	may not be inside the range.
+*/
+void Editor::moveLines(int from, int to, int after) {
+	int start = min(from, to);
+	int end = max(from, to);
+	stringstream ss;
+
+	if (start < 1 || end > doc->buffer->size() || after < 0 || after > doc->buffer->size()) {
+		console.setStatusMessage("Invalid range");
+		displayBuffer();
+		return;
+	}
+
+	if (after >= start - 1 && after <= end) {
+		if (after > start - 1 && after < end) {
+			ss << "Cannot move lines " << start << " through " << end << " after one of them";
+		}
+		else {
+			ss << "Lines " << start << " through " << end << " are already after line " << start - 1;
+		}
+		console.setStatusMessage(ss.str());
+		displayBuffer();
+		return;
+	}
+
+	int numItems = end - start + 1;
+	int target = after > end ? after - numItems : after;
+	vector<Change> changes(2);
+
+	// undone in reverse: the block is taken out of its new place, then put back
+	changes[0].position = start - 1;
+	doc->buffer->getRange(start - 1, numItems, changes[0].removed);
+	changes[1].position = target;
+	changes[1].inserted = changes[0].removed;
+
+	doc->buffer->splice(target, *doc->buffer, start - 1, numItems);
+
+	for (size_t i = 0; i < changes.size(); i++) {
+		doc->track(changes[i]);
+	}
+	doc->history.record(move(changes), doc->currentLine);
+	doc->currentLine = target + 1;
+
+	ss << "Moved lines " << start << " through " << end << " after line " << after;
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Copies a range of lines after another line.
+	@param from The start position of the range to be copied.
+	@param to The end position of the range to be copied.
+	@param after The line to put the copy after, or 0 to put it at the top.
+*/
+void Editor::copyLines(int from, int to, int after) {
+	int start = min(from, to);
+	int end = max(from, to);
+	stringstream ss;
+
+	if (start < 1 || end > doc->buffer->size() || after < 0 || after > doc->buffer->size()) {
+		console.setStatusMessage("Invalid range");
+		displayBuffer();
+		return;
+	}
+
+	int numItems = end - start + 1;
+	LineStore *block = doc->buffer->copy(start - 1, numItems);
+	Change change;
+
+	change.position = after;
+	block->getRange(0, numItems, change.inserted);
+	doc->buffer->paste(after, *block);
+	delete block;
+
+	doc->record(change);
+	doc->currentLine = after + 1;
+
+	ss << "Copied lines " << start << " through " << end << " after line " << after;
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Prompts for the path of a file and inserts its lines after a line.
+	@param after The line to put the file's lines after, or 0 to put them at the top.
+*/
+void Editor::pasteFile(int after) {
+	stringstream ss;
+	string path = console.promptForInput();
+
+	if (after < 0 || after > doc->buffer->size()) {
+		console.setStatusMessage("Invalid position");
+		displayBuffer();
+		return;
+	}
+
+	ifstream file(path);
+
+	if (!file) {
+		ss << "Could not open " << path;
+		console.setStatusMessage(ss.str());
+		displayBuffer();
+		return;
+	}
+
+	Change change;
+	string line;
+
+	change.position = after;
+	while (getline(file, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.erase(line.size() - 1);
+		}
+		change.inserted.push_back(move(line));
+	}
+
+	if (!change.inserted.empty()) {
+		vector<LineView> lines(change.inserted.begin(), change.inserted.end());
+
+		doc->buffer->insertRange(after, lines);
+		doc->record(change);
+	}
+
+	ss << "Inserted " << change.inserted.size() << " lines from " << path << " after line " << after;
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Copies or moves a range of lines to another buffer, after the line selected in
+	it. The buffers share their storage, so the copied or moved lines are linked
+	into the other buffer without copying their text again.
+	@param from The start position of the range.
+	@param to The end position of the range.
+	@param number The number of the buffer to put the lines in.
+	@param moving Whether the lines are taken out of this buffer.
+*/
+void Editor::transferLines(int from, int to, int number, bool moving) {
+	int start = min(from, to);
+	int end = max(from, to);
+	stringstream ss;
+
+	if (number < 1 || number > (int)documents.size()) {
+		ss << "No buffer " << number;
+		console.setStatusMessage(ss.str());
+		displayBuffer();
+		return;
+	}
+
+	Document *target = documents[number - 1];
+
+	if (target == doc) {
+		if (moving) {
+			moveLines(from, to, doc->currentLine);
+		}
+		else {
+			copyLines(from, to, doc->currentLine);
+		}
+		return;
+	}
+
+	if (start < 1 || end > doc->buffer->size()) {
+		console.setStatusMessage("Invalid range");
+		displayBuffer();
+		return;
+	}
+
+	int numItems = end - start + 1;
+	LineStore *block;
+	Change removal;
+	Change insertion;
+
+	target->loader.ensureLoaded(*target->buffer, target->currentLine);
+	insertion.position = max(min(target->currentLine, target->buffer->size()), 0);
+
+	if (moving) {
+		removal.position = start - 1;
+		doc->buffer->getRange(start - 1, numItems, removal.removed);
+		block = doc->buffer->cut(start - 1, numItems);
+
+		// the lines may point into this document's file, which can be closed first
+		block->releaseViews();
+	}
+	else {
+		block = doc->buffer->copy(start - 1, numItems);
+	}
+
+	block->getRange(0, numItems, insertion.inserted);
+	target->buffer->paste(insertion.position, *block);
+	delete block;
+
+	if (moving) {
+		doc->record(removal);
+		doc->currentLine = max(min(doc->currentLine, doc->buffer->size()), 1);
+	}
+	target->record(insertion);
+
+	ss << (moving ? "Moved" : "Copied") << " lines " << start << " through " << end << " to buffer " << number
+		<< " after line " << insertion.position;
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
 /**
 	Substitutes the value of the currently selected line in the buffer.
 */
 void Editor::substituteCurrentLine()
 {
 	stringstream ss;
+	string text = console.promptForInput();
 
-	if (currentLine > 0 && currentLine <= linkedList.size()) {
-		linkedList.updateValue(currentLine - 1, console.promptForInput());
-		ss << "Line " << currentLine << " updated";
+	if (doc->currentLine > 0 && doc->currentLine <= doc->buffer->size()) {
+		Change change;
+		change.position = doc->currentLine - 1;
+		change.removed.push_back(doc->buffer->get(doc->currentLine - 1));
+		change.inserted.push_back(move(text));
+
+		doc->buffer->updateValue(doc->currentLine - 1, change.inserted[0]);
+		doc->record(change);
+		ss << "Line " << doc->currentLine << " updated";
 	}
 
 	console.setStatusMessage(ss.str());
@@ -394,9 +1320,16 @@ void Editor::substituteCurrentLine()
 */
 void Editor::substituteLine(int line) {
 	stringstream ss;
+	string text = console.promptForInput();
+
+	if (line > 0 && line <= doc->buffer->size()) {
+		Change change;
+		change.position = line - 1;
+		change.removed.push_back(doc->buffer->get(line - 1));
+		change.inserted.push_back(move(text));
 
-	if (line > 0 && line <= linkedList.size()) {
-		linkedList.updateValue(line - 1, console.promptForInput());
+		doc->buffer->updateValue(line - 1, change.inserted[0]);
+		doc->record(change);
 		ss << "Line " << line << " updated";
 	}
 
@@ -409,13 +1342,13 @@ void Editor::substituteLine(int line) {
 	@param line The position of the line to be selected.
 */
 void Editor::goToLine(int line) {
-	int maxSize = linkedList.size();
+	int maxSize = doc->buffer->size();
 
 	if (line > maxSize) {
-		currentLine = maxSize;
+		doc->currentLine = maxSize;
 	}
 	else {
-		currentLine = line;
+		doc->currentLine = line;
 	}
 
 	stringstream ss;
@@ -425,6 +1358,359 @@ void Editor::goToLine(int line) {
 	displayBuffer();
 }
 
+/**
+	Prompts for the text to look for and selects the first line containing it,
+	starting with the selected line.
+*/
+void Editor::find() {
+	string pattern = console.promptForInput();
+
+	if (pattern.empty()) {
+		console.setStatusMessage("Nothing to find");
+		displayBuffer();
+		return;
+	}
+
+	search = TextSearch(pattern);
+	findFrom(doc->currentLine);
+}
+
+/**
+	Selects the next line containing the text of the last search.
+*/
+void Editor::findNext() {
+	if (search.getPattern().empty()) {
+		console.setStatusMessage("Nothing to find");
+		displayBuffer();
+		return;
+	}
+
+	findFrom(doc->currentLine + 1);
+}
+
+/**
+	Selects the first line containing the text of the current search, starting at a
+	line and wrapping around to the top of the buffer, and scrolls to it.
+	@param line The position of the line to start at.
+*/
+void Editor::findFrom(int line) {
+	stringstream ss;
+	int total;
+	int column = 0;
+	int found;
+	bool wrapped = false;
+
+	auto start = chrono::steady_clock::now();
+	total = doc->buffer->size();
+	line = max(min(line, total + 1), 1);
+	found = findInRange(line - 1, total, column);
+
+	if (found < 0) {
+		found = findInRange(0, line - 1, column);
+		wrapped = true;
+	}
+
+	if (found >= 0) {
+		doc->currentLine = found + 1;
+		console.setScrollPosition(doc->currentLine);
+		ss << "Found \"" << search.getPattern() << "\" at line " << doc->currentLine << ", column " << column + 1;
+
+		if (wrapped) {
+			ss << " (search wrapped)";
+		}
+	}
+	else {
+		ss << "Not found : \"" << search.getPattern() << "\"";
+	}
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	ss << " in " << elapsed.count() << " ms";
+
+	if (doc->index.isEnabled()) {
+		ss << " (indexed)";
+	}
+
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Looks for the text of the current search in a range of lines. When the trigram
+	index is on, only the lines it can't rule out are visited.
+	@param start The position of the first line to search.
+	@param end The position just past the last line to search.
+	@param column Receives the offset of the match within its line.
+	@returns The position of the first line containing the text, or -1.
+*/
+int Editor::findInRange(int start, int end, int& column) {
+	vector<pair<int, int>> ranges;
+
+	if (!doc->index.isEnabled()) {
+		return scanRange(start, end, column);
+	}
+
+	doc->index.getCandidates(search.getPattern(), start, end, ranges);
+
+	for (size_t i = 0; i < ranges.size(); i++) {
+		int found = scanRange(ranges[i].first, ranges[i].second, column);
+
+		if (found >= 0) {
+			return found;
+		}
+	}
+
+	return -1;
+}
+
+/**
+	Looks for the text of the current search in every line of a range. The lines
+	are visited in place, a window at a time, without copying them; the views of a
+	window are expired before the next one is read, so that paged buffers don't keep
+	every line read.
+	@param start The position of the first line to search.
+	@param end The position just past the last line to search.
+	@param column Receives the offset of the match within its line.
+	@returns The position of the first line containing the text, or -1.
+*/
+int Editor::scanRange(int start, int end, int& column) {
+	vector<LineSpan> spans;
+
+	for (int first = start; first < end; first += SEARCH_WINDOW) {
+		doc->buffer->getSpans(first, min(SEARCH_WINDOW, end - first), spans);
+
+		for (size_t i = 0; i < spans.size(); i++) {
+			const char *match = search.find(spans[i].text, spans[i].length);
+
+			if (match != NULL) {
+				column = (int)(match - spans[i].text);
+				return first + (int)i;
+			}
+		}
+
+		doc->buffer->expireViews();
+	}
+
+	return -1;
+}
+
+/**
+	Replaces every occurrence of a text in a range of lines. The range is split into
+	chunks that are searched and rewritten in parallel, a round at a time, without
+	modifying the buffer; views are expired between rounds, so that paged buffers
+	don't keep every line read. The rewritten lines are then applied in order, as a
+	single change to undo.
+	@param pattern The text to replace.
+	@param replacement The text to put in its place.
+	@param cmd The command, holding the line or range of lines; the whole buffer if
+	it has no parameters.
+*/
+void Editor::replace(const string& pattern, const string& replacement, const Command& cmd) {
+	stringstream ss;
+	int start = 0;
+	int end;
+
+	end = doc->buffer->size();
+
+	if (cmd.numArgs == 1) {
+		start = cmd.args[0] - 1;
+		end = cmd.args[0];
+	}
+	else if (cmd.numArgs == 2) {
+		start = min(cmd.args[0], cmd.args[1]) - 1;
+		end = max(cmd.args[0], cmd.args[1]);
+	}
+
+	start = max(start, 0);
+	end = min(end, doc->buffer->size());
+
+	if (pattern.empty() || start >= end) {
+		console.setStatusMessage(pattern.empty() ? "Nothing to replace" : "Invalid range");
+		displayBuffer();
+		return;
+	}
+
+	auto begin = chrono::steady_clock::now();
+	TextSearch search(pattern);
+	int roundSize = pool.size() * REPLACE_CHUNKS_PER_THREAD;
+	int chunkSize = min(max((end - start + roundSize - 1) / roundSize, MIN_REPLACE_CHUNK), SEARCH_WINDOW);
+	int numChunks = (end - start + chunkSize - 1) / chunkSize;
+	vector<vector<LineEdit>> edits(numChunks);
+	vector<int> matches(numChunks, 0);
+
+	// the buffer is only read until every chunk is done
+	for (int round = 0; round < numChunks; round += roundSize) {
+		pool.run(min(roundSize, numChunks - round), [&](int task) {
+			int chunk = round + task;
+			int first = start + chunk * chunkSize;
+			int last = min(first + chunkSize, end);
+			vector<LineSpan> spans;
+			string result;
+
+			doc->buffer->getSpans(first, last - first, spans);
+
+			for (size_t i = 0; i < spans.size(); i++) {
+				int numMatches = replaceInLine(search, replacement, spans[i], result);
+
+				if (numMatches > 0) {
+					LineEdit edit;
+					edit.position = first + (int)i;
+					edit.before.assign(spans[i].text, spans[i].length);
+					edit.after = move(result);
+					edits[chunk].push_back(move(edit));
+					matches[chunk] += numMatches;
+				}
+			}
+		});
+
+		// the edits hold copies, and no thread holds a view until the next round
+		doc->buffer->expireViews();
+	}
+
+	vector<Change> changes;
+	int numMatches = 0;
+	int numLines = 0;
+
+	for (int chunk = 0; chunk < numChunks; chunk++) {
+		for (size_t i = 0; i < edits[chunk].size(); i++) {
+			LineEdit& edit = edits[chunk][i];
+
+			// consecutive lines make up a single change
+			if (changes.empty() || changes.back().position + (int)changes.back().inserted.size() != edit.position) {
+				changes.push_back(Change());
+				changes.back().position = edit.position;
+			}
+
+			doc->buffer->updateValue(edit.position, edit.after);
+			changes.back().removed.push_back(move(edit.before));
+			changes.back().inserted.push_back(move(edit.after));
+		}
+
+		numMatches += matches[chunk];
+		numLines += (int)edits[chunk].size();
+	}
+
+	for (size_t i = 0; i < changes.size(); i++) {
+		doc->track(changes[i]);
+	}
+	doc->history.record(move(changes), doc->currentLine);
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - begin;
+
+	ss << "Replaced " << numMatches << " matches on " << numLines << " lines in "
+		<< (long long)elapsed.count() << " ms (" << pool.size() << " threads)";
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Builds the trigram index used by searches, or discards it if it is on. Reports
+	the size of the index and the time it took to build.
+*/
+void Editor::toggleIndex() {
+	stringstream ss;
+
+	if (doc->index.isEnabled()) {
+		doc->index.clear();
+		ss << "Trigram index off";
+	}
+	else {
+		auto start = chrono::steady_clock::now();
+		doc->index.build(*doc->buffer, pool);
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+		ss << "Trigram index on : " << doc->index.getBlockCount() << " blocks, "
+			<< doc->index.memoryUsage() / 1024 << " KB, built in " << (long long)elapsed.count() << " ms";
+	}
+
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Reverts the most recent change to the buffer and selects the line that was
+	selected before it.
+*/
+void Editor::undo() {
+	stringstream ss;
+	vector<Change> applied;
+	int line = doc->history.undo(*doc->buffer, doc->currentLine, &applied);
+
+	for (size_t i = 0; i < applied.size(); i++) {
+		doc->track(applied[i]);
+	}
+
+	if (line > 0) {
+		doc->currentLine = max(min(doc->currentLine, doc->buffer->size()), 1);
+		ss << "Undid change at line " << line;
+	}
+	else {
+		ss << "Nothing to undo";
+	}
+
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Reapplies the most recently undone change and selects its first line.
+*/
+void Editor::redo() {
+	stringstream ss;
+	vector<Change> applied;
+	int line = doc->history.redo(*doc->buffer, &applied);
+
+	for (size_t i = 0; i < applied.size(); i++) {
+		doc->track(applied[i]);
+	}
+
+	if (line > 0) {
+		doc->currentLine = max(min(line, doc->buffer->size()), 1);
+		ss << "Redid change at line " << line;
+	}
+	else {
+		ss << "Nothing to redo";
+	}
+
+	console.setStatusMessage(ss.str());
+	displayBuffer();
+}
+
+/**
+	Sets whether scripts may open files whose journal holds changes of a session that
+	did not end normally, replaying them first as interactive sessions do.
+	@param allowed True to recover the changes, false to refuse to open such files.
+*/
+void Editor::setBatchRecovery(bool allowed) {
+	batchRecovery = allowed;
+}
+
+/**
+	Sets the file the command statistics are written to when the editor closes.
+	@param path The path of the file, or an empty string to not write them.
+*/
+void Editor::setStatsPath(string path) {
+	statsPath = path;
+}
+
+/**
+	Shows how long each phase of the commands run so far took, how much memory they
+	allocated, and a histogram of their latency. Scripts write the statistics to the
+	standard error stream instead.
+*/
+void Editor::showStats() {
+	stringstream ss;
+
+	metrics.report(ss);
+
+	if (console.isHeadless()) {
+		cerr << ss.str();
+		return;
+	}
+
+	console.setStatusMessage("Command statistics");
+	console.drawBuffer(ss, 0);
+}
+
 /**
 	Exits the program.
 */
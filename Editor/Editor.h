@@ -1,55 +1,100 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
-#include "StringLinkedList.h"
+#include "CommandParser.h"
 #include "ConsoleUI.h"
+#include "Document.h"
+#include "LineStore.h"
+#include "Metrics.h"
+#include "TextSearch.h"
+#include "ThreadPool.h"
+#include <istream>
 #include <string>
 #include <thread>
+#include <vector>
 
 using namespace std;
 
-const string DELETE_REGEX = "^[Dd]\\s?([0-9]*)\\s?([0-9]*)$";
-const string GOTO_REGEX = "^[Gg]\\s?([0-9]*)$";
-const string HELP_REGEX = "^[Hh]$";
-const string INSERT_REGEX = "^[Ii]\\s?([0-9]*)$";
-const string LIST_REGEX = "^[Ll]\\s?([0-9]*)\\s?([0-9]*)$";
-const string POSITION_REGEX = "^[Pp]\\s?([0-9]*)$";
-const string QUIT_REGEX = "^[Qq]$";
-const string SAVE_EXIT_REGEX = "^[Ee]$";
-const string SUB_REGEX = "^[Ss]\\s?([0-9]*)$";
-const string VIEW_REGEX = "^[Vv]$";
+enum LoadMode { STREAM_LOAD, MAPPED_LOAD };
 
 class Editor
 {
 private:
 	ConsoleUI console;
-	StringLinkedList linkedList;
-	int currentLine = 1;
-	string inPath;
-	string outPath;
+	// Every document's buffer is a sibling of the first one, so lines can be moved
+	// between them without copying their text.
+	vector<Document*> documents;
+	Document *doc = NULL;
+	LoadMode loadMode;
+	TextSearch search;
+	ThreadPool pool;
+	Metrics metrics;
+	// The document K was last asked to close despite its unsaved changes.
+	Document *closeRequest = NULL;
+	string statsPath;
+	// Whether scripts may open files whose journal holds changes of a session that
+	// did not end normally.
+	bool batchRecovery = false;
+	// The number of saves that failed while running a script.
+	int failedSaves = 0;
+
+	void activate(Document *document);
+	void addDocument(LineStore *buffer, string inPath, string outPath);
+	void beginSave(string path);
+	void mapDocument(string path);
+	void ensureLoaded(const Command& cmd);
+	int findInRange(int start, int end, int& column);
+	void findFrom(int line);
+	bool settleSave(Document& document);
+	int scanRange(int start, int end, int& column);
+	void toggleIndex();
+	void updateProgress();
 
 public:
 	bool shouldExit = false;
-	Editor(string inPath, string outPath);
+	Editor(string inPath, string outPath, StoreType storeType = ROPE_STORE, LoadMode loadMode = MAPPED_LOAD,
+		size_t memoryLimit = 0);
+	Editor(const Editor&) = delete;
+	Editor& operator=(const Editor&) = delete;
+	virtual ~Editor();
 
+	void closeDocument(int number);
+	void copyLines(int from, int to, int after);
 	void deleteLine(int line = -1);
 	void deleteRange(int from, int to);
 	void displayBuffer();
 	void displayHelpInfo();
 	void exit();
+	void find();
+	void findNext();
 	void goToLine(int line = 1);
 	void insertBeforeCurrentLine();
 	void insertLine(int);
 	void list();
 	void list(int from, int to);
 	void list(int line);
-	void openDocument(string path);
-	void parseCommand(string command);
-	void saveDocument(string path);
+	void listDocuments();
+	void moveLines(int from, int to, int after);
+	void pasteFile(int after);
+	void redo();
+	void replace(const string& pattern, const string& replacement, const Command& cmd);
+	void undo();
+	void openDocument(string path, LoadMode loadMode = STREAM_LOAD);
+	void openFile();
+	bool parseCommand(const string& command);
+	int runScript(istream& script);
+	bool saveAll();
+	bool saveDocument(string path);
+	void saveInBackground();
 	void scrollToCurrent();
 	void scrollToPosition(int pos);
+	void selectDocument(int number);
+	void setBatchRecovery(bool allowed);
+	void setStatsPath(string path);
+	void showStats();
 	void substituteCurrentLine();
 	void substituteLine(int line = 0);
+	void transferLines(int from, int to, int number, bool moving);
 };
 
 #endif
@@ -0,0 +1,460 @@
+#include "Journal.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+	The journal lives next to the input file, as <input>.journal. It starts with a
+	header identifying the input it applies to, followed by one record per change:
+
+		position, number of lines removed, number of lines inserted,
+		then the length and text of each inserted line,
+		then a checksum of the record.
+
+	The header holds the input's size and modification time (64 bit each) and a hash
+	of its first and last bytes; every other number is 32 bit. Numbers are in the
+	machine's byte order. A record that is cut short or fails its checksum ends the
+	replay: it was being written when the process died.
+*/
+const char JOURNAL_MAGIC[] = "EDJOURNAL2";
+const size_t JOURNAL_MAGIC_LENGTH = sizeof(JOURNAL_MAGIC) - 1;
+
+// Only this much of the start and of the end of the input is hashed, so that
+// checking a journal is cheap; the modification time stands for the rest.
+const long long FINGERPRINT_BYTES = 64 * 1024;
+
+/**
+	Default constructor. Every change is committed as soon as it is appended, until
+	setGroupCommit says otherwise.
+*/
+Journal::Journal() : file(NULL), pendingChanges(0), groupSize(1), groupWindow(0), inputSize(0), inputTime(0), inputHash(0) {}
+
+/**
+	Virtual destructor. Commits whatever is pending.
+*/
+Journal::~Journal() {
+	sync();
+
+	if (file != NULL) {
+		fclose(file);
+	}
+}
+
+/**
+	FNV-1a hash.
+	@param data The bytes to hash.
+	@param length The number of bytes.
+	@param seed The hash of the bytes that came before, if any.
+	@returns The hash.
+*/
+unsigned int Journal::hash(const char *data, size_t length, unsigned int seed) {
+	unsigned int value = seed;
+
+	for (size_t i = 0; i < length; i++) {
+		value ^= (unsigned char)data[i];
+		value *= 16777619u;
+	}
+
+	return value;
+}
+
+/**
+	Reads a 32 bit number from the journal.
+	@param in The journal file.
+	@param value Receives the number.
+	@returns False if the file ended first.
+*/
+bool Journal::readInt(FILE *in, unsigned int& value) {
+	return fread(&value, sizeof(value), 1, in) == 1;
+}
+
+/**
+	Appends a 32 bit number to the pending records.
+	@param value The number.
+*/
+void Journal::appendInt(unsigned int value) {
+	pending.append((const char*)&value, sizeof(value));
+}
+
+/**
+	Gets the time a file was last modified.
+	@param path The path of the file.
+	@returns The time, in seconds since the epoch, or 0 if the file can't be found.
+*/
+static long long modificationTime(string path) {
+#ifdef _WIN32
+	struct _stat64 info;
+
+	return _stat64(path.c_str(), &info) == 0 ? (long long)info.st_mtime : 0;
+#else
+	struct stat info;
+
+	return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : 0;
+#endif
+}
+
+/**
+	Identifies the input file by its size, its modification time and the hash of its
+	first and last bytes, so that a journal is never replayed onto a different file,
+	nor onto the same file changed by another program since.
+	@param inputPath The path of the input file.
+	@returns True if the input could be read.
+*/
+bool Journal::fingerprint(string inputPath) {
+	ifstream in(inputPath, ios::in | ios::binary);
+	vector<char> block((size_t)FINGERPRINT_BYTES);
+
+	inputSize = 0;
+	inputTime = 0;
+	inputHash = hash(NULL, 0);
+
+	if (!in.is_open()) {
+		return false;
+	}
+
+	in.read(block.data(), block.size());
+	inputHash = hash(block.data(), (size_t)in.gcount());
+
+	in.clear();
+	in.seekg(0, ios::end);
+	inputSize = (long long)in.tellg();
+
+	if (inputSize > FINGERPRINT_BYTES) {
+		in.seekg(max(inputSize - FINGERPRINT_BYTES, FINGERPRINT_BYTES));
+		in.read(block.data(), block.size());
+		inputHash = hash(block.data(), (size_t)in.gcount(), inputHash);
+	}
+
+	inputTime = modificationTime(inputPath);
+
+	return true;
+}
+
+/**
+	Reads the header of a journal and checks that it belongs to the input file, as
+	last fingerprinted.
+	@param in The journal file, at its start; left after the header.
+	@returns True if the journal applies to the input.
+*/
+bool Journal::checkHeader(FILE *in) {
+	char magic[JOURNAL_MAGIC_LENGTH];
+	long long size = 0;
+	long long time = 0;
+	unsigned int headHash = 0;
+
+	return fread(magic, 1, JOURNAL_MAGIC_LENGTH, in) == JOURNAL_MAGIC_LENGTH
+		&& memcmp(magic, JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH) == 0
+		&& fread(&size, sizeof(size), 1, in) == 1 && fread(&time, sizeof(time), 1, in) == 1
+		&& readInt(in, headHash) && size == inputSize && time == inputTime && headHash == inputHash;
+}
+
+/**
+	Opens the journal for appending records.
+	@param writeHeader True to start a new journal, false to continue an existing one.
+	@returns True if the journal is open.
+*/
+bool Journal::openForAppend(bool writeHeader) {
+	file = fopen(path.c_str(), writeHeader ? "wb" : "ab");
+
+	if (file != NULL && writeHeader) {
+		fwrite(JOURNAL_MAGIC, 1, JOURNAL_MAGIC_LENGTH, file);
+		fwrite(&inputSize, sizeof(inputSize), 1, file);
+		fwrite(&inputTime, sizeof(inputTime), 1, file);
+		fwrite(&inputHash, sizeof(inputHash), 1, file);
+		fflush(file);
+	}
+
+	return file != NULL;
+}
+
+/**
+	Checks if a session editing a file left a journal behind.
+	@param inputPath The path of the input file.
+	@returns True if the file has a journal, whether or not it still applies.
+*/
+bool Journal::exists(string inputPath) {
+	FILE *in = fopen((inputPath + ".journal").c_str(), "rb");
+
+	if (in == NULL) {
+		return false;
+	}
+
+	fclose(in);
+	return true;
+}
+
+/**
+	Checks if a session editing a file left changes behind that recover would replay.
+	@param inputPath The path of the input file.
+	@returns True if the file has a journal that applies to it and holds changes.
+*/
+bool Journal::hasChanges(string inputPath) {
+	Journal journal;
+	FILE *in = fopen((inputPath + ".journal").c_str(), "rb");
+	bool changes = false;
+
+	if (in == NULL) {
+		return false;
+	}
+
+	journal.fingerprint(inputPath);
+	changes = journal.checkHeader(in) && fgetc(in) != EOF;
+	fclose(in);
+
+	return changes;
+}
+
+/**
+	Looks for a journal left behind by a session that did not end normally and, if it
+	belongs to the input file, replays its changes onto the store. New changes are
+	appended to the same journal.
+	@param inputPath The path of the input file the store was loaded from.
+	@param store The freshly loaded store.
+	@returns The number of changes replayed.
+*/
+int Journal::recover(string inputPath, LineStore& store) {
+	this->inputPath = inputPath;
+	path = inputPath + ".journal";
+	fingerprint(inputPath);
+
+	FILE *in = fopen(path.c_str(), "rb");
+	int numChanges = 0;
+	long validLength = 0;
+
+	if (in == NULL) {
+		return 0;
+	}
+
+	if (!checkHeader(in)) {
+		// not a journal for this file: start over
+		fclose(in);
+		return 0;
+	}
+
+	validLength = ftell(in);
+
+	while (true) {
+		unsigned int position;
+		unsigned int numRemoved;
+		unsigned int numInserted;
+		unsigned int checksum;
+		vector<string> lines;
+		bool ok = readInt(in, position) && readInt(in, numRemoved) && readInt(in, numInserted);
+		unsigned int expected = 0;
+
+		if (ok) {
+			expected = hash((const char*)&position, sizeof(position));
+			expected = hash((const char*)&numRemoved, sizeof(numRemoved), expected);
+			expected = hash((const char*)&numInserted, sizeof(numInserted), expected);
+		}
+
+		for (unsigned int i = 0; ok && i < numInserted; i++) {
+			unsigned int length;
+			ok = readInt(in, length);
+
+			if (ok) {
+				string line(length, '\0');
+				ok = length == 0 || fread(&line[0], 1, length, in) == length;
+				expected = hash((const char*)&length, sizeof(length), expected);
+				expected = hash(line.data(), line.size(), expected);
+				lines.push_back(line);
+			}
+		}
+
+		if (!ok || !readInt(in, checksum) || checksum != expected) {
+			break;
+		}
+
+		store.replaceRange((int)position, (int)numRemoved, lines);
+		numChanges++;
+		validLength = ftell(in);
+	}
+
+	fclose(in);
+
+	// drop a torn record at the end, then keep appending to the journal
+	if (openForAppend(false)) {
+#ifdef _WIN32
+		_chsize_s(_fileno(file), validLength);
+#else
+		if (ftruncate(fileno(file), validLength) != 0) {
+			validLength = 0;
+		}
+#endif
+		fseek(file, 0, SEEK_END);
+	}
+
+	return numChanges;
+}
+
+/**
+	Sets how changes are grouped before they are written. Changes are committed once
+	numChanges of them are pending, or once the oldest pending change is older than
+	the specified number of milliseconds, whichever comes first.
+	@param numChanges The number of changes per group.
+	@param milliseconds The longest a change may wait to be committed.
+*/
+void Journal::setGroupCommit(int numChanges, int milliseconds) {
+	groupSize = numChanges;
+	groupWindow = milliseconds;
+}
+
+/**
+	Records a change that was applied to the buffer. The change is committed
+	according to the group commit settings.
+	@param change The change.
+*/
+void Journal::append(const Change& change) {
+	unsigned int position = (unsigned int)change.position;
+	unsigned int numRemoved = (unsigned int)change.removed.size();
+	unsigned int numInserted = (unsigned int)change.inserted.size();
+	unsigned int checksum = hash((const char*)&position, sizeof(position));
+
+	checksum = hash((const char*)&numRemoved, sizeof(numRemoved), checksum);
+	checksum = hash((const char*)&numInserted, sizeof(numInserted), checksum);
+
+	if (pendingChanges == 0) {
+		firstPending = chrono::steady_clock::now();
+	}
+
+	appendInt(position);
+	appendInt(numRemoved);
+	appendInt(numInserted);
+
+	for (size_t i = 0; i < change.inserted.size(); i++) {
+		unsigned int length = (unsigned int)change.inserted[i].size();
+
+		appendInt(length);
+		pending.append(change.inserted[i]);
+		checksum = hash((const char*)&length, sizeof(length), checksum);
+		checksum = hash(change.inserted[i].data(), length, checksum);
+	}
+
+	appendInt(checksum);
+	pendingChanges++;
+
+	commit();
+}
+
+/**
+	Writes the pending changes if the group is full or its time window has passed.
+*/
+void Journal::commit() {
+	if (pendingChanges == 0) {
+		return;
+	}
+
+	chrono::duration<double, milli> waited = chrono::steady_clock::now() - firstPending;
+
+	if (pendingChanges >= groupSize || waited.count() >= groupWindow) {
+		sync();
+	}
+}
+
+/**
+	Writes the pending changes and forces them to disk.
+*/
+void Journal::sync() {
+	if (pendingChanges == 0 || path.empty()) {
+		return;
+	}
+
+	if (file == NULL && !openForAppend(true)) {
+		return;
+	}
+
+	fwrite(pending.data(), 1, pending.size(), file);
+	fflush(file);
+#ifdef _WIN32
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+
+	pending.clear();
+	pendingChanges = 0;
+}
+
+/**
+	Marks the point in the journal that corresponds to the current buffer, before the
+	buffer is saved over the input file.
+	@returns The position to pass to rebase once the save has finished.
+*/
+long long Journal::checkpoint() {
+	sync();
+
+	if (file == NULL) {
+		return 0;
+	}
+
+	fseek(file, 0, SEEK_END);
+	return (long long)ftell(file);
+}
+
+/**
+	Restarts the journal against the input file after the buffer was saved over it.
+	The changes recorded before the checkpoint are in the file now and are dropped;
+	the ones recorded since (while the save ran) are kept.
+	@param checkpoint The position returned by checkpoint before the save started.
+*/
+void Journal::rebase(long long checkpoint) {
+	string tail;
+
+	sync();
+
+	if (file != NULL) {
+		long end;
+
+		fflush(file);
+		fseek(file, 0, SEEK_END);
+		end = ftell(file);
+
+		if (checkpoint > 0 && checkpoint < end) {
+			FILE *in = fopen(path.c_str(), "rb");
+
+			if (in != NULL) {
+				tail.resize(end - (long)checkpoint);
+				fseek(in, (long)checkpoint, SEEK_SET);
+				tail.resize(fread(&tail[0], 1, tail.size(), in));
+				fclose(in);
+			}
+		}
+
+		fclose(file);
+		file = NULL;
+	}
+
+	fingerprint(inputPath);
+	remove(path.c_str());
+
+	if (!tail.empty() && openForAppend(true)) {
+		fwrite(tail.data(), 1, tail.size(), file);
+		fflush(file);
+	}
+}
+
+/**
+	Deletes the journal, once its changes are saved or deliberately thrown away.
+*/
+void Journal::discard() {
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+
+	if (!path.empty()) {
+		remove(path.c_str());
+	}
+
+	pending.clear();
+	pendingChanges = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "EditHistory.h"
+#include "LineStore.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+class Journal
+{
+private:
+	string path;
+	string inputPath;
+	string pending;
+	FILE *file;
+	int pendingChanges;
+	int groupSize;
+	int groupWindow;
+	long long inputSize;
+	long long inputTime;
+	unsigned int inputHash;
+	chrono::steady_clock::time_point firstPending;
+
+	static unsigned int hash(const char *data, size_t length, unsigned int seed = 2166136261u);
+	static bool readInt(FILE *in, unsigned int& value);
+	bool checkHeader(FILE *in);
+	bool fingerprint(string inputPath);
+	bool openForAppend(bool writeHeader);
+	void appendInt(unsigned int value);
+
+public:
+	Journal();
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+	virtual ~Journal();
+	static bool exists(string inputPath);
+	static bool hasChanges(string inputPath);
+	int recover(string inputPath, LineStore& store);
+	long long checkpoint();
+	void append(const Change& change);
+	void commit();
+	void discard();
+	void rebase(long long checkpoint);
+	void setGroupCommit(int numChanges, int milliseconds);
+	void sync();
+};
+
+#endif
@@ -0,0 +1,675 @@
+#include "LineRope.h"
+#include <vector>
+
+/**
+	Virtual destructor. Nodes hold no memory of their own, so unless the rope has
+	siblings they are not visited: the pool and the arena free every node and every
+	line in bulk.
+*/
+LineRope::~LineRope() {
+	if (storage.use_count() > 1) {
+		destroy(root);
+	}
+}
+
+/**
+	Creates an empty rope sharing the nodes and the arena of this one, so that lines
+	move between the two without being copied.
+	@returns The new rope; the caller owns it.
+*/
+LineStore* LineRope::createSibling() {
+	return new LineRope(storage);
+}
+
+/**
+	Frees a subtree and the text of its lines without recursing, so that degenerate
+	trees cannot exhaust the stack.
+	@param node The root of the subtree to free.
+*/
+void LineRope::destroy(RopeNode *node) {
+	vector<RopeNode*> pending;
+
+	if (node != NULL) {
+		pending.push_back(node);
+	}
+
+	while (!pending.empty()) {
+		RopeNode *temp = pending.back();
+		pending.pop_back();
+
+		if (temp->left != NULL) {
+			pending.push_back(temp->left);
+		}
+		if (temp->right != NULL) {
+			pending.push_back(temp->right);
+		}
+
+		temp->line.release(arena);
+		pool.destroy(temp);
+	}
+}
+
+/**
+	Generates the heap priority of a new node (xorshift32). The sequence is
+	deterministic, which keeps the shape of the tree reproducible between runs.
+	@returns A pseudo random priority.
+*/
+unsigned int LineRope::nextPriority() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/**
+	Allocates a detached node holding the specified data.
+	@param data The line to store in the node.
+	@returns The new node.
+*/
+RopeNode* LineRope::createNode(LineView data) {
+	RopeNode *node = pool.create();
+	node->line.assign(data.data(), data.size(), arena);
+	node->priority = nextPriority();
+	return node;
+}
+
+/**
+	Compares the line held by a node with a value.
+	@param node The node to compare.
+	@param value The value to compare against.
+	@returns True if the line equals value.
+*/
+bool LineRope::equals(RopeNode *node, LineView value) {
+	return node->line.equals(value);
+}
+
+/**
+	Copies the line held by a node.
+	@param node The node holding the line.
+	@returns The line.
+*/
+string LineRope::text(RopeNode *node) {
+	return node->line.str();
+}
+
+/**
+	Gets the number of lines in a subtree.
+	@param node The root of the subtree, may be NULL.
+	@returns The number of lines below and including node.
+*/
+int LineRope::count(RopeNode *node) {
+	return node != NULL ? node->count : 0;
+}
+
+/**
+	Recomputes the line count of a node from its children.
+	@param node The node to update.
+*/
+void LineRope::update(RopeNode *node) {
+	node->count = count(node->left) + count(node->right) + 1;
+}
+
+/**
+	Splits a subtree in two: the first index lines go into a, the rest into b.
+	@param node The root of the subtree to split.
+	@param index The number of lines to keep on the left side.
+	@param a Receives the left part.
+	@param b Receives the right part.
+*/
+void LineRope::split(RopeNode *node, int index, RopeNode *&a, RopeNode *&b) {
+	if (node == NULL) {
+		a = NULL;
+		b = NULL;
+		return;
+	}
+
+	if (count(node->left) < index) {
+		split(node->right, index - count(node->left) - 1, node->right, b);
+		a = node;
+	}
+	else {
+		split(node->left, index, a, node->left);
+		b = node;
+	}
+
+	update(node);
+}
+
+/**
+	Concatenates two subtrees, keeping every line of a before every line of b.
+	@param a The left subtree.
+	@param b The right subtree.
+	@returns The root of the merged tree.
+*/
+RopeNode* LineRope::merge(RopeNode *a, RopeNode *b) {
+	if (a == NULL) {
+		return b;
+	}
+	if (b == NULL) {
+		return a;
+	}
+
+	if (a->priority > b->priority) {
+		a->right = merge(a->right, b);
+		update(a);
+		return a;
+	}
+
+	b->left = merge(a, b->left);
+	update(b);
+	return b;
+}
+
+/**
+	Finds the node at the specified position.
+	@param index The position of the node.
+	@returns The node, or NULL if the index is out of range.
+*/
+RopeNode* LineRope::nodeAt(int index) {
+	RopeNode *node = root;
+
+	if (index < 0 || index >= count(root)) {
+		return NULL;
+	}
+
+	while (node != NULL) {
+		int leftCount = count(node->left);
+
+		if (index < leftCount) {
+			node = node->left;
+		}
+		else if (index == leftCount) {
+			break;
+		}
+		else {
+			index -= leftCount + 1;
+			node = node->right;
+		}
+	}
+
+	return node;
+}
+
+/**
+	Finds the position of the first line equal to the specified value.
+	@param value The value to search for.
+	@returns The position of the line, or -1 if no line matches.
+*/
+int LineRope::indexOf(LineView value) {
+	vector<RopeNode*> pending;
+	RopeNode *node = root;
+	int index = 0;
+
+	while (node != NULL || !pending.empty()) {
+		while (node != NULL) {
+			pending.push_back(node);
+			node = node->left;
+		}
+
+		node = pending.back();
+		pending.pop_back();
+
+		if (equals(node, value)) {
+			return index;
+		}
+
+		index++;
+		node = node->right;
+	}
+
+	return -1;
+}
+
+/**
+	Appends a new line at the end of the rope.
+	@param data The data that will be appended.
+*/
+void LineRope::add(LineView data) {
+	root = merge(root, createNode(data));
+}
+
+/**
+	Appends a line that points into memory owned by the caller, without copying it.
+	The memory must stay valid until releaseViews is called or the rope is destroyed.
+	@param text The first character of the line.
+	@param length The number of characters in the line.
+*/
+void LineRope::addView(const char *text, size_t length) {
+	RopeNode *node = pool.create();
+	node->line.assignView(text, length, arena);
+	node->priority = nextPriority();
+	root = merge(root, node);
+}
+
+/**
+	Copies every line that is still a view into the arena, or into its node if it
+	is short enough.
+*/
+void LineRope::releaseViews() {
+	vector<RopeNode*> pending;
+
+	if (root != NULL) {
+		pending.push_back(root);
+	}
+
+	while (!pending.empty()) {
+		RopeNode *node = pending.back();
+		pending.pop_back();
+
+		if (node->line.isView()) {
+			node->line.assign(node->line.data(), node->line.size(), arena);
+		}
+
+		if (node->left != NULL) {
+			pending.push_back(node->left);
+		}
+		if (node->right != NULL) {
+			pending.push_back(node->right);
+		}
+	}
+}
+
+/**
+	Captures the current lines. Lines that are still views into the loaded file are
+	referenced, not copied, so a snapshot of an unmodified document costs one span
+	per line.
+	@param snapshot Receives the lines; it is cleared first.
+*/
+void LineRope::snapshot(LineSnapshot& snapshot) {
+	vector<RopeNode*> pending;
+	RopeNode *node = root;
+
+	snapshot.clear();
+	snapshot.lines.reserve(count(root));
+
+	while (node != NULL || !pending.empty()) {
+		while (node != NULL) {
+			pending.push_back(node);
+			node = node->left;
+		}
+
+		node = pending.back();
+		pending.pop_back();
+
+		if (node->line.isView()) {
+			snapshot.addView(node->line.data(), node->line.size());
+		}
+		else {
+			snapshot.addCopy(node->line.data(), node->line.size());
+		}
+
+		node = node->right;
+	}
+}
+
+/**
+	Inserts a new line at the position specified by the index parameter. Out of
+	range positions append the line, like StringLinkedList::insertAt does.
+	@param index The position to insert the new line at.
+	@param data The data to insert.
+*/
+void LineRope::insertAt(int index, LineView data) {
+	RopeNode *a;
+	RopeNode *b;
+
+	if (index < 0 || index > count(root)) {
+		index = count(root);
+	}
+
+	split(root, index, a, b);
+	root = merge(merge(a, createNode(data)), b);
+}
+
+/**
+	Inserts a sequence of lines. They are joined into a tree of their own, which is
+	then merged into the rope with a single split.
+	@param index The position of the first new line. Out of range positions append
+	the lines.
+	@param lines The lines, in order.
+*/
+void LineRope::insertRange(int index, const vector<LineView>& lines) {
+	RopeNode *block = NULL;
+	RopeNode *a;
+	RopeNode *b;
+
+	if (index < 0 || index > count(root)) {
+		index = count(root);
+	}
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		block = merge(block, createNode(lines[i]));
+	}
+
+	split(root, index, a, b);
+	root = merge(merge(a, block), b);
+}
+
+/**
+	Copies a block of lines into a new rope sharing this one's storage. The copies
+	share the text of the lines instead of storing it again.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns The new rope; the caller owns it.
+*/
+LineStore* LineRope::copy(int start, int numItems) {
+	LineRope *block = new LineRope(storage);
+	vector<RopeNode*> pending;
+
+	seek(start, pending);
+
+	for (int i = 0; i < numItems && !pending.empty(); i++) {
+		RopeNode *node = advance(pending);
+		RopeNode *copied = pool.create();
+
+		copied->line.share(node->line, arena);
+		copied->priority = block->nextPriority();
+		block->root = block->merge(block->root, copied);
+	}
+
+	return block;
+}
+
+/**
+	Splits a block of lines off the rope and hands it to a new rope sharing this
+	one's storage. Costs two splits and a merge; no line is copied.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns The new rope; the caller owns it.
+*/
+LineStore* LineRope::cut(int start, int numItems) {
+	LineRope *block = new LineRope(storage);
+	RopeNode *a;
+	RopeNode *b;
+	RopeNode *c;
+
+	if (start < 0 || start >= count(root) || numItems <= 0) {
+		return block;
+	}
+
+	split(root, start, a, b);
+	split(b, numItems, b, c);
+	root = merge(a, c);
+	block->root = b;
+	return block;
+}
+
+/**
+	Moves every line of a block into the rope, leaving the block empty. A block
+	sharing this rope's storage is merged in as a whole, with one split and two
+	merges.
+	@param index The position of the first line of the block once moved. Out of range
+	positions append the block.
+	@param block The lines to move.
+*/
+void LineRope::paste(int index, LineStore& block) {
+	LineRope *rope = dynamic_cast<LineRope*>(&block);
+	RopeNode *a;
+	RopeNode *b;
+
+	if (rope == NULL || rope == this || rope->storage != storage) {
+		LineStore::paste(index, block);
+		return;
+	}
+
+	if (index < 0 || index > count(root)) {
+		index = count(root);
+	}
+
+	split(root, index, a, b);
+	root = merge(merge(a, rope->root), b);
+	rope->root = NULL;
+}
+
+/**
+	Updates a line's data value.
+	@param index The position of the line to be updated.
+	@param value The new value of the line.
+*/
+void LineRope::updateValue(int index, LineView value) {
+	RopeNode *node = nodeAt(index);
+
+	if (node != NULL) {
+		node->line.assign(value.data(), value.size(), arena);
+	}
+}
+
+/**
+	Deletes the first line that contains the specified value.
+	@param value The value of the line to be deleted.
+*/
+void LineRope::deleteValue(LineView value) {
+	int index = indexOf(value);
+
+	if (index >= 0) {
+		deleteRange(index, 1);
+	}
+}
+
+/**
+	Deletes the line at the location specified by the index parameter.
+	@param index The position of the line to be deleted.
+*/
+void LineRope::deleteNode(int index) {
+	deleteRange(index, 1);
+}
+
+/**
+	Deletes a range of lines, starting at the position specified by the start parameter,
+	and the size specified by the numItems parameter.
+	@param start The position at which to start deleting lines.
+	@param numItems The amount of lines to be deleted.
+*/
+void LineRope::deleteRange(int start, int numItems) {
+	RopeNode *a;
+	RopeNode *b;
+	RopeNode *c;
+
+	if (start < 0 || start >= count(root) || numItems <= 0) {
+		return;
+	}
+
+	split(root, start, a, b);
+	split(b, numItems, b, c);
+	destroy(b);
+	root = merge(a, c);
+}
+
+/**
+	Inserts a new line after the first line with the specified value. If no line
+	matches, the new line is appended at the end of the rope.
+	@param value The value of the line after which the new line will be inserted.
+	@param data The data of the new line to be inserted.
+*/
+void LineRope::insertAfterValue(LineView value, LineView data) {
+	int index = indexOf(value);
+
+	if (index >= 0) {
+		insertAt(index + 1, data);
+	}
+	else {
+		add(data);
+	}
+}
+
+/**
+	Gets the value of the line at the position specified by the index parameter.
+	@returns The value of the line, or an empty string if the index is out of range.
+*/
+string LineRope::get(int index) {
+	RopeNode *node = nodeAt(index);
+
+	if (node != NULL) {
+		return text(node);
+	}
+
+	return "";
+}
+
+/**
+	Gets the allocation counters of the node pool.
+	@returns The number of nodes handed out, reused and released, and the slabs
+	requested from the system.
+*/
+PoolStats LineRope::allocationStats() {
+	return pool.getStats();
+}
+
+/**
+	Gets up to numItems consecutive lines, starting at the position specified by the
+	start parameter. Costs one descent plus an in-order walk over the window.
+	@param start The position of the first line.
+	@param numItems The maximum number of lines to get.
+	@param lines Receives the lines; it is cleared first.
+*/
+void LineRope::getRange(int start, int numItems, vector<string>& lines) {
+	vector<RopeNode*> pending;
+
+	lines.clear();
+	seek(start, pending);
+
+	while (!pending.empty() && (int)lines.size() < numItems) {
+		lines.push_back(text(advance(pending)));
+	}
+}
+
+/**
+	Gets up to numItems consecutive lines without copying them, starting at the
+	position specified by the start parameter. The spans point into the nodes, the
+	arena or the loaded file, and are only valid until the rope is next modified.
+	@param start The position of the first line.
+	@param numItems The maximum number of lines to get.
+	@param spans Receives the lines; it is cleared first.
+*/
+void LineRope::getSpans(int start, int numItems, vector<LineSpan>& spans) {
+	vector<RopeNode*> pending;
+
+	spans.clear();
+	seek(start, pending);
+
+	while (!pending.empty() && (int)spans.size() < numItems) {
+		spans.push_back(advance(pending)->line.span());
+	}
+}
+
+/**
+	Gets the value of a line without copying it.
+	@param index The position of the line.
+	@returns The value, valid until the rope is next modified; empty if the index is
+	out of range.
+*/
+LineView LineRope::getView(int index) {
+	RopeNode *node = nodeAt(index);
+
+	if (node != NULL) {
+		return node->line.view();
+	}
+
+	return LineView();
+}
+
+/**
+	Calls a visitor with up to numItems consecutive lines, without copying them.
+	Costs one descent plus an in-order walk over the visited lines.
+	@param start The position of the first line.
+	@param numItems The maximum number of lines to visit.
+	@param visitor Receives each line; the visit stops when it returns false. It must
+	not modify the rope.
+*/
+void LineRope::visit(int start, int numItems, const LineVisitor& visitor) {
+	vector<RopeNode*> pending;
+	int index = start < 0 ? 0 : start;
+
+	seek(index, pending);
+
+	for (int i = 0; i < numItems && !pending.empty(); i++, index++) {
+		if (!visitor(index, advance(pending)->line.view())) {
+			break;
+		}
+	}
+}
+
+/**
+	Descends to a line, remembering the ancestors that come after it, so that an
+	in-order walk can start there.
+	@param start The position of the line.
+	@param pending Receives the path; the line's node is on top.
+*/
+void LineRope::seek(int start, vector<RopeNode*>& pending) {
+	RopeNode *node = root;
+
+	pending.clear();
+
+	if (start < 0) {
+		start = 0;
+	}
+
+	while (node != NULL) {
+		int leftCount = count(node->left);
+
+		if (start < leftCount) {
+			pending.push_back(node);
+			node = node->left;
+		}
+		else if (start == leftCount) {
+			pending.push_back(node);
+			break;
+		}
+		else {
+			start -= leftCount + 1;
+			node = node->right;
+		}
+	}
+}
+
+/**
+	Takes the next node of an in-order walk started by seek.
+	@param pending The walk's stack; must not be empty.
+	@returns The node.
+*/
+RopeNode* LineRope::advance(vector<RopeNode*>& pending) {
+	RopeNode *node = pending.back();
+
+	pending.pop_back();
+
+	for (RopeNode *next = node->right; next != NULL; next = next->left) {
+		pending.push_back(next);
+	}
+
+	return node;
+}
+
+/**
+	Returns the number of lines contained by this rope.
+	@returns The number of lines.
+*/
+int LineRope::size() {
+	return count(root);
+}
+
+/**
+	Writes every line to the output stream, in order, separated by line breaks.
+	@param output The stream to write the rope to.
+*/
+void LineRope::write(ostream& output) {
+	vector<RopeNode*> pending;
+	RopeNode *node = root;
+	bool isFirst = true;
+
+	while (node != NULL || !pending.empty()) {
+		while (node != NULL) {
+			pending.push_back(node);
+			node = node->left;
+		}
+
+		node = pending.back();
+		pending.pop_back();
+
+		if (!isFirst) {
+			output << '\n';
+		}
+		output.write(node->line.data(), node->line.size());
+		isFirst = false;
+
+		node = node->right;
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef LINEROPE_H
+#define LINEROPE_H
+
+#include "LineStorage.h"
+#include "LineStore.h"
+#include "RopeNode.h"
+#include "TextArena.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class LineRope : public LineStore
+{
+private:
+	RopeNode *root;
+	unsigned int seed;
+	// Shared with the siblings of the rope.
+	shared_ptr<LineStorage<RopeNode>> storage;
+	NodePool<RopeNode>& pool;
+	TextArena& arena;
+
+	explicit LineRope(shared_ptr<LineStorage<RopeNode>> storage) : root(NULL), seed(2463534242u),
+		storage(storage), pool(storage->pool), arena(storage->arena) {}
+
+	RopeNode* advance(vector<RopeNode*>& pending);
+	RopeNode* createNode(LineView data);
+	bool equals(RopeNode *node, LineView value);
+	RopeNode* merge(RopeNode *a, RopeNode *b);
+	RopeNode* nodeAt(int index);
+	int count(RopeNode *node);
+	int indexOf(LineView value);
+	string text(RopeNode *node);
+	unsigned int nextPriority();
+	void destroy(RopeNode *node);
+	void seek(int start, vector<RopeNode*>& pending);
+	void split(RopeNode *node, int index, RopeNode *&a, RopeNode *&b);
+	void update(RopeNode *node);
+
+protected:
+	void write(ostream& output);
+
+public:
+	LineRope() : LineRope(make_shared<LineStorage<RopeNode>>()) {}
+	LineRope(const LineRope&) = delete;
+	LineRope& operator=(const LineRope&) = delete;
+	virtual ~LineRope();
+	LineStore* createSibling();
+	LineStore* copy(int start, int numItems);
+	LineStore* cut(int start, int numItems);
+	PoolStats allocationStats();
+	int size();
+	string get(int index);
+	void getRange(int start, int numItems, vector<string>& lines);
+	void getSpans(int start, int numItems, vector<LineSpan>& spans);
+	LineView getView(int index);
+	void visit(int start, int numItems, const LineVisitor& visitor);
+	void add(LineView data);
+	void addView(const char *text, size_t length);
+	void deleteNode(int index);
+	void deleteRange(int start, int numItems);
+	void deleteValue(LineView value);
+	void insertAfterValue(LineView value, LineView data);
+	void insertAt(int index, LineView data);
+	void insertRange(int index, const vector<LineView>& lines);
+	void paste(int index, LineStore& block);
+	void releaseViews();
+	void snapshot(LineSnapshot& snapshot);
+	void updateValue(int index, LineView value);
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "LineScanner.h"
+#include <cstring>
+
+/**
+	Builds the index of a block of text, replacing any previous contents.
+	@param text The text to index.
+	@param length The size of the text, in bytes.
+	@param method The scanner implementation to use.
+*/
+void LineIndex::build(const char *text, size_t length, ScanMethod method) {
+	this->length = length;
+	starts.clear();
+
+	if (length == 0) {
+		return;
+	}
+
+	starts.push_back(0);
+	LineScanner::findBreaks(text, length, 0, starts, method);
+
+	// a final line break ends the last line rather than starting an empty one
+	if (starts.back() == length) {
+		starts.pop_back();
+	}
+}
+
+/**
+	Gets a line of the indexed text, without its line break.
+	@param text The text that was indexed.
+	@param index The position of the line.
+	@returns The line, as a view into the text.
+*/
+LineSpan LineIndex::line(const char *text, size_t index) {
+	size_t end = index + 1 < starts.size() ? starts[index + 1] : length;
+	return LineScanner::trim(text + starts[index], end - starts[index]);
+}
+
+/**
+	Returns the number of lines in the index.
+	@returns The number of lines.
+*/
+size_t LineIndex::size() {
+	return starts.size();
+}
+
+/**
+	Picks the fastest implementation the processor supports. Checked once.
+	@returns The scanner implementation to use for SCAN_AUTO.
+*/
+ScanMethod LineScanner::bestMethod() {
+	static const ScanMethod best = isSupported(SCAN_AVX2) ? SCAN_AVX2
+		: isSupported(SCAN_SSE2) ? SCAN_SSE2 : SCAN_SCALAR;
+
+	return best;
+}
+
+/**
+	Checks if the processor can run a scanner implementation.
+	@param method The implementation.
+	@returns True if it can be used.
+*/
+bool LineScanner::isSupported(ScanMethod method) {
+	switch (method) {
+	case SCAN_AUTO:
+	case SCAN_SCALAR:
+		return true;
+
+#ifdef LINESCANNER_X86
+	case SCAN_SSE2:
+		// every processor able to run the editor has it
+		return true;
+
+	case SCAN_AVX2:
+#ifdef _MSC_VER
+	{
+		int info[4];
+
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+
+		// the operating system must also save the YMM registers
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+
+	default:
+		return false;
+	}
+}
+
+/**
+	Gets the name of a scanner implementation, for reports.
+	@param method The implementation.
+	@returns Its name.
+*/
+const char* LineScanner::methodName(ScanMethod method) {
+	switch (method) {
+	case SCAN_SCALAR:
+		return "scalar";
+	case SCAN_SSE2:
+		return "sse2";
+	case SCAN_AVX2:
+		return "avx2";
+	default:
+		return methodName(bestMethod());
+	}
+}
+
+/**
+	Finds every line feed in a block of text. Carriage returns are left alone; see trim.
+	@param text The text to scan.
+	@param length The size of the text, in bytes.
+	@param base The offset of the text within the document, added to every result.
+	@param breaks Receives, for each line feed, the offset just past it: the start of
+	the line that follows.
+	@param method The implementation to use; falls back to scalar if unsupported.
+	@returns The number of line feeds found.
+*/
+size_t LineScanner::findBreaks(const char *text, size_t length, size_t base, vector<size_t>& breaks, ScanMethod method) {
+	if (method == SCAN_AUTO) {
+		method = bestMethod();
+	}
+	else if (!isSupported(method)) {
+		method = SCAN_SCALAR;
+	}
+
+	switch (method) {
+	case SCAN_AVX2:
+		return findAvx2(text, length, base, breaks);
+	case SCAN_SSE2:
+		return findSse2(text, length, base, breaks);
+	default:
+		return findScalar(text, length, base, breaks);
+	}
+}
+
+/**
+	Strips the line break, LF or CRLF, from the end of a line.
+	@param text The start of the line.
+	@param length The length of the line, including any line break.
+	@returns The line without its line break.
+*/
+LineSpan LineScanner::trim(const char *text, size_t length) {
+	LineSpan span;
+
+	if (length > 0 && text[length - 1] == '\n') {
+		length--;
+	}
+	if (length > 0 && text[length - 1] == '\r') {
+		length--;
+	}
+
+	span.text = text;
+	span.length = length;
+	return span;
+}
+
+/**
+	Portable implementation of findBreaks, also used for the tails the vector
+	implementations leave over.
+*/
+size_t LineScanner::findScalar(const char *text, size_t length, size_t base, vector<size_t>& breaks) {
+	const char *start = text;
+	const char *end = text + length;
+	size_t found = 0;
+
+	while (start < end) {
+		const char *lineFeed = (const char*)memchr(start, '\n', end - start);
+
+		if (lineFeed == NULL) {
+			break;
+		}
+
+		start = lineFeed + 1;
+		breaks.push_back(base + (start - text));
+		found++;
+	}
+
+	return found;
+}
+
+#ifdef LINESCANNER_X86
+
+/**
+	SSE2 implementation of findBreaks: compares 16 bytes at a time.
+*/
+size_t LineScanner::findSse2(const char *text, size_t length, size_t base, vector<size_t>& breaks) {
+	const __m128i lineFeed = _mm_set1_epi8('\n');
+	size_t found = 0;
+	size_t i = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(text + i));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, lineFeed));
+
+		while (mask != 0) {
+			breaks.push_back(base + i + lowestBit(mask) + 1);
+			mask &= mask - 1;
+			found++;
+		}
+	}
+
+	return found + findScalar(text + i, length - i, base + i, breaks);
+}
+
+/**
+	AVX2 implementation of findBreaks: compares 64 bytes per iteration, and skips
+	blocks without line feeds with a single test.
+*/
+AVX2_FUNCTION size_t LineScanner::findAvx2(const char *text, size_t length, size_t base, vector<size_t>& breaks) {
+	const __m256i lineFeed = _mm256_set1_epi8('\n');
+	size_t found = 0;
+	size_t i = 0;
+
+	for (; i + 64 <= length; i += 64) {
+		__m256i low = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + i)), lineFeed);
+		__m256i high = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + i + 32)), lineFeed);
+
+		if (_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high))) {
+			continue;
+		}
+
+		unsigned int masks[2] = {
+			(unsigned int)_mm256_movemask_epi8(low),
+			(unsigned int)_mm256_movemask_epi8(high)
+		};
+
+		for (int half = 0; half < 2; half++) {
+			unsigned int mask = masks[half];
+
+			while (mask != 0) {
+				breaks.push_back(base + i + half * 32 + lowestBit(mask) + 1);
+				mask &= mask - 1;
+				found++;
+			}
+		}
+	}
+
+	return found + findSse2(text + i, length - i, base + i, breaks);
+}
+
+#else
+
+size_t LineScanner::findSse2(const char *text, size_t length, size_t base, vector<size_t>& breaks) {
+	return findScalar(text, length, base, breaks);
+}
+
+size_t LineScanner::findAvx2(const char *text, size_t length, size_t base, vector<size_t>& breaks) {
+	return findScalar(text, length, base, breaks);
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef LINESCANNER_H
+#define LINESCANNER_H
+
+#include "LineStore.h"
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LINESCANNER_X86
+#include <immintrin.h>
+#endif
+
+// Functions using AVX2 are only called after checking the processor supports it.
+#if defined(LINESCANNER_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_FUNCTION
+#elif defined(LINESCANNER_X86)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+using namespace std;
+
+/**
+	Finds the lowest set bit of a mask.
+	@param mask A non-zero mask.
+	@returns The index of the lowest set bit.
+*/
+inline unsigned int lowestBit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+enum ScanMethod { SCAN_AUTO, SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+
+struct LineIndex
+{
+public:
+	// Offset of the first byte of each line. A line ends where the next one starts,
+	// or at the end of the text for the last one; its line break is not part of it.
+	vector<size_t> starts;
+	size_t length = 0;
+
+	void build(const char *text, size_t length, ScanMethod method = SCAN_AUTO);
+	LineSpan line(const char *text, size_t index);
+	size_t size();
+};
+
+class LineScanner
+{
+private:
+	static size_t findScalar(const char *text, size_t length, size_t base, vector<size_t>& breaks);
+	static size_t findSse2(const char *text, size_t length, size_t base, vector<size_t>& breaks);
+	static size_t findAvx2(const char *text, size_t length, size_t base, vector<size_t>& breaks);
+
+public:
+	static ScanMethod bestMethod();
+	static bool isSupported(ScanMethod method);
+	static const char* methodName(ScanMethod method);
+	static size_t findBreaks(const char *text, size_t length, size_t base, vector<size_t>& breaks, ScanMethod method = SCAN_AUTO);
+	static LineSpan trim(const char *text, size_t length);
+};
+
+#endif
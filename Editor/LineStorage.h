@@ -0,0 +1,22 @@
+#ifndef LINESTORAGE_H
+#define LINESTORAGE_H
+
+#include "NodePool.h"
+#include "TextArena.h"
+
+using namespace std;
+
+/**
+	The memory behind the lines of a store: the nodes, and the arena their text is
+	kept in. Stores created with createSibling share it, so that lines can be moved
+	from one to the other by relinking their nodes, without copying.
+*/
+template <typename T>
+struct LineStorage
+{
+public:
+	NodePool<T> pool;
+	TextArena arena;
+};
+
+#endif
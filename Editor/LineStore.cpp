@@ -0,0 +1,297 @@
+#include "LineStore.h"
+#include "StringLinkedList.h"
+#include "LineRope.h"
+#include "PagedLineStore.h"
+#include <algorithm>
+
+/**
+	Creates an empty line store of the requested type.
+	@param type The kind of container to create.
+	@param memoryLimit The memory the resident lines of a paged or compressed store
+	may take, in bytes, or 0 for the default of the store; other stores ignore it.
+	@returns A heap allocated store, owned by the caller.
+*/
+LineStore* LineStore::create(StoreType type, size_t memoryLimit) {
+	switch (type) {
+	case LINKED_LIST_STORE:
+		return new StringLinkedList();
+	case PAGED_STORE:
+		return new PagedLineStore(memoryLimit > 0 ? memoryLimit : DEFAULT_PAGE_MEMORY);
+	case COMPRESSED_STORE:
+		return new PagedLineStore(memoryLimit > 0 ? memoryLimit : DEFAULT_BLOCK_CACHE, true);
+	case ROPE_STORE:
+	default:
+		return new LineRope();
+	}
+}
+
+/**
+	Converts a store name, as given on the command line, into a StoreType.
+	@param name Either "list", "rope", "paged" or "compressed".
+	@param type Receives the parsed type when the name is valid.
+	@returns True if the name was recognized, false otherwise.
+*/
+bool LineStore::parseStoreType(string name, StoreType& type) {
+	if (name == "list") {
+		type = LINKED_LIST_STORE;
+		return true;
+	}
+	if (name == "rope") {
+		type = ROPE_STORE;
+		return true;
+	}
+	if (name == "paged") {
+		type = PAGED_STORE;
+		return true;
+	}
+	if (name == "compressed") {
+		type = COMPRESSED_STORE;
+		return true;
+	}
+	return false;
+}
+
+/**
+	Tells the store that no view of its lines is in use any more, so that memory
+	kept for them can be freed. Stores that free no line until they are modified
+	have nothing to do.
+*/
+void LineStore::expireViews() {
+}
+
+/**
+	Gets the node allocation counters of the store.
+	@returns The counters, all zero for stores that do not pool their nodes.
+*/
+PoolStats LineStore::allocationStats() {
+	return PoolStats();
+}
+
+/**
+	Gets a window of consecutive lines. Stores that can walk from one line to the
+	next override this so the cost depends on the window, not on the document.
+	@param start The position of the first line of the window.
+	@param numItems The maximum number of lines to get.
+	@param lines Receives the lines; it is cleared first.
+*/
+void LineStore::getRange(int start, int numItems, vector<string>& lines) {
+	lines.clear();
+
+	for (int i = max(start, 0); i < size() && (int)lines.size() < numItems; i++) {
+		lines.push_back(get(i));
+	}
+}
+
+/**
+	Gets a window of consecutive lines without copying them. This default collects
+	the views a visit hands out; stores whose views only last for the visit override
+	it.
+	@param start The position of the first line of the window.
+	@param numItems The maximum number of lines to get.
+	@param views Receives the lines, valid until the store is next modified; it is
+	cleared first.
+*/
+void LineStore::getViews(int start, int numItems, vector<LineView>& views) {
+	views.clear();
+	visit(start, numItems, [&views](int, LineView line) {
+		views.push_back(line);
+		return true;
+	});
+}
+
+/**
+	Appends a line that lives in memory owned by someone else, such as a mapped
+	file. Stores that cannot reference external memory copy the text.
+	@param text The first character of the line.
+	@param length The number of characters in the line.
+*/
+void LineStore::addView(const char *text, size_t length) {
+	add(LineView(text, length));
+}
+
+/**
+	Copies every line added through addView into storage owned by the store, so
+	that the memory the views point into can be released. Stores that always copy
+	have nothing to release.
+*/
+void LineStore::releaseViews() {
+}
+
+/**
+	Replaces a range of lines with other lines: numItems lines are deleted at start,
+	and lines is inserted in their place.
+	@param start The position of the first line to replace.
+	@param numItems The number of lines to delete.
+	@param lines The lines to insert at start.
+*/
+void LineStore::replaceRange(int start, int numItems, const vector<string>& lines) {
+	vector<LineView> views(lines.begin(), lines.end());
+
+	if (numItems > 0) {
+		deleteRange(start, numItems);
+	}
+
+	insertRange(start, views);
+}
+
+/**
+	Inserts a sequence of lines. Out of range positions append the lines, like
+	insertAt does. This default inserts them one at a time; stores override it to
+	find the position only once.
+	@param index The position of the first new line.
+	@param lines The lines, in order. They may be views of lines of this store.
+*/
+void LineStore::insertRange(int index, const vector<LineView>& lines) {
+	if (index < 0 || index > size()) {
+		index = size();
+	}
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		insertAt(index + (int)i, lines[i]);
+	}
+}
+
+/**
+	Checks that every line of the store can be read. Stores that keep lines outside
+	of memory may fail to read them back; such lines read as empty and can't be
+	changed, and the store must not be saved once it lost any.
+	@returns True if no line was lost.
+*/
+bool LineStore::isIntact() {
+	return true;
+}
+
+/**
+	Copies a block of lines into a new store.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns A sibling of this store holding copies of the lines; the caller owns it.
+*/
+LineStore* LineStore::copy(int start, int numItems) {
+	LineStore *block = createSibling();
+	vector<LineView> views;
+
+	getViews(max(start, 0), numItems, views);
+	block->insertRange(0, views);
+	return block;
+}
+
+/**
+	Takes a block of lines out of the store. This default copies the lines; stores
+	override it to move them.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns A sibling of this store holding the lines; the caller owns it.
+*/
+LineStore* LineStore::cut(int start, int numItems) {
+	LineStore *block = copy(start, numItems);
+
+	if (block->size() > 0) {
+		deleteRange(max(start, 0), block->size());
+	}
+
+	return block;
+}
+
+/**
+	Moves every line of a block into the store, leaving the block empty. This default
+	copies the lines; stores override it to relink them when the block shares their
+	storage.
+	@param index The position of the first line of the block once moved. Out of range
+	positions append the block.
+	@param block The lines to move; must be another store.
+*/
+void LineStore::paste(int index, LineStore& block) {
+	vector<LineView> views;
+
+	if (&block == this) {
+		return;
+	}
+
+	block.getViews(0, block.size(), views);
+	insertRange(index, views);
+	block.deleteRange(0, block.size());
+}
+
+/**
+	Moves a block of lines from a store into this one. The source may be this store.
+	@param index The position of the first line of the block once moved, counted
+	after it has been taken out of the source.
+	@param source The store the lines are taken from.
+	@param start The position of the first line of the block in the source.
+	@param numItems The number of lines in the block.
+*/
+void LineStore::splice(int index, LineStore& source, int start, int numItems) {
+	LineStore *block = source.cut(start, numItems);
+
+	paste(index, *block);
+	delete block;
+}
+
+/**
+	Captures the current contents of the store, so that they can be read (e.g. saved
+	from another thread) while the store keeps changing. This default copies every
+	line.
+	@param snapshot Receives the lines; it is cleared first.
+*/
+void LineStore::snapshot(LineSnapshot& snapshot) {
+	vector<string> lines;
+
+	snapshot.clear();
+	getRange(0, size(), lines);
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		snapshot.addCopy(lines[i]);
+	}
+}
+
+/**
+	Adds a copy of a line to the snapshot.
+	@param line The line to copy.
+*/
+void LineSnapshot::addCopy(const string& line) {
+	copies.push_back(line);
+
+	LineSpan span = { copies.back().data(), copies.back().size() };
+	lines.push_back(span);
+}
+
+/**
+	Adds a copy of a line to the snapshot.
+	@param text The first character of the line.
+	@param length The number of characters in the line.
+*/
+void LineSnapshot::addCopy(const char *text, size_t length) {
+	copies.push_back(string(text, length));
+
+	LineSpan span = { copies.back().data(), copies.back().size() };
+	lines.push_back(span);
+}
+
+/**
+	Adds a line to the snapshot without copying it. The memory must outlive the
+	snapshot.
+	@param text The first character of the line.
+	@param length The number of characters in the line.
+*/
+void LineSnapshot::addView(const char *text, size_t length) {
+	LineSpan span = { text, length };
+	lines.push_back(span);
+}
+
+/**
+	Empties the snapshot.
+*/
+void LineSnapshot::clear() {
+	lines.clear();
+	copies.clear();
+}
+
+/**
+	Overridden output (<<) operator. Writes every line of the store, separated
+	by line breaks.
+*/
+ostream& operator<<(ostream& output, LineStore& store) {
+	store.write(output);
+	return output;
+}
@@ -0,0 +1,86 @@
+#ifndef LINESTORE_H
+#define LINESTORE_H
+
+#include "LineView.h"
+#include "NodePool.h"
+#include <deque>
+#include <functional>
+#include <string>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+struct LineSpan
+{
+	const char *text;
+	size_t length;
+};
+
+struct LineSnapshot
+{
+public:
+	// Lines that were views into memory that outlives the snapshot (such as a mapped
+	// file) are referenced in place; every other line is copied into copies, whose
+	// elements never move once added.
+	vector<LineSpan> lines;
+	deque<string> copies;
+
+	void addCopy(const string& line);
+	void addCopy(const char *text, size_t length);
+	void addView(const char *text, size_t length);
+	void clear();
+};
+
+enum StoreType { LINKED_LIST_STORE, ROPE_STORE, PAGED_STORE, COMPRESSED_STORE };
+
+// The memory the resident lines of paged stores may take by default, in bytes. A
+// compressed store keeps the rest of its lines in memory, so it only keeps a few
+// pages decompressed.
+const size_t DEFAULT_PAGE_MEMORY = 256 * 1024 * 1024;
+const size_t DEFAULT_BLOCK_CACHE = 16 * 1024 * 1024;
+
+// Receives the position and the text of a line, which is only sure to stay valid
+// until the visitor returns; returns false to stop the visit.
+typedef function<bool(int, LineView)> LineVisitor;
+
+class LineStore
+{
+protected:
+	virtual void write(ostream& output) = 0;
+
+public:
+	friend ostream& operator<<(ostream& output, LineStore& store);
+	static LineStore* create(StoreType type, size_t memoryLimit = 0);
+	static bool parseStoreType(string name, StoreType& type);
+	virtual ~LineStore() {}
+	virtual LineStore* createSibling() = 0;
+	virtual PoolStats allocationStats();
+	virtual int size() = 0;
+	virtual string get(int index) = 0;
+	virtual void getRange(int start, int numItems, vector<string>& lines);
+	virtual void getSpans(int start, int numItems, vector<LineSpan>& spans) = 0;
+	virtual LineView getView(int index) = 0;
+	virtual void getViews(int start, int numItems, vector<LineView>& views);
+	virtual void visit(int start, int numItems, const LineVisitor& visitor) = 0;
+	virtual void add(LineView data) = 0;
+	virtual void addView(const char *text, size_t length);
+	virtual LineStore* copy(int start, int numItems);
+	virtual LineStore* cut(int start, int numItems);
+	virtual void deleteNode(int index) = 0;
+	virtual void deleteRange(int start, int numItems) = 0;
+	virtual void deleteValue(LineView value) = 0;
+	virtual void expireViews();
+	virtual void insertAfterValue(LineView value, LineView data) = 0;
+	virtual void insertAt(int index, LineView data) = 0;
+	virtual void insertRange(int index, const vector<LineView>& lines);
+	virtual bool isIntact();
+	virtual void paste(int index, LineStore& block);
+	virtual void releaseViews();
+	virtual void replaceRange(int start, int numItems, const vector<string>& lines);
+	virtual void snapshot(LineSnapshot& snapshot);
+	void splice(int index, LineStore& source, int start, int numItems);
+	virtual void updateValue(int index, LineView value) = 0;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef LINEVIEW_H
+#define LINEVIEW_H
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+/**
+	A read-only reference to the text of a line, in the spirit of std::string_view,
+	which the toolset this project targets does not have. It does not own the text:
+	views handed out by a line store are only valid until the store is modified.
+	Strings convert to views implicitly, so functions taking a LineView accept a
+	string without copying it.
+*/
+class LineView
+{
+private:
+	const char *text;
+	size_t length;
+
+public:
+	typedef const char* const_iterator;
+
+	LineView() : text(""), length(0) {}
+	LineView(const char *text, size_t length) : text(text), length(length) {}
+	LineView(const char *text) : text(text), length(strlen(text)) {}
+	LineView(const string& value) : text(value.data()), length(value.size()) {}
+
+	const char* data() const {
+		return text;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	bool empty() const {
+		return length == 0;
+	}
+
+	const_iterator begin() const {
+		return text;
+	}
+
+	const_iterator end() const {
+		return text + length;
+	}
+
+	char operator[](size_t index) const {
+		return text[index];
+	}
+
+	string str() const {
+		return string(text, length);
+	}
+};
+
+inline bool operator==(const LineView& a, const LineView& b) {
+	return a.size() == b.size() && (a.size() == 0 || memcmp(a.data(), b.data(), a.size()) == 0);
+}
+
+inline bool operator!=(const LineView& a, const LineView& b) {
+	return !(a == b);
+}
+
+inline ostream& operator<<(ostream& output, const LineView& line) {
+	return output.write(line.data(), line.size());
+}
+
+#endif
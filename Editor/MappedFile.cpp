@@ -0,0 +1,155 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+	Default constructor. Creates an unmapped file.
+*/
+#ifdef _WIN32
+MappedFile::MappedFile() : contents(NULL), length(0), fileHandle(NULL), mappingHandle(NULL) {}
+#else
+MappedFile::MappedFile() : contents(NULL), length(0), fileDescriptor(-1) {}
+#endif
+
+/**
+	Virtual destructor. Unmaps the file if it is still mapped.
+*/
+MappedFile::~MappedFile() {
+	close();
+}
+
+/**
+	Maps a file into memory, read only. Any file previously mapped by this object is
+	released first. Empty files are opened successfully but have no mapping.
+	@param path The path of the file to map.
+	@returns True if the file was mapped, false otherwise.
+*/
+bool MappedFile::open(string path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER fileSize;
+
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	length = (size_t)fileSize.QuadPart;
+
+	if (length > 0) {
+		mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (mappingHandle != NULL) {
+			contents = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		if (contents == NULL) {
+			close();
+			return false;
+		}
+	}
+#else
+	struct stat info;
+
+	fileDescriptor = ::open(path.c_str(), O_RDONLY);
+
+	if (fileDescriptor < 0) {
+		return false;
+	}
+
+	if (fstat(fileDescriptor, &info) != 0) {
+		close();
+		return false;
+	}
+
+	length = (size_t)info.st_size;
+
+	if (length > 0) {
+		void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+		if (address == MAP_FAILED) {
+			close();
+			return false;
+		}
+
+		contents = (const char*)address;
+	}
+#endif
+
+	return true;
+}
+
+/**
+	Checks whether a file is currently open.
+	@returns True if a file is open, false otherwise.
+*/
+bool MappedFile::isOpen() {
+#ifdef _WIN32
+	return fileHandle != NULL;
+#else
+	return fileDescriptor >= 0;
+#endif
+}
+
+/**
+	Gets the mapped contents of the file.
+	@returns A pointer to the first byte of the file, or NULL if nothing is mapped.
+*/
+const char* MappedFile::data() {
+	return contents;
+}
+
+/**
+	Gets the size of the mapped file.
+	@returns The size of the file, in bytes.
+*/
+size_t MappedFile::size() {
+	return length;
+}
+
+/**
+	Unmaps the file and closes its handles. Every view into the mapping becomes invalid.
+*/
+void MappedFile::close() {
+#ifdef _WIN32
+	if (contents != NULL) {
+		UnmapViewOfFile(contents);
+	}
+	if (mappingHandle != NULL) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != NULL) {
+		CloseHandle(fileHandle);
+	}
+
+	fileHandle = NULL;
+	mappingHandle = NULL;
+#else
+	if (contents != NULL) {
+		munmap((void*)contents, length);
+	}
+	if (fileDescriptor >= 0) {
+		::close(fileDescriptor);
+	}
+
+	fileDescriptor = -1;
+#endif
+
+	contents = NULL;
+	length = 0;
+}
@@ -0,0 +1,414 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+// Counted by the global allocation functions below, across every thread.
+static atomic<long long> numAllocations(0);
+static atomic<long long> numFrees(0);
+static atomic<long long> allocatedBytes(0);
+
+/*
+	Replacements for the global allocation functions that count every allocation
+	made by the program. The array and sized forms forward to these.
+*/
+void* operator new(size_t size) {
+	void *memory = malloc(size > 0 ? size : 1);
+
+	if (memory == NULL) {
+		throw bad_alloc();
+	}
+
+	numAllocations.fetch_add(1, memory_order_relaxed);
+	allocatedBytes.fetch_add((long long)size, memory_order_relaxed);
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	if (memory != NULL) {
+		numFrees.fetch_add(1, memory_order_relaxed);
+		free(memory);
+	}
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+/**
+	Default constructor.
+*/
+LatencyHistogram::LatencyHistogram() : count(0), total(0), maximum(0) {
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		buckets[i] = 0;
+	}
+}
+
+/**
+	Counts a duration.
+	@param nanoseconds The duration.
+*/
+void LatencyHistogram::add(long long nanoseconds) {
+	int bucket = 0;
+
+	while (bucket + 1 < HISTOGRAM_BUCKETS && (nanoseconds >> (bucket + 1)) > 0) {
+		bucket++;
+	}
+
+	buckets[bucket]++;
+	count++;
+	total += nanoseconds;
+	maximum = max(maximum, nanoseconds);
+}
+
+/**
+	Gets the number of durations counted in a bucket.
+	@param bucket The bucket, holding durations from 2^bucket up to 2^(bucket + 1)
+	nanoseconds.
+	@returns The number of durations.
+*/
+long long LatencyHistogram::getBucket(int bucket) const {
+	return buckets[bucket];
+}
+
+/**
+	Gets the number of durations counted.
+	@returns The number of durations.
+*/
+long long LatencyHistogram::getCount() const {
+	return count;
+}
+
+/**
+	Gets the longest duration counted.
+	@returns The duration, in nanoseconds.
+*/
+long long LatencyHistogram::getMax() const {
+	return maximum;
+}
+
+/**
+	Gets the average duration.
+	@returns The duration, in nanoseconds, or 0 if none was counted.
+*/
+long long LatencyHistogram::getMean() const {
+	return count > 0 ? total / count : 0;
+}
+
+/**
+	Gets the duration that a fraction of the counted durations do not exceed. Only
+	the bucket is known, so its upper bound is returned, capped by the maximum.
+	@param fraction The fraction, from 0 to 1.
+	@returns The duration, in nanoseconds.
+*/
+long long LatencyHistogram::getPercentile(double fraction) const {
+	long long target = (long long)(fraction * count + 0.5);
+	long long seen = 0;
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += buckets[i];
+
+		if (seen >= max(target, 1LL)) {
+			return min(2LL << i, maximum);
+		}
+	}
+
+	return maximum;
+}
+
+/**
+	Gets the sum of the counted durations.
+	@returns The duration, in nanoseconds.
+*/
+long long LatencyHistogram::getTotal() const {
+	return total;
+}
+
+/**
+	Default constructor.
+*/
+Metrics::Metrics() : numUnrecognized(0), depth(0), skipped(0), active(false) {
+	for (int i = 0; i < PHASE_COUNT; i++) {
+		phaseTime[i] = 0;
+		phaseUsed[i] = false;
+	}
+}
+
+/**
+	Gets the allocation counters of the whole program, including the background
+	threads.
+	@returns The counters, since the program started.
+*/
+AllocationCounts Metrics::allocationCounts() {
+	AllocationCounts counts;
+
+	counts.allocations = numAllocations.load(memory_order_relaxed);
+	counts.frees = numFrees.load(memory_order_relaxed);
+	counts.bytes = allocatedBytes.load(memory_order_relaxed);
+	return counts;
+}
+
+/**
+	Starts measuring a command. Time spent outside of any phase is charged to the
+	execute phase.
+*/
+void Metrics::beginCommand() {
+	for (int i = 0; i < PHASE_COUNT; i++) {
+		phaseTime[i] = 0;
+		phaseUsed[i] = false;
+	}
+
+	depth = 0;
+	skipped = 0;
+	active = true;
+	startCounts = allocationCounts();
+	mark = chrono::steady_clock::now();
+}
+
+/**
+	Finishes measuring a command and adds its phases, its latency and the memory it
+	allocated to the totals. The allocations include those of background threads
+	while the command ran.
+	@param type The command type.
+	@param recognized False if the command could not be parsed; only its phases are
+	counted then.
+*/
+void Metrics::endCommand(CommandType type, bool recognized) {
+	AllocationCounts counts = allocationCounts();
+	long long total = 0;
+
+	if (!active) {
+		return;
+	}
+
+	charge();
+	active = false;
+
+	for (int i = 0; i < PHASE_COUNT; i++) {
+		if (phaseUsed[i]) {
+			phases[i].add(phaseTime[i]);
+		}
+		if (i != PHASE_INPUT) {
+			total += phaseTime[i];
+		}
+	}
+	latency.add(total);
+
+	if (!recognized) {
+		numUnrecognized++;
+		return;
+	}
+
+	commands[type].add(total);
+	commandAllocations[type].allocations += counts.allocations - startCounts.allocations;
+	commandAllocations[type].frees += counts.frees - startCounts.frees;
+	commandAllocations[type].bytes += counts.bytes - startCounts.bytes;
+}
+
+/**
+	Charges the time since the last phase change to the current phase.
+*/
+void Metrics::charge() {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	Phase phase = depth > 0 ? stack[depth - 1] : PHASE_EXECUTE;
+
+	phaseTime[phase] += chrono::duration_cast<chrono::nanoseconds>(now - mark).count();
+	phaseUsed[phase] = true;
+	mark = now;
+}
+
+/**
+	Starts a phase of the command being measured. Phases nest: time is only charged
+	to the innermost one, so drawing inside a command does not count as executing
+	it. Does nothing outside of a command.
+	@param phase The phase.
+*/
+void Metrics::enter(Phase phase) {
+	if (!active) {
+		return;
+	}
+
+	if (depth == MAX_PHASE_DEPTH) {
+		skipped++;
+		return;
+	}
+
+	charge();
+	stack[depth++] = phase;
+}
+
+/**
+	Ends the innermost phase of the command being measured.
+*/
+void Metrics::leave() {
+	if (!active) {
+		return;
+	}
+
+	if (skipped > 0) {
+		skipped--;
+		return;
+	}
+
+	if (depth > 0) {
+		charge();
+		depth--;
+	}
+}
+
+/**
+	Formats a duration with a unit that suits it.
+	@param nanoseconds The duration.
+	@returns The formatted duration, such as "12.5 us".
+*/
+string Metrics::formatDuration(long long nanoseconds) {
+	stringstream ss;
+
+	ss << fixed << setprecision(1);
+
+	if (nanoseconds < 1000) {
+		ss << nanoseconds << " ns";
+	}
+	else if (nanoseconds < 1000000) {
+		ss << nanoseconds / 1e3 << " us";
+	}
+	else if (nanoseconds < 1000000000) {
+		ss << nanoseconds / 1e6 << " ms";
+	}
+	else {
+		ss << nanoseconds / 1e9 << " s";
+	}
+
+	return ss.str();
+}
+
+/**
+	Formats a number of bytes with a unit that suits it.
+	@param bytes The number of bytes.
+	@returns The formatted size, such as "1.5 MB".
+*/
+string Metrics::formatBytes(double bytes) {
+	stringstream ss;
+
+	ss << fixed << setprecision(1);
+
+	if (bytes < 1024) {
+		ss << bytes << " B";
+	}
+	else if (bytes < 1024 * 1024) {
+		ss << bytes / 1024 << " KB";
+	}
+	else {
+		ss << bytes / (1024 * 1024) << " MB";
+	}
+
+	return ss.str();
+}
+
+/**
+	Gets the name of a phase, as shown in the report.
+	@param phase The phase.
+	@returns The name.
+*/
+const char* Metrics::phaseName(Phase phase) {
+	switch (phase) {
+	case PHASE_PARSE:
+		return "parse";
+	case PHASE_EXECUTE:
+		return "execute";
+	case PHASE_RENDER:
+		return "render";
+	case PHASE_IO:
+		return "io";
+	case PHASE_INPUT:
+	default:
+		return "input";
+	}
+}
+
+/**
+	Writes the totals as tables: the time spent in each phase, the latency and
+	allocations of each command, and a histogram of the latency of every command.
+	The latency of a command is the sum of its phases, except for input.
+	@param output The stream to write to.
+*/
+void Metrics::report(ostream& output) {
+	AllocationCounts counts = allocationCounts();
+	long long peak = 0;
+
+	output << "Commands: " << latency.getCount() << " (" << numUnrecognized << " unrecognized)" << endl;
+	output << "Allocations: " << counts.allocations << " (" << counts.allocations - counts.frees << " live), "
+		<< formatBytes((double)counts.bytes) << " allocated" << endl << endl;
+
+	output << left << setw(10) << "PHASE" << right << setw(8) << "COUNT" << setw(12) << "MEAN"
+		<< setw(12) << "P50" << setw(12) << "P90" << setw(12) << "P99" << setw(12) << "MAX"
+		<< setw(12) << "TOTAL" << endl;
+
+	for (int i = 0; i <= PHASE_COUNT; i++) {
+		const LatencyHistogram& histogram = i < PHASE_COUNT ? phases[i] : latency;
+
+		output << left << setw(10) << (i < PHASE_COUNT ? phaseName((Phase)i) : "latency") << right
+			<< setw(8) << histogram.getCount() << setw(12) << formatDuration(histogram.getMean())
+			<< setw(12) << formatDuration(histogram.getPercentile(0.5))
+			<< setw(12) << formatDuration(histogram.getPercentile(0.9))
+			<< setw(12) << formatDuration(histogram.getPercentile(0.99))
+			<< setw(12) << formatDuration(histogram.getMax())
+			<< setw(12) << formatDuration(histogram.getTotal()) << endl;
+	}
+
+	output << endl << left << setw(10) << "CMD" << right << setw(8) << "COUNT" << setw(12) << "MEAN"
+		<< setw(12) << "P99" << setw(12) << "MAX" << setw(14) << "ALLOCS/CMD" << setw(14) << "BYTES/CMD" << endl;
+
+	for (int i = 0; i < CMD_COUNT; i++) {
+		const LatencyHistogram& histogram = commands[i];
+		long long count = histogram.getCount();
+
+		if (count == 0) {
+			continue;
+		}
+
+		output << left << setw(10) << CommandParser::getLetter((CommandType)i) << right
+			<< setw(8) << count << setw(12) << formatDuration(histogram.getMean())
+			<< setw(12) << formatDuration(histogram.getPercentile(0.99))
+			<< setw(12) << formatDuration(histogram.getMax())
+			<< setw(14) << commandAllocations[i].allocations / count
+			<< setw(14) << formatBytes((double)commandAllocations[i].bytes / count) << endl;
+	}
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		peak = max(peak, latency.getBucket(i));
+	}
+
+	output << endl << "Latency histogram:" << endl;
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		long long count = latency.getBucket(i);
+
+		if (count == 0) {
+			continue;
+		}
+
+		output << "  < " << left << setw(10) << formatDuration(2LL << i) << "|"
+			<< setw(40) << string((size_t)(count * 40 / peak), '#') << "| " << right << count << endl;
+	}
+}
+
+/**
+	Writes the report to a file.
+	@param path The path of the file.
+	@returns True if the file was written.
+*/
+bool Metrics::writeReport(string path) {
+	ofstream file(path);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	report(file);
+	return file.good();
+}
@@ -0,0 +1,114 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "CommandParser.h"
+#include <chrono>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+// Bucket i of a histogram counts durations from 2^i up to 2^(i+1) nanoseconds.
+const int HISTOGRAM_BUCKETS = 48;
+const int MAX_PHASE_DEPTH = 8;
+
+enum Phase {
+	PHASE_PARSE,
+	PHASE_EXECUTE,
+	PHASE_RENDER,
+	PHASE_IO,
+	// Waiting for the text of I, S and F; not counted in a command's latency.
+	PHASE_INPUT,
+	PHASE_COUNT
+};
+
+struct AllocationCounts
+{
+public:
+	AllocationCounts() : allocations(0), frees(0), bytes(0) {}
+
+	long long allocations;
+	long long frees;
+	long long bytes;
+};
+
+class LatencyHistogram
+{
+private:
+	long long buckets[HISTOGRAM_BUCKETS];
+	long long count;
+	long long total;
+	long long maximum;
+
+public:
+	LatencyHistogram();
+	void add(long long nanoseconds);
+	long long getBucket(int bucket) const;
+	long long getCount() const;
+	long long getMax() const;
+	long long getMean() const;
+	long long getPercentile(double fraction) const;
+	long long getTotal() const;
+};
+
+class Metrics
+{
+private:
+	LatencyHistogram phases[PHASE_COUNT];
+	LatencyHistogram latency;
+	LatencyHistogram commands[CMD_COUNT];
+	AllocationCounts commandAllocations[CMD_COUNT];
+	long long numUnrecognized;
+	// The command being measured.
+	long long phaseTime[PHASE_COUNT];
+	bool phaseUsed[PHASE_COUNT];
+	Phase stack[MAX_PHASE_DEPTH];
+	int depth;
+	int skipped;
+	bool active;
+	chrono::steady_clock::time_point mark;
+	AllocationCounts startCounts;
+
+	void charge();
+	static string formatDuration(long long nanoseconds);
+	static string formatBytes(double bytes);
+	static const char* phaseName(Phase phase);
+
+public:
+	Metrics();
+	static AllocationCounts allocationCounts();
+	void beginCommand();
+	void endCommand(CommandType type, bool recognized);
+	void enter(Phase phase);
+	void leave();
+	void report(ostream& output);
+	bool writeReport(string path);
+};
+
+/*
+	Charges the time until it goes out of scope to a phase of the command being
+	measured.
+*/
+class PhaseTimer
+{
+private:
+	Metrics *metrics;
+
+public:
+	PhaseTimer(Metrics *metrics, Phase phase) : metrics(metrics) {
+		if (metrics != NULL) {
+			metrics->enter(phase);
+		}
+	}
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	~PhaseTimer() {
+		if (metrics != NULL) {
+			metrics->leave();
+		}
+	}
+};
+
+#endif
@@ -1,16 +1,17 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include <string>
+#include "CompactLine.h"
 
 using namespace std;
 
 struct Node
 {
 public:
-	Node() : next(NULL), data("") {}
+	Node() : next(NULL) {}
 
-	string data;
+	// Its text is stored in the list's arena.
+	CompactLine line;
 	Node *next;
 };
 
@@ -0,0 +1,95 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+struct PoolStats
+{
+public:
+	PoolStats() : allocations(0), reuses(0), releases(0), slabs(0), slabBytes(0) {}
+
+	long long allocations;
+	long long reuses;
+	long long releases;
+	long long slabs;
+	long long slabBytes;
+};
+
+/**
+	Slab allocator for fixed size objects. Objects are carved out of large slabs,
+	released objects go on a free list for reuse, and every slab is returned to the
+	system in one pass when the pool is destroyed. The pool does not track live
+	objects: owners must call destroy (or run the destructors themselves) before
+	the pool goes away if T has a non-trivial destructor.
+*/
+template <typename T>
+class NodePool
+{
+private:
+	union Slot
+	{
+		Slot *next;
+		typename aligned_storage<sizeof(T), alignof(T)>::type storage;
+	};
+
+	vector<Slot*> slabs;
+	Slot *freeList;
+	Slot *cursor;
+	Slot *slabEnd;
+	size_t slabSize;
+	PoolStats stats;
+
+public:
+	NodePool(size_t slabSize = 1024) : freeList(NULL), cursor(NULL), slabEnd(NULL), slabSize(slabSize) {}
+	NodePool(const NodePool&) = delete;
+	NodePool& operator=(const NodePool&) = delete;
+
+	virtual ~NodePool() {
+		for (size_t i = 0; i < slabs.size(); i++) {
+			::operator delete(slabs[i]);
+		}
+	}
+
+	T* create() {
+		Slot *slot;
+
+		if (freeList != NULL) {
+			slot = freeList;
+			freeList = freeList->next;
+			stats.reuses++;
+		}
+		else {
+			if (cursor == slabEnd) {
+				cursor = (Slot*)::operator new(sizeof(Slot) * slabSize);
+				slabEnd = cursor + slabSize;
+				slabs.push_back(cursor);
+				stats.slabs++;
+				stats.slabBytes += sizeof(Slot) * slabSize;
+			}
+			slot = cursor++;
+		}
+
+		stats.allocations++;
+		return new (&slot->storage) T();
+	}
+
+	void destroy(T *object) {
+		Slot *slot = (Slot*)object;
+
+		object->~T();
+		slot->next = freeList;
+		freeList = slot;
+		stats.releases++;
+	}
+
+	PoolStats getStats() {
+		return stats;
+	}
+};
+
+#endif
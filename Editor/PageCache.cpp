@@ -0,0 +1,431 @@
+#include "PageCache.h"
+#include "BlockCodec.h"
+#include "LineScanner.h"
+#include <iterator>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+/**
+	Main constructor.
+	@param memoryLimit The memory the resident pages may take, in bytes.
+	@param compress Whether evicted pages are compressed in memory rather than
+	written to a swap file.
+*/
+PageCache::PageCache(size_t memoryLimit, bool compress) : retiredBytes(0), swap(NULL), swapEnd(0), swapGarbage(0), compress(compress),
+	memoryLimit(memoryLimit), residentBytes(0), packedBytes(0), pageIns(0), pageOuts(0) {
+}
+
+/**
+	Virtual destructor. Closing the swap file deletes it.
+*/
+PageCache::~PageCache() {
+	if (swap != NULL) {
+		fclose(swap);
+	}
+}
+
+/**
+	Gets the memory the resident pages may take.
+	@returns The budget, in bytes.
+*/
+size_t PageCache::getMemoryLimit() {
+	return memoryLimit;
+}
+
+/**
+	Gets the memory the resident pages take.
+	@returns The memory, in bytes.
+*/
+size_t PageCache::getResidentBytes() {
+	return residentBytes;
+}
+
+/**
+	Gets the memory the lines of evicted pages take while views of them may still be
+	in use.
+	@returns The memory, in bytes.
+*/
+size_t PageCache::getRetiredBytes() {
+	return retiredBytes;
+}
+
+/**
+	Gets the memory the compressed copies of pages take.
+	@returns The memory, in bytes.
+*/
+size_t PageCache::getPackedBytes() {
+	return packedBytes;
+}
+
+/**
+	Gets the size of the swap file, including the room left by pages that were
+	rewritten elsewhere or deleted.
+	@returns The size, in bytes.
+*/
+long long PageCache::getSwapBytes() {
+	return swapEnd;
+}
+
+/**
+	Gets the number of pages made resident again after they were evicted.
+	@returns The number of pages.
+*/
+long long PageCache::getPageIns() {
+	return pageIns;
+}
+
+/**
+	Gets the number of pages evicted.
+	@returns The number of pages.
+*/
+long long PageCache::getPageOuts() {
+	return pageOuts;
+}
+
+/**
+	Estimates the heap memory a line's text takes beyond the string itself, which
+	keeps short text in place. The estimate depends on the length only: the capacity
+	of a string changes as lines are moved around in a page, and the estimates added
+	and removed for a line must match.
+	@param line The line.
+	@returns The memory, in bytes.
+*/
+size_t PageCache::textMemory(const string& line) {
+	static const size_t inlineCapacity = string().capacity();
+
+	return line.size() > inlineCapacity ? line.size() + 1 : 0;
+}
+
+/**
+	Counts the memory of a resident page again, after its lines changed.
+	@param page The page.
+*/
+void PageCache::account(LinePage *page) {
+	if (!page->resident) {
+		return;
+	}
+
+	size_t memory = page->spans.capacity() * sizeof(LineSpan) + page->lines.capacity() * sizeof(string) + page->textBytes;
+
+	residentBytes = residentBytes - page->memory + memory;
+	page->memory = memory;
+}
+
+/**
+	Starts tracking a new page, which holds its lines, as the most recently used.
+	@param page The page.
+*/
+void PageCache::insert(LinePage *page) {
+	recent.push_front(page);
+	page->recent = recent.begin();
+	page->resident = true;
+	page->memory = 0;
+	account(page);
+}
+
+/**
+	Makes a page resident, splitting it from its source or reading it from the swap
+	file, and marks it as the most recently used. A page that can't be read back
+	stays evicted.
+	@param page The page.
+	@returns False if the page could not be read back.
+*/
+bool PageCache::load(LinePage *page) {
+	if (page->resident) {
+		recent.splice(recent.begin(), recent, page->recent);
+		return true;
+	}
+
+	if (page->owned) {
+		if (!readBack(page, page->lines)) {
+			vector<string>().swap(page->lines);
+			return false;
+		}
+
+		for (size_t i = 0; i < page->lines.size(); i++) {
+			page->textBytes += textMemory(page->lines[i]);
+		}
+		page->dirty = false;
+	}
+	else {
+		vector<size_t> breaks;
+		size_t lineStart = 0;
+
+		// split as DocumentLoader split the lines; the text ends with the last line
+		// of the page, without its line break
+		breaks.reserve(page->numLines);
+		LineScanner::findBreaks(page->source, page->sourceBytes, 0, breaks);
+		page->spans.reserve(page->numLines);
+
+		for (size_t i = 0; i < breaks.size(); i++) {
+			page->spans.push_back(LineScanner::trim(page->source + lineStart, breaks[i] - lineStart));
+			lineStart = breaks[i];
+		}
+
+		LineSpan last = { page->source + lineStart, page->sourceBytes - lineStart };
+		page->spans.push_back(last);
+	}
+
+	insert(page);
+	pageIns++;
+	return true;
+}
+
+/**
+	Drops the lines of a resident page, writing them to the swap file or compressing
+	them first if they can't be read back otherwise. The lines of a page that views
+	were handed out of are kept until the cache is next trimmed without keeping
+	views, since the views may still be in use.
+	@param page The page.
+	@returns False if the page had to be written and could not be.
+*/
+bool PageCache::evict(LinePage *page) {
+	if (!page->resident) {
+		return true;
+	}
+
+	if (page->owned && (page->dirty || !hasCopy(page)) && !writeBack(page)) {
+		return false;
+	}
+
+	if (page->viewed && !page->lines.empty()) {
+		retired.push_back(vector<string>());
+		retired.back().swap(page->lines);
+		retiredBytes += page->memory;
+	}
+
+	vector<LineSpan>().swap(page->spans);
+	vector<string>().swap(page->lines);
+	page->textBytes = 0;
+	residentBytes -= page->memory;
+	page->memory = 0;
+	recent.erase(page->recent);
+	page->resident = false;
+	page->viewed = false;
+	pageOuts++;
+	return true;
+}
+
+/**
+	Stops tracking a page that is about to be deleted.
+	@param page The page.
+*/
+void PageCache::forget(LinePage *page) {
+	if (page->resident) {
+		residentBytes -= page->memory;
+		recent.erase(page->recent);
+		page->resident = false;
+	}
+
+	if (page->swapOffset >= 0) {
+		swapGarbage += page->swapBytes;
+	}
+
+	packedBytes -= page->packed.size();
+}
+
+/**
+	Evicts the least recently used pages until the resident ones fit in the budget.
+	@param pinned A page to keep, such as the one just used, or NULL.
+	@param keepViews Whether views of the lines handed out since the stores were
+	last modified may still be in use. Reads keep them: the lines of the viewed pages
+	they evict are only freed by the next trim that does not keep views, after a
+	modification or once the owner of the stores holds no view.
+*/
+void PageCache::trim(const LinePage *pinned, bool keepViews) {
+	list<LinePage*>::iterator i = recent.end();
+
+	if (!keepViews) {
+		vector<vector<string>>().swap(retired);
+		retiredBytes = 0;
+
+		for (list<LinePage*>::iterator j = recent.begin(); j != recent.end(); ++j) {
+			(*j)->viewed = false;
+		}
+	}
+
+	while (residentBytes > memoryLimit && i != recent.begin()) {
+		list<LinePage*>::iterator candidate = prev(i);
+		LinePage *page = *candidate;
+
+		if (page == pinned || !evict(page)) {
+			i = candidate;
+		}
+	}
+}
+
+/**
+	Creates the swap file, a temporary file deleted when it is closed.
+	@returns True if the file could be created.
+*/
+bool PageCache::openSwap() {
+#ifdef _WIN32
+	char directory[MAX_PATH];
+	char path[MAX_PATH];
+
+	if (GetTempPathA(MAX_PATH, directory) == 0 || GetTempFileNameA(directory, "swp", 0, path) == 0) {
+		return false;
+	}
+
+	// 'D' deletes the file once it is closed
+	swap = fopen(path, "w+bD");
+#else
+	swap = tmpfile();
+#endif
+
+	return swap != NULL;
+}
+
+/**
+	Moves to a position of the swap file, which may be past 2 GB.
+	@param offset The position.
+	@returns True if the position could be reached.
+*/
+bool PageCache::seekSwap(long long offset) {
+#ifdef _WIN32
+	return _fseeki64(swap, offset, SEEK_SET) == 0;
+#else
+	return fseeko(swap, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+/**
+	Checks whether the lines of a page were ever written where they can be read
+	back from.
+	@param page The page.
+	@returns True if the page has a copy in the swap file or in packed.
+*/
+bool PageCache::hasCopy(const LinePage *page) {
+	return compress ? !page->packed.empty() : page->swapOffset >= 0;
+}
+
+/**
+	Lays out the lines of a page in a block, each as its length followed by its
+	text.
+	@param page The page.
+	@param block Receives the block; it is cleared first.
+*/
+void PageCache::encode(const LinePage *page, string& block) {
+	block.clear();
+	block.reserve(page->textBytes + page->lines.size() * (sizeof(unsigned int) + 16));
+
+	for (size_t i = 0; i < page->lines.size(); i++) {
+		unsigned int length = (unsigned int)page->lines[i].size();
+
+		block.append((const char*)&length, sizeof(length));
+		block += page->lines[i];
+	}
+}
+
+/**
+	Saves the lines of a page where they can be read back from: compressed into the
+	page, or in the swap file.
+	@param page The page.
+	@returns True if the page was saved.
+*/
+bool PageCache::writeBack(LinePage *page) {
+	string block;
+
+	encode(page, block);
+
+	if (!compress) {
+		return writeSwap(page, block);
+	}
+
+	string packed;
+
+	BlockCodec::compress(block.data(), block.size(), packed);
+	packedBytes = packedBytes - page->packed.size() + packed.size();
+	// copied rather than moved, so that the copy kept is no larger than it needs
+	page->packed.assign(packed.data(), packed.size());
+	page->dirty = false;
+	return true;
+}
+
+/**
+	Writes the block of a page to the swap file. The page is written over its
+	previous copy if it still fits there, and after the end of the file otherwise.
+	@param page The page.
+	@param block The lines of the page, laid out by encode.
+	@returns True if the page was written.
+*/
+bool PageCache::writeSwap(LinePage *page, const string& block) {
+	if (swap == NULL && !openSwap()) {
+		return false;
+	}
+
+	long long offset = page->swapOffset;
+	size_t room = page->swapBytes;
+
+	if (offset < 0 || block.size() > room) {
+		offset = swapEnd;
+		room = block.size();
+	}
+
+	if (!seekSwap(offset) || fwrite(block.data(), 1, block.size(), swap) != block.size()) {
+		return false;
+	}
+
+	if (offset == swapEnd) {
+		if (page->swapOffset >= 0) {
+			swapGarbage += page->swapBytes;
+		}
+		swapEnd += (long long)room;
+	}
+
+	page->swapOffset = offset;
+	page->swapBytes = room;
+	page->dirty = false;
+	return true;
+}
+
+/**
+	Reads the lines of a page back from its compressed copy or from the swap file.
+	@param page The page, which must have been saved there.
+	@param lines Receives the lines; it is cleared first.
+	@returns True if the page was read.
+*/
+bool PageCache::readBack(const LinePage *page, vector<string>& lines) {
+	string block;
+	size_t position = 0;
+
+	lines.clear();
+
+	if (compress) {
+		if (!BlockCodec::decompress(page->packed, block)) {
+			return false;
+		}
+	}
+	else {
+		block.resize(page->swapBytes);
+
+		if (page->swapOffset < 0 || !seekSwap(page->swapOffset)
+			|| fread(&block[0], 1, block.size(), swap) != block.size()) {
+			return false;
+		}
+	}
+
+	lines.reserve(page->numLines);
+
+	for (int i = 0; i < page->numLines; i++) {
+		unsigned int length;
+
+		if (block.size() - position < sizeof(length)) {
+			return false;
+		}
+
+		memcpy(&length, block.data() + position, sizeof(length));
+		position += sizeof(length);
+
+		if (block.size() - position < length) {
+			return false;
+		}
+
+		lines.push_back(block.substr(position, length));
+		position += length;
+	}
+
+	return true;
+}
@@ -0,0 +1,109 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "LineStore.h"
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+	A run of consecutive lines of a PagedLineStore. A page that was loaded from a
+	file and never modified only remembers the text it was split from, and is split
+	again when it is needed; any other page owns copies of its lines, which are
+	written to the swap file, or compressed in memory, when the page is evicted.
+*/
+struct LinePage
+{
+public:
+	LinePage() : numLines(0), source(NULL), sourceBytes(0), swapOffset(-1), swapBytes(0), resident(false),
+		owned(true), dirty(true), viewed(false), textBytes(0), memory(0) {}
+
+	int numLines;
+	// The text of an unmodified page, in memory owned by someone else.
+	const char *source;
+	size_t sourceBytes;
+	// The room the page was given in the swap file, if it was ever written there.
+	long long swapOffset;
+	size_t swapBytes;
+	// The compressed copy of the lines, for caches that keep evicted pages in memory.
+	string packed;
+	bool resident;
+	// Whether the lines are copies in lines, rather than spans of source.
+	bool owned;
+	// Whether lines differ from the copy in the swap file or in packed.
+	bool dirty;
+	// Whether views of lines were handed out since views last expired.
+	bool viewed;
+	vector<LineSpan> spans;
+	vector<string> lines;
+	// The heap memory of the text of lines, beyond the strings themselves.
+	size_t textBytes;
+	// The memory counted against the cache while the page is resident.
+	size_t memory;
+	list<LinePage*>::iterator recent;
+};
+
+/**
+	Keeps the pages of a PagedLineStore and its siblings within a memory budget.
+	Resident pages are kept in least recently used order, and the least recently
+	used ones are evicted when the budget is exceeded: unmodified pages are split
+	again from their source when needed, and modified ones are written to a
+	temporary swap file and read back. A cache may instead keep modified pages
+	compressed in memory, with BlockCodec, in which case the budget only bounds the
+	pages kept decompressed.
+*/
+class PageCache
+{
+private:
+	list<LinePage*> recent;
+	// The lines of pages evicted while views of them may still be in use.
+	vector<vector<string>> retired;
+	size_t retiredBytes;
+	FILE *swap;
+	long long swapEnd;
+	long long swapGarbage;
+	bool compress;
+	size_t memoryLimit;
+	size_t residentBytes;
+	size_t packedBytes;
+	long long pageIns;
+	long long pageOuts;
+
+	static void encode(const LinePage *page, string& block);
+	bool hasCopy(const LinePage *page);
+	bool openSwap();
+	bool seekSwap(long long offset);
+	bool writeBack(LinePage *page);
+	bool writeSwap(LinePage *page, const string& block);
+
+public:
+	// Held by every call of the stores sharing the cache, which may come from
+	// several threads at once.
+	recursive_mutex lock;
+
+	PageCache(size_t memoryLimit, bool compress = false);
+	PageCache(const PageCache&) = delete;
+	PageCache& operator=(const PageCache&) = delete;
+	virtual ~PageCache();
+	size_t getMemoryLimit();
+	size_t getResidentBytes();
+	size_t getRetiredBytes();
+	size_t getPackedBytes();
+	long long getSwapBytes();
+	long long getPageIns();
+	long long getPageOuts();
+	static size_t textMemory(const string& line);
+	void account(LinePage *page);
+	bool evict(LinePage *page);
+	void forget(LinePage *page);
+	void insert(LinePage *page);
+	bool load(LinePage *page);
+	bool readBack(const LinePage *page, vector<string>& lines);
+	void trim(const LinePage *pinned, bool keepViews);
+};
+
+#endif
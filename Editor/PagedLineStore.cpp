@@ -0,0 +1,893 @@
+#include "PagedLineStore.h"
+#include <algorithm>
+#include <iterator>
+
+/**
+	Virtual destructor. Frees the pages, and their room in the swap file.
+*/
+PagedLineStore::~PagedLineStore() {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	for (size_t i = 0; i < pages.size(); i++) {
+		cache->forget(pages[i]);
+		delete pages[i];
+	}
+}
+
+/**
+	Creates an empty store sharing the memory budget and the swap file of this one.
+	@returns The new store; the caller owns it.
+*/
+LineStore* PagedLineStore::createSibling() {
+	return new PagedLineStore(cache);
+}
+
+/**
+	Gets the memory the lines of the store and its siblings take, other than their
+	compressed copies: the resident pages, and the lines of evicted pages kept while
+	views of them may still be in use.
+	@returns The memory, in bytes.
+*/
+size_t PagedLineStore::getResidentBytes() {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	return cache->getResidentBytes() + cache->getRetiredBytes();
+}
+
+/**
+	Finds the page holding a line.
+	@param index The position of the line, which must exist.
+	@returns The position of the page.
+*/
+int PagedLineStore::findPage(int index) {
+	return (int)(upper_bound(starts.begin(), starts.end(), index) - starts.begin()) - 1;
+}
+
+/**
+	Makes a page resident and the most recently used.
+	@param pageIndex The position of the page.
+	@param modifying Whether the caller changes the lines of the page, which makes
+	it own them.
+	@returns The page, or NULL if its lines can't be read back.
+*/
+LinePage* PagedLineStore::acquire(int pageIndex, bool modifying) {
+	LinePage *page = pages[pageIndex];
+
+	if (!cache->load(page)) {
+		lostLines = true;
+		return NULL;
+	}
+
+	if (modifying) {
+		makeOwned(page);
+		page->dirty = true;
+	}
+
+	return page;
+}
+
+/**
+	Adds an empty page, which is not tracked by the cache yet.
+	@param pageIndex The position of the page.
+	@returns The page.
+*/
+LinePage* PagedLineStore::createPage(int pageIndex) {
+	LinePage *page = new LinePage();
+
+	pages.insert(pages.begin() + pageIndex, page);
+	starts.insert(starts.begin() + pageIndex, pageIndex == 0 ? 0 : starts[pageIndex - 1] + pages[pageIndex - 1]->numLines);
+	return page;
+}
+
+/**
+	Checks whether a line loaded from a file directly follows the text of a page,
+	with a line break between the two that splitting the text again restores.
+	@param page A page that does not own its lines.
+	@param text The first character of the line.
+	@returns True if the line can be added to the page.
+*/
+bool PagedLineStore::adjoins(LinePage *page, const char *text) {
+	const char *end = page->source + page->sourceBytes;
+
+	if (text == end + 1) {
+		return end[0] == '\n' && (page->sourceBytes == 0 || end[-1] != '\r');
+	}
+
+	return text == end + 2 && end[0] == '\r' && end[1] == '\n';
+}
+
+/**
+	Gets a line of a resident page.
+	@param page The page.
+	@param offset The position of the line within the page.
+	@returns A view of the line.
+*/
+LineView PagedLineStore::line(LinePage *page, int offset) {
+	if (page->owned) {
+		return page->lines[offset];
+	}
+
+	return LineView(page->spans[offset].text, page->spans[offset].length);
+}
+
+/**
+	Reads the lines of an evicted page that owns them without making it resident,
+	for callers that go through the whole store.
+	@param page The page.
+	@param lines Receives the lines.
+	@returns False if the page is resident, is split from its source or can't be
+	read back, in which case it is acquired instead.
+*/
+bool PagedLineStore::peek(LinePage *page, vector<string>& lines) {
+	if (page->resident || !page->owned) {
+		return false;
+	}
+
+	return cache->readBack(page, lines);
+}
+
+/**
+	Copies the lines of a resident page that still points into its source.
+	@param page The page.
+*/
+void PagedLineStore::makeOwned(LinePage *page) {
+	if (page->owned) {
+		return;
+	}
+
+	page->lines.reserve(page->spans.size());
+
+	for (size_t i = 0; i < page->spans.size(); i++) {
+		page->lines.push_back(string(page->spans[i].text, page->spans[i].length));
+		page->textBytes += PageCache::textMemory(page->lines.back());
+	}
+
+	vector<LineSpan>().swap(page->spans);
+	page->source = NULL;
+	page->sourceBytes = 0;
+	page->owned = true;
+	page->dirty = true;
+	cache->account(page);
+}
+
+/**
+	Recomputes the position of the first line of the pages from a given one on.
+	@param pageIndex The position of the first page to renumber.
+*/
+void PagedLineStore::renumber(int pageIndex) {
+	for (size_t i = max(pageIndex, 0); i < pages.size(); i++) {
+		starts[i] = i == 0 ? 0 : starts[i - 1] + pages[i - 1]->numLines;
+	}
+}
+
+/**
+	Splits a resident page that grew too large into pages of PAGE_LINES lines.
+	@param pageIndex The position of the page.
+*/
+void PagedLineStore::splitPage(int pageIndex) {
+	LinePage *page = pages[pageIndex];
+	int next = pageIndex + 1;
+
+	for (int first = PAGE_LINES; first < page->numLines; first += PAGE_LINES, next++) {
+		int count = min(PAGE_LINES, page->numLines - first);
+		LinePage *added = createPage(next);
+
+		added->lines.assign(make_move_iterator(page->lines.begin() + first),
+			make_move_iterator(page->lines.begin() + first + count));
+		added->numLines = count;
+
+		for (int i = 0; i < count; i++) {
+			added->textBytes += PageCache::textMemory(added->lines[i]);
+		}
+
+		cache->insert(added);
+	}
+
+	page->lines.resize(PAGE_LINES);
+	page->lines.shrink_to_fit();
+	page->numLines = PAGE_LINES;
+	page->textBytes = 0;
+
+	for (int i = 0; i < PAGE_LINES; i++) {
+		page->textBytes += PageCache::textMemory(page->lines[i]);
+	}
+
+	cache->account(page);
+	renumber(pageIndex + 1);
+}
+
+/**
+	Merges a page with its neighbours while they fit in a page together, so that
+	deletions do not leave many small pages behind.
+	@param pageIndex The position of the page.
+*/
+void PagedLineStore::joinPages(int pageIndex) {
+	for (int i = min(pageIndex, (int)pages.size() - 2); i >= max(pageIndex - 1, 0); i--) {
+		if (pages[i]->numLines + pages[i + 1]->numLines > PAGE_LINES) {
+			continue;
+		}
+
+		LinePage *page = acquire(i, true);
+		LinePage *next = acquire(i + 1, true);
+
+		// lines that can't be read back stay on a page of their own
+		if (page == NULL || next == NULL) {
+			continue;
+		}
+
+		page->lines.insert(page->lines.end(), make_move_iterator(next->lines.begin()), make_move_iterator(next->lines.end()));
+		page->numLines += next->numLines;
+		page->textBytes += next->textBytes;
+		cache->account(page);
+		cache->forget(next);
+		delete next;
+		pages.erase(pages.begin() + i + 1);
+		starts.erase(starts.begin() + i + 1);
+	}
+}
+
+/**
+	Appends a line, to the last page if it owns its lines, has room and can be read
+	back.
+	@param text The line, which the store takes.
+*/
+void PagedLineStore::append(string& text) {
+	LinePage *page = NULL;
+
+	if (!pages.empty() && pages.back()->owned && pages.back()->numLines < PAGE_LINES) {
+		page = acquire((int)pages.size() - 1, true);
+	}
+
+	if (page == NULL) {
+		page = createPage((int)pages.size());
+		cache->insert(page);
+	}
+
+	page->textBytes += PageCache::textMemory(text);
+	page->lines.push_back(move(text));
+	page->numLines++;
+	page->dirty = true;
+	numLines++;
+	cache->account(page);
+}
+
+/**
+	Inserts copies of a sequence of lines. The lines are copied before the store is
+	changed, since they may be views of its own lines. Nothing is inserted into a
+	page that can't be read back.
+	@param index The position of the first new line. Out of range positions append
+	the lines.
+	@param lines The lines, in order.
+*/
+void PagedLineStore::insertLines(int index, const vector<LineView>& lines) {
+	vector<string> copies;
+	size_t textBytes = 0;
+
+	copies.reserve(lines.size());
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		copies.push_back(lines[i].str());
+		textBytes += PageCache::textMemory(copies.back());
+	}
+
+	if (index < 0 || index >= numLines) {
+		for (size_t i = 0; i < copies.size(); i++) {
+			append(copies[i]);
+		}
+		return;
+	}
+
+	int pageIndex = findPage(index);
+	LinePage *page = acquire(pageIndex, true);
+
+	if (page == NULL) {
+		return;
+	}
+
+	page->lines.insert(page->lines.begin() + (index - starts[pageIndex]),
+		make_move_iterator(copies.begin()), make_move_iterator(copies.end()));
+	page->numLines += (int)copies.size();
+	page->textBytes += textBytes;
+	numLines += (int)copies.size();
+	cache->account(page);
+	renumber(pageIndex + 1);
+
+	if (page->numLines > 2 * PAGE_LINES) {
+		splitPage(pageIndex);
+	}
+}
+
+/**
+	Removes part of the lines of a page, which must keep at least one and must be
+	readable.
+	@param pageIndex The position of the page.
+	@param from The position of the first line to remove, within the page.
+	@param to The position after the last line to remove, within the page.
+*/
+void PagedLineStore::eraseLines(int pageIndex, int from, int to) {
+	LinePage *page = acquire(pageIndex, true);
+
+	for (int i = from; i < to; i++) {
+		page->textBytes -= PageCache::textMemory(page->lines[i]);
+	}
+
+	page->lines.erase(page->lines.begin() + from, page->lines.begin() + to);
+	page->numLines -= to - from;
+	cache->account(page);
+}
+
+/**
+	Removes a range of lines. Pages entirely in the range are dropped without being
+	loaded; only the pages at either end of the range are changed, and nothing is
+	removed if either of them can't be read back.
+	@param start The position of the first line to remove. Out of range positions
+	remove nothing.
+	@param numItems The number of lines to remove.
+*/
+void PagedLineStore::removeLines(int start, int numItems) {
+	if (start < 0 || start >= numLines || numItems <= 0) {
+		return;
+	}
+
+	numItems = min(numItems, numLines - start);
+
+	int first = findPage(start);
+	int last = findPage(start + numItems - 1);
+	int from = start - starts[first];
+	int to = start + numItems - starts[last];
+	int dropFrom = first;
+	int dropTo = last + 1;
+	bool keepsFirst = from > 0 || (first == last && to < pages[first]->numLines);
+	bool keepsLast = first != last && to < pages[last]->numLines;
+
+	if ((keepsFirst && acquire(first, true) == NULL) || (keepsLast && acquire(last, true) == NULL)) {
+		return;
+	}
+
+	if (first == last) {
+		if (from > 0 || to < pages[first]->numLines) {
+			eraseLines(first, from, to);
+			dropTo = first;
+		}
+	}
+	else {
+		if (from > 0) {
+			eraseLines(first, from, pages[first]->numLines);
+			dropFrom = first + 1;
+		}
+		if (to < pages[last]->numLines) {
+			eraseLines(last, 0, to);
+			dropTo = last;
+		}
+	}
+
+	for (int i = dropFrom; i < dropTo; i++) {
+		cache->forget(pages[i]);
+		delete pages[i];
+	}
+
+	pages.erase(pages.begin() + dropFrom, pages.begin() + max(dropFrom, dropTo));
+	starts.erase(starts.begin() + dropFrom, starts.begin() + max(dropFrom, dropTo));
+	numLines -= numItems;
+	renumber(first);
+
+	if (!pages.empty()) {
+		joinPages(min(first, (int)pages.size() - 1));
+		renumber(first - 1);
+	}
+}
+
+/**
+	Finds the first line equal to a value.
+	@param value The value to look for.
+	@returns The position of the line, or -1 if there is none.
+*/
+int PagedLineStore::indexOf(LineView value) {
+	vector<string> lines;
+
+	for (size_t i = 0; i < pages.size(); i++) {
+		if (peek(pages[i], lines)) {
+			for (size_t j = 0; j < lines.size(); j++) {
+				if (lines[j] == value) {
+					return starts[i] + (int)j;
+				}
+			}
+			continue;
+		}
+
+		LinePage *page = acquire((int)i, false);
+
+		if (page == NULL) {
+			continue;
+		}
+
+		for (int j = 0; j < page->numLines; j++) {
+			if (line(page, j) == value) {
+				return starts[i] + j;
+			}
+		}
+
+		cache->trim(page, true);
+	}
+
+	return -1;
+}
+
+/**
+	Gets the number of lines in the store.
+	@returns The number of lines.
+*/
+int PagedLineStore::size() {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	return numLines;
+}
+
+/**
+	Gets a copy of a line.
+	@param index The position of the line.
+	@returns The line, or an empty string if the position is out of range or the
+	line can't be read back.
+*/
+string PagedLineStore::get(int index) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	if (index < 0 || index >= numLines) {
+		return string();
+	}
+
+	int pageIndex = findPage(index);
+	LinePage *page = acquire(pageIndex, false);
+
+	if (page == NULL) {
+		return string();
+	}
+
+	string text = line(page, index - starts[pageIndex]).str();
+
+	cache->trim(page, true);
+	return text;
+}
+
+/**
+	Gets a line without copying it, loading its page if needed.
+	@param index The position of the line.
+	@returns A view of the line, empty if the position is out of range or the line
+	can't be read back.
+*/
+LineView PagedLineStore::getView(int index) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	if (index < 0 || index >= numLines) {
+		return LineView();
+	}
+
+	int pageIndex = findPage(index);
+	LinePage *page = acquire(pageIndex, false);
+
+	if (page == NULL) {
+		return LineView();
+	}
+
+	LineView view = line(page, index - starts[pageIndex]);
+
+	if (page->owned) {
+		page->viewed = true;
+	}
+
+	cache->trim(page, true);
+	return view;
+}
+
+/**
+	Gets a window of consecutive lines.
+	@param start The position of the first line of the window.
+	@param numItems The maximum number of lines to get.
+	@param lines Receives the lines; it is cleared first.
+*/
+void PagedLineStore::getRange(int start, int numItems, vector<string>& lines) {
+	lines.clear();
+	visit(start, numItems, [&lines](int, LineView line) {
+		lines.push_back(line.str());
+		return true;
+	});
+}
+
+/**
+	Gets a window of consecutive lines without copying them.
+	@param start The position of the first line of the window.
+	@param numItems The maximum number of lines to get.
+	@param spans Receives the lines; it is cleared first.
+*/
+void PagedLineStore::getSpans(int start, int numItems, vector<LineSpan>& spans) {
+	spans.clear();
+	walk(start, numItems, true, [&spans](int, LineView line) {
+		LineSpan span = { line.data(), line.size() };
+
+		spans.push_back(span);
+		return true;
+	});
+}
+
+/**
+	Gets a window of consecutive lines without copying them.
+	@param start The position of the first line of the window.
+	@param numItems The maximum number of lines to get.
+	@param views Receives the lines, valid until the store is next modified or
+	expireViews is called; it is cleared first.
+*/
+void PagedLineStore::getViews(int start, int numItems, vector<LineView>& views) {
+	views.clear();
+	walk(start, numItems, true, [&views](int, LineView line) {
+		views.push_back(line);
+		return true;
+	});
+}
+
+/**
+	Calls a visitor on consecutive lines, a page at a time. Pages are evicted as
+	the visit goes on, so the views handed to the visitor only last until it
+	returns.
+	@param start The position of the first line to visit.
+	@param numItems The maximum number of lines to visit.
+	@param visitor The visitor, which may stop the visit by returning false.
+*/
+void PagedLineStore::visit(int start, int numItems, const LineVisitor& visitor) {
+	walk(start, numItems, false, visitor);
+}
+
+/**
+	Calls a visitor on consecutive lines, a page at a time, evicting pages as the
+	budget requires. Lines that can't be read back are visited as empty lines.
+	@param start The position of the first line to visit.
+	@param numItems The maximum number of lines to visit.
+	@param keepViews Whether the visitor keeps views of the lines, in which case the
+	lines of the pages it saw are kept until views expire if they are evicted.
+	@param visitor The visitor, which may stop the visit by returning false.
+*/
+void PagedLineStore::walk(int start, int numItems, bool keepViews, const LineVisitor& visitor) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	int index = start < 0 ? 0 : start;
+	int end = index + min(numItems, numLines - index);
+
+	while (index < end) {
+		int pageIndex = findPage(index);
+		LinePage *page = acquire(pageIndex, false);
+		int last = min(end, starts[pageIndex] + pages[pageIndex]->numLines);
+
+		if (page == NULL) {
+			for (; index < last; index++) {
+				if (!visitor(index, LineView())) {
+					return;
+				}
+			}
+			continue;
+		}
+
+		if (keepViews && page->owned) {
+			page->viewed = true;
+		}
+
+		for (; index < last; index++) {
+			if (!visitor(index, line(page, index - starts[pageIndex]))) {
+				cache->trim(page, true);
+				return;
+			}
+		}
+
+		cache->trim(page, true);
+	}
+}
+
+/**
+	Appends a new line at the end of the store.
+	@param data The data that will be appended.
+*/
+void PagedLineStore::add(LineView data) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	string text = data.str();
+
+	append(text);
+	cache->trim(pages.back(), false);
+}
+
+/**
+	Appends a line that points into memory owned by the caller. Lines that follow
+	each other in that memory share a page, which only remembers where its text
+	starts and ends while it is not modified. The memory must stay valid until
+	releaseViews is called or the store is destroyed.
+	@param text The first character of the line.
+	@param length The number of characters in the line.
+*/
+void PagedLineStore::addView(const char *text, size_t length) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	LinePage *page = pages.empty() ? NULL : pages.back();
+
+	if (page == NULL || page->owned || page->numLines >= PAGE_LINES || !adjoins(page, text)) {
+		page = createPage((int)pages.size());
+		page->owned = false;
+		page->dirty = false;
+		page->source = text;
+		cache->insert(page);
+	}
+
+	if (page->resident) {
+		LineSpan span = { text, length };
+
+		page->spans.push_back(span);
+		cache->account(page);
+	}
+
+	page->sourceBytes = text + length - page->source;
+	page->numLines++;
+	numLines++;
+	cache->trim(page, false);
+}
+
+/**
+	Copies a block of lines into a new store, a page at a time, so that the lines
+	read from evicted pages don't pile up while the block is copied.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns A sibling of this store holding copies of the lines, which is broken if
+	this store lost lines; the caller owns it.
+*/
+LineStore* PagedLineStore::copy(int start, int numItems) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	PagedLineStore *block = new PagedLineStore(cache);
+	vector<LineView> views;
+	int first = max(start, 0);
+	int end = first + min(numItems, numLines - first);
+
+	for (; first < end; first += PAGE_LINES) {
+		getViews(first, min(PAGE_LINES, end - first), views);
+		// the block copies the lines, and expires the views as it is modified
+		block->insertRange(block->size(), views);
+	}
+
+	block->lostLines = lostLines;
+	return block;
+}
+
+/**
+	Moves every line of a block into the store, a page at a time, leaving the block
+	empty. A block that lost lines breaks the store.
+	@param index The position of the first line of the block once moved. Out of range
+	positions append the block.
+	@param block The lines to move; must be another store.
+*/
+void PagedLineStore::paste(int index, LineStore& block) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	vector<LineView> views;
+
+	if (&block == this) {
+		return;
+	}
+
+	if (index < 0 || index > numLines) {
+		index = numLines;
+	}
+
+	for (int first = 0; first < block.size(); first += PAGE_LINES) {
+		block.getViews(first, PAGE_LINES, views);
+		insertLines(index + first, views);
+		cache->trim(NULL, false);
+	}
+
+	lostLines = lostLines || !block.isIntact();
+	block.deleteRange(0, block.size());
+}
+
+/**
+	Deletes a line.
+	@param index The position of the line.
+*/
+void PagedLineStore::deleteNode(int index) {
+	deleteRange(index, 1);
+}
+
+/**
+	Deletes a range of consecutive lines.
+	@param start The position of the first line to delete. Out of range positions
+	delete nothing.
+	@param numItems The number of lines to delete.
+*/
+void PagedLineStore::deleteRange(int start, int numItems) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	removeLines(start, numItems);
+	cache->trim(NULL, false);
+}
+
+/**
+	Deletes the first line equal to a value.
+	@param value The value to look for.
+*/
+void PagedLineStore::deleteValue(LineView value) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	removeLines(indexOf(value), 1);
+	cache->trim(NULL, false);
+}
+
+/**
+	Inserts a line after the first line equal to a value, or at the end of the store
+	if there is none.
+	@param value The value to look for.
+	@param data The data to insert.
+*/
+void PagedLineStore::insertAfterValue(LineView value, LineView data) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	int index = indexOf(value);
+
+	insertLines(index < 0 ? numLines : index + 1, vector<LineView>(1, data));
+	cache->trim(NULL, false);
+}
+
+/**
+	Inserts a new line at the position specified by the index parameter. Out of
+	range positions append the line.
+	@param index The position to insert the new line at.
+	@param data The data to insert.
+*/
+void PagedLineStore::insertAt(int index, LineView data) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	insertLines(index, vector<LineView>(1, data));
+	cache->trim(NULL, false);
+}
+
+/**
+	Inserts a sequence of lines into the page holding the position, which is split
+	if it grows too large.
+	@param index The position of the first new line. Out of range positions append
+	the lines.
+	@param lines The lines, in order.
+*/
+void PagedLineStore::insertRange(int index, const vector<LineView>& lines) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	insertLines(index, lines);
+	cache->trim(NULL, false);
+}
+
+/**
+	Checks that every page could be read back whenever it was needed. A store that
+	failed to read a page once stays broken, since the changes made to the page
+	while it could not be read were dropped.
+	@returns True if no line was lost.
+*/
+bool PagedLineStore::isIntact() {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	return !lostLines;
+}
+
+/**
+	Copies every line that still points into its source. Pages are copied one at a
+	time and may be written to the swap file as the budget requires.
+*/
+void PagedLineStore::releaseViews() {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	for (size_t i = 0; i < pages.size(); i++) {
+		if (!pages[i]->owned) {
+			cache->trim(acquire((int)i, true), false);
+		}
+	}
+}
+
+/**
+	Captures the current lines. Lines of unmodified pages are referenced in their
+	source; other lines are copied, from the swap file or their compressed copy for
+	evicted pages, which stay evicted. Lines that can't be read back are left out,
+	and the store is then no longer intact.
+	@param snapshot Receives the lines; it is cleared first.
+*/
+void PagedLineStore::snapshot(LineSnapshot& snapshot) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	vector<string> lines;
+
+	snapshot.clear();
+	snapshot.lines.reserve(numLines);
+
+	for (size_t i = 0; i < pages.size(); i++) {
+		LinePage *page = pages[i];
+
+		if (peek(page, lines)) {
+			for (size_t j = 0; j < lines.size(); j++) {
+				snapshot.addCopy(lines[j]);
+			}
+			continue;
+		}
+
+		if (acquire((int)i, false) == NULL) {
+			continue;
+		}
+
+		for (int j = 0; j < page->numLines; j++) {
+			LineView view = line(page, j);
+
+			if (page->owned) {
+				snapshot.addCopy(view.data(), view.size());
+			}
+			else {
+				snapshot.addView(view.data(), view.size());
+			}
+		}
+
+		cache->trim(page, true);
+	}
+}
+
+/**
+	Writes the lines separated by line breaks, a page at a time. Evicted pages are
+	read without being made resident. Writing stops at the first page that can't be
+	read back, and the store is then no longer intact.
+	@param output The stream to write to.
+*/
+void PagedLineStore::write(ostream& output) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+	vector<string> lines;
+
+	for (size_t i = 0; i < pages.size(); i++) {
+		bool peeked = peek(pages[i], lines);
+		LinePage *page = peeked ? pages[i] : acquire((int)i, false);
+
+		if (page == NULL) {
+			return;
+		}
+
+		for (int j = 0; j < page->numLines; j++) {
+			LineView view = peeked ? LineView(lines[j]) : line(page, j);
+
+			if (i > 0 || j > 0) {
+				output << '\n';
+			}
+			output.write(view.data(), view.size());
+		}
+
+		if (!peeked) {
+			cache->trim(page, true);
+		}
+	}
+}
+
+/**
+	Frees the lines of the pages evicted while views of them could still be in use,
+	and evicts pages as the budget requires.
+*/
+void PagedLineStore::expireViews() {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	cache->trim(NULL, false);
+}
+
+/**
+	Replaces the value of a line. Out of range positions, and lines that can't be
+	read back, change nothing.
+	@param index The position of the line.
+	@param value The new value.
+*/
+void PagedLineStore::updateValue(int index, LineView value) {
+	lock_guard<recursive_mutex> guard(cache->lock);
+
+	if (index < 0 || index >= numLines) {
+		return;
+	}
+
+	string text = value.str();
+	int pageIndex = findPage(index);
+	LinePage *page = acquire(pageIndex, true);
+
+	if (page == NULL) {
+		return;
+	}
+	string& line = page->lines[index - starts[pageIndex]];
+
+	page->textBytes -= PageCache::textMemory(line);
+	line = move(text);
+	page->textBytes += PageCache::textMemory(line);
+	cache->account(page);
+	cache->trim(page, false);
+}
@@ -0,0 +1,93 @@
+#ifndef PAGEDLINESTORE_H
+#define PAGEDLINESTORE_H
+
+#include "LineStore.h"
+#include "PageCache.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The number of lines pages are filled with. A page may grow to twice as many
+// through insertions before it is split.
+const int PAGE_LINES = 4096;
+
+/**
+	A line store that keeps only part of its lines in memory. Lines are grouped in
+	pages, and a PageCache shared with the siblings of the store evicts the least
+	recently used pages once their memory exceeds a budget: pages loaded from a file
+	and never modified are split again from the file when needed, and others are
+	written to a swap file, or compressed in memory. Reads evict pages too; the lines
+	of evicted pages that views were handed out of are kept until expireViews is
+	called or the store is modified, since the views may still be in use, so callers
+	that read the whole store a window at a time expire views between windows. The
+	pages are found by binary search over the position of their first line.
+*/
+class PagedLineStore : public LineStore
+{
+private:
+	vector<LinePage*> pages;
+	// The position of the first line of each page.
+	vector<int> starts;
+	int numLines;
+	// Whether lines could not be read back, so that reads and changes missed them.
+	bool lostLines;
+	// Shared with the siblings of the store.
+	shared_ptr<PageCache> cache;
+
+	explicit PagedLineStore(shared_ptr<PageCache> cache) : numLines(0), lostLines(false), cache(cache) {}
+
+	LinePage* acquire(int pageIndex, bool modifying);
+	LinePage* createPage(int pageIndex);
+	bool adjoins(LinePage *page, const char *text);
+	int findPage(int index);
+	int indexOf(LineView value);
+	LineView line(LinePage *page, int offset);
+	void append(string& text);
+	void eraseLines(int pageIndex, int from, int to);
+	void insertLines(int index, const vector<LineView>& lines);
+	void joinPages(int pageIndex);
+	void makeOwned(LinePage *page);
+	bool peek(LinePage *page, vector<string>& lines);
+	void removeLines(int start, int numItems);
+	void renumber(int pageIndex);
+	void splitPage(int pageIndex);
+	void walk(int start, int numItems, bool keepViews, const LineVisitor& visitor);
+
+protected:
+	void write(ostream& output);
+
+public:
+	explicit PagedLineStore(size_t memoryLimit = DEFAULT_PAGE_MEMORY, bool compress = false) :
+		PagedLineStore(make_shared<PageCache>(memoryLimit, compress)) {}
+	PagedLineStore(const PagedLineStore&) = delete;
+	PagedLineStore& operator=(const PagedLineStore&) = delete;
+	virtual ~PagedLineStore();
+	LineStore* createSibling();
+	size_t getResidentBytes();
+	int size();
+	string get(int index);
+	void getRange(int start, int numItems, vector<string>& lines);
+	void getSpans(int start, int numItems, vector<LineSpan>& spans);
+	LineView getView(int index);
+	void getViews(int start, int numItems, vector<LineView>& views);
+	void visit(int start, int numItems, const LineVisitor& visitor);
+	void add(LineView data);
+	void addView(const char *text, size_t length);
+	LineStore* copy(int start, int numItems);
+	void deleteNode(int index);
+	void deleteRange(int start, int numItems);
+	void deleteValue(LineView value);
+	void expireViews();
+	void insertAfterValue(LineView value, LineView data);
+	void insertAt(int index, LineView data);
+	void insertRange(int index, const vector<LineView>& lines);
+	bool isIntact();
+	void paste(int index, LineStore& block);
+	void releaseViews();
+	void snapshot(LineSnapshot& snapshot);
+	void updateValue(int index, LineView value);
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include "Editor.h"
+#include "Journal.h"
+#include <cctype>
 #include <conio.h>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -44,25 +47,149 @@ bool isValidFileName(string filePath) {
 	return true;
 }
 
+/**
+	Parses a memory size given on the command line.
+	@param text A number of megabytes, or a number followed by K, M or G.
+	@param bytes Receives the size in bytes when the text is valid.
+	@returns True if the size was recognized, false otherwise.
+*/
+bool parseMemorySize(string text, size_t& bytes) {
+	istringstream input(text);
+	unsigned long long value;
+	char unit = 'M';
+
+	if (!(input >> value) || value == 0 || (input >> unit && input.peek() != EOF)) {
+		return false;
+	}
+
+	switch (toupper(unit)) {
+	case 'K':
+		bytes = (size_t)(value << 10);
+		return true;
+	case 'M':
+		bytes = (size_t)(value << 20);
+		return true;
+	case 'G':
+		bytes = (size_t)(value << 30);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+	Prints the command line usage information.
+*/
+void printUsage() {
+	cout << endl << " Insufficient parameters." << endl << endl;
+	cout << " USAGE: " << endl << endl;
+	cout << " \tEditor.exe [options] [input file path] [output file path]" << endl << endl;
+	cout << " OPTIONS: " << endl << endl;
+	cout << " \t--store=rope|list|paged|compressed" << endl;
+	cout << " \t                   Line container used for the buffer (default: rope)." << endl;
+	cout << " \t--mem-limit=<size> Memory the lines of a paged buffer, or the decompressed" << endl;
+	cout << " \t                   lines of a compressed one, may take before the least" << endl;
+	cout << " \t                   recently used pages are evicted, in MB, or with a K, M" << endl;
+	cout << " \t                   or G suffix (default: 256M paged, 16M compressed)." << endl;
+	cout << " \t--load=mmap|stream How the input file is read (default: mmap)." << endl;
+	cout << " \t--batch=<script>   Applies the commands in <script> (or stdin for '-')" << endl;
+	cout << " \t                   without drawing, then writes the output file ('-'" << endl;
+	cout << " \t                   for stdout). Text for I, S and F goes on the next line." << endl;
+	cout << " \t--recover          Lets --batch replay the changes an unfinished session" << endl;
+	cout << " \t                   left in a file's journal; files with such changes are" << endl;
+	cout << " \t                   refused without it." << endl;
+	cout << " \t--stats=<file>     Writes the command statistics shown by Z to <file> on exit." << endl;
+}
+
 int main(int argc, char* argv[]) {
+	StoreType storeType = ROPE_STORE;
+	LoadMode loadMode = MAPPED_LOAD;
+	size_t memoryLimit = 0;
+	string scriptPath;
+	string statsPath;
+	bool recover = false;
+	string paths[2];
+	int numPaths = 0;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+
+		if (arg.compare(0, 8, "--store=") == 0) {
+			if (!LineStore::parseStoreType(arg.substr(8), storeType)) {
+				cout << endl << "Unknown store type : \'" << arg.substr(8) << "\'" << endl;
+				return 0;
+			}
+		}
+		else if (arg.compare(0, 12, "--mem-limit=") == 0) {
+			if (!parseMemorySize(arg.substr(12), memoryLimit)) {
+				cout << endl << "Invalid memory limit : \'" << arg.substr(12) << "\'" << endl;
+				return 0;
+			}
+		}
+		else if (arg.compare(0, 8, "--batch=") == 0) {
+			scriptPath = arg.substr(8);
+		}
+		else if (arg == "--recover") {
+			recover = true;
+		}
+		else if (arg.compare(0, 8, "--stats=") == 0) {
+			statsPath = arg.substr(8);
+		}
+		else if (arg == "--load=mmap") {
+			loadMode = MAPPED_LOAD;
+		}
+		else if (arg == "--load=stream") {
+			loadMode = STREAM_LOAD;
+		}
+		else if (numPaths < 2) {
+			paths[numPaths++] = arg;
+		}
+		else {
+			numPaths++;
+		}
+	}
 
-	// Check we're getting three parameters (counting the executable name)
-	if (argc == 3) {
-		if (!isValidFileName(argv[1]) 
-			|| !isValidFileName(argv[2])) {
+	// Check we're getting both file paths
+	if (numPaths == 2) {
+		if (!isValidFileName(paths[0])
+			|| !isValidFileName(paths[1])) {
 			cout << endl << "Invalid input or output file paths. Try again." << endl;
 			return 0;
 		}
 	}
 	else {
-		cout << endl << " Insufficient parameters." << endl << endl;
-		cout << " USAGE: " << endl << endl;
-		cout << " \tEditor.exe [input file path] [output file path]" << endl;
-
+		printUsage();
 		return 0;
 	}
 
-	Editor editor(argv[1], argv[2]);
+	// a script was written for the file as it is on disk, not for unsaved changes
+	if (!scriptPath.empty() && !recover && Journal::hasChanges(paths[0])) {
+		cerr << "The journal of \'" << paths[0] << "\' holds changes of a session that did not end normally;"
+			<< " open it without --batch, or pass --recover to replay them first" << endl;
+		return 1;
+	}
+
+	Editor editor(paths[0], paths[1], storeType, loadMode, memoryLimit);
+
+	editor.setStatsPath(statsPath);
+	editor.setBatchRecovery(recover);
+
+	if (!scriptPath.empty()) {
+		ifstream file;
+
+		if (scriptPath == "-") {
+			return editor.runScript(cin) == 0 ? 0 : 1;
+		}
+
+		file.open(scriptPath);
+		if (!file.is_open()) {
+			cerr << "Could not open script : \'" << scriptPath << "\'" << endl;
+			return 1;
+		}
+
+		return editor.runScript(file) == 0 ? 0 : 1;
+	}
+
 	editor.displayBuffer();
 
 	string cmd;
@@ -0,0 +1,22 @@
+#ifndef ROPENODE_H
+#define ROPENODE_H
+
+#include "CompactLine.h"
+
+using namespace std;
+
+struct RopeNode
+{
+public:
+	RopeNode() : left(NULL), right(NULL), priority(0), count(1) {}
+
+	// Its text is stored in the rope's arena, or is an unmodified slice of the
+	// loaded file.
+	CompactLine line;
+	RopeNode *left;
+	RopeNode *right;
+	unsigned int priority;
+	int count;
+};
+
+#endif // !ROPENODE_H
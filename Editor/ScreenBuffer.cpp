@@ -0,0 +1,286 @@
+#include "ScreenBuffer.h"
+#include <algorithm>
+#include <cstdio>
+
+// Unchanged cells between two changed ones are re-sent instead of moving the
+// cursor when the gap is shorter than this; a cursor move costs about as much.
+const int MAX_SKIPPED_CELLS = 6;
+
+/**
+	Resizes the frame. A resize invalidates what is on screen, so the next render
+	repaints everything.
+	@param width The number of columns.
+	@param height The number of rows.
+*/
+void ScreenBuffer::resize(int width, int height) {
+	if (width < 0) {
+		width = 0;
+	}
+	if (height < 0) {
+		height = 0;
+	}
+
+	if (width != this->width || height != this->height) {
+		this->width = width;
+		this->height = height;
+		frame.assign(width * height, ScreenCell());
+		shown.assign(width * height, ScreenCell());
+		dirtyRows.assign(height, false);
+		isInvalid = true;
+	}
+}
+
+/**
+	Gets the number of columns of the frame.
+	@returns The width of the frame.
+*/
+int ScreenBuffer::getWidth() {
+	return width;
+}
+
+/**
+	Gets the number of rows of the frame.
+	@returns The height of the frame.
+*/
+int ScreenBuffer::getHeight() {
+	return height;
+}
+
+/**
+	Blanks the frame being composed. What is on screen is not affected until the
+	next render.
+*/
+void ScreenBuffer::clear() {
+	frame.assign(width * height, ScreenCell());
+}
+
+/**
+	Forces the next render to repaint the whole screen, for when something other
+	than this buffer has written to the console.
+*/
+void ScreenBuffer::invalidate() {
+	isInvalid = true;
+}
+
+/**
+	Forces the next render to repaint one row, for when the row was overwritten by
+	something else, such as echoed keyboard input.
+	@param y The row to repaint.
+*/
+void ScreenBuffer::invalidateRow(int y) {
+	if (y >= 0 && y < height) {
+		dirtyRows[y] = true;
+	}
+}
+
+/**
+	Sets where the console cursor is left after the frame is rendered.
+	@param x The column of the cursor.
+	@param y The row of the cursor.
+*/
+void ScreenBuffer::setCursor(int x, int y) {
+	cursorX = x;
+	cursorY = y;
+}
+
+/**
+	Writes text into the frame, clipped to the frame's width. Tabs are expanded to
+	the next multiple of eight columns and other control characters are replaced,
+	so that every byte occupies exactly one cell.
+	@param x The column of the first character.
+	@param y The row to write to.
+	@param text The characters to write.
+	@param length The number of characters in text.
+	@param color The console attribute of the text.
+	@returns The column following the last character written.
+*/
+int ScreenBuffer::write(int x, int y, const char *text, size_t length, int color) {
+	if (y < 0 || y >= height || width == 0) {
+		return x;
+	}
+
+	ScreenCell *row = &frame[y * width];
+
+	for (size_t i = 0; i < length && x < width; i++) {
+		char c = text[i];
+
+		if (c == '\t') {
+			do {
+				if (x >= 0) {
+					row[x] = ScreenCell(' ', (unsigned char)color);
+				}
+				x++;
+			} while (x % 8 != 0 && x < width);
+			continue;
+		}
+
+		if ((unsigned char)c < 0x20 || c == 0x7F) {
+			c = '?';
+		}
+
+		if (x >= 0) {
+			row[x] = ScreenCell(c, (unsigned char)color);
+		}
+		x++;
+	}
+
+	return x;
+}
+
+/**
+	Writes text into the frame, clipped to the frame's width.
+	@param x The column of the first character.
+	@param y The row to write to.
+	@param text The text to write.
+	@param color The console attribute of the text.
+	@returns The column following the last character written.
+*/
+int ScreenBuffer::write(int x, int y, const string& text, int color) {
+	return write(x, y, text.data(), text.size(), color);
+}
+
+/**
+	Fills part of a row with a single character.
+	@param x The first column to fill.
+	@param y The row to fill.
+	@param count The number of cells to fill.
+	@param character The character to fill with.
+	@param color The console attribute of the cells.
+*/
+void ScreenBuffer::fill(int x, int y, int count, char character, int color) {
+	if (y < 0 || y >= height) {
+		return;
+	}
+
+	for (int i = max(x, 0); i < x + count && i < width; i++) {
+		frame[y * width + i] = ScreenCell(character, (unsigned char)color);
+	}
+}
+
+/**
+	Checks if a cell of the composed frame differs from what is on screen.
+	@param row The row of the cell.
+	@param column The column of the cell.
+	@returns True if the cell has to be redrawn.
+*/
+bool ScreenBuffer::differs(int row, int column) {
+	ScreenCell& a = frame[row * width + column];
+	ScreenCell& b = shown[row * width + column];
+
+	return a.character != b.character || a.color != b.color;
+}
+
+/**
+	Checks if a row holds bytes outside of ASCII. Multi-byte characters don't map
+	one to one onto cells, so such rows are always redrawn from their first column.
+	@param row The row to check.
+	@returns True if the row holds non-ASCII bytes, on screen or in the new frame.
+*/
+bool ScreenBuffer::hasExtendedCharacters(int row) {
+	for (int i = 0; i < width; i++) {
+		if ((unsigned char)frame[row * width + i].character >= 0x80
+			|| (unsigned char)shown[row * width + i].character >= 0x80) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+	Appends a cursor positioning sequence to the output.
+	@param x The zero based column.
+	@param y The zero based row.
+*/
+void ScreenBuffer::appendCursor(int x, int y) {
+	char sequence[32];
+	int length = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", y + 1, x + 1);
+	output.append(sequence, length);
+}
+
+/**
+	Appends a color selection sequence to the output. Console attributes keep the
+	foreground in the low nibble and the background in the high nibble, with the
+	bits in blue, green, red, intensity order; ANSI colors use red, green, blue.
+	@param color The console attribute to select.
+*/
+void ScreenBuffer::appendColor(int color) {
+	int foreground = color & 0x0F;
+	int background = (color >> 4) & 0x0F;
+	int fgCode = ((foreground & 1) << 2 | (foreground & 2) | (foreground & 4) >> 2)
+		+ ((foreground & 8) ? 90 : 30);
+	int bgCode = ((background & 1) << 2 | (background & 2) | (background & 4) >> 2)
+		+ ((background & 8) ? 100 : 40);
+	char sequence[32];
+	int length = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dm", fgCode, bgCode);
+	output.append(sequence, length);
+}
+
+/**
+	Compares the composed frame with what is on screen and builds the escape
+	sequences that bring the screen up to date. Only changed cells are sent; the
+	composed frame then becomes the frame on screen.
+	@returns The bytes to write to the console in a single write.
+*/
+const string& ScreenBuffer::render() {
+	int color = -1;
+
+	output.clear();
+
+	if (isInvalid) {
+		output.append("\x1b[0m\x1b[2J");
+	}
+
+	for (int y = 0; y < height; y++) {
+		bool wholeRow = isInvalid || dirtyRows[y] || hasExtendedCharacters(y);
+		int x = 0;
+
+		while (x < width) {
+			if (!wholeRow && !differs(y, x)) {
+				x++;
+				continue;
+			}
+
+			// found a changed cell: send it and every cell up to the end of the run
+			int end = wholeRow ? width : x + 1;
+
+			while (end < width) {
+				int next = end;
+
+				while (next < width && next - end <= MAX_SKIPPED_CELLS && !differs(y, next)) {
+					next++;
+				}
+
+				if (next >= width || next - end > MAX_SKIPPED_CELLS) {
+					break;
+				}
+				end = next + 1;
+			}
+
+			appendCursor(x, y);
+
+			for (; x < end; x++) {
+				ScreenCell& cell = frame[y * width + x];
+
+				if (cell.color != color) {
+					color = cell.color;
+					appendColor(color);
+				}
+				output += cell.character;
+			}
+		}
+
+		dirtyRows[y] = false;
+	}
+
+	if (color != -1 || isInvalid) {
+		output.append("\x1b[0m");
+	}
+
+	appendCursor(cursorX, cursorY);
+
+	shown = frame;
+	isInvalid = false;
+
+	return output;
+}
@@ -0,0 +1,52 @@
+#ifndef SCREENBUFFER_H
+#define SCREENBUFFER_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct ScreenCell
+{
+public:
+	ScreenCell() : character(' '), color(15) {}
+	ScreenCell(char character, unsigned char color) : character(character), color(color) {}
+
+	char character;
+	unsigned char color;
+};
+
+class ScreenBuffer
+{
+private:
+	int width;
+	int height;
+	int cursorX;
+	int cursorY;
+	bool isInvalid;
+	vector<ScreenCell> frame;
+	vector<ScreenCell> shown;
+	vector<bool> dirtyRows;
+	string output;
+
+	bool differs(int row, int column);
+	bool hasExtendedCharacters(int row);
+	void appendColor(int color);
+	void appendCursor(int x, int y);
+
+public:
+	ScreenBuffer() : width(0), height(0), cursorX(0), cursorY(0), isInvalid(true) {}
+	int getHeight();
+	int getWidth();
+	const string& render();
+	void clear();
+	void fill(int x, int y, int count, char character, int color);
+	void invalidate();
+	void invalidateRow(int y);
+	void resize(int width, int height);
+	void setCursor(int x, int y);
+	int write(int x, int y, const char *text, size_t length, int color);
+	int write(int x, int y, const string& text, int color);
+};
+
+#endif
@@ -1,87 +1,294 @@
 #include "StringLinkedList.h"
 
 /**
-	Virtual destructor.
+	Virtual destructor. Nodes hold no memory of their own, so unless the list has
+	siblings they are not visited: the pool and the arena free every Node and every
+	line in bulk.
 */
 StringLinkedList::~StringLinkedList() {
-	Node *node = first;
+	delete valueIndex;
 
-	while (node != NULL) {
-		Node *temp = node;
-		node = node->next;
-		delete temp;
+	if (storage.use_count() > 1) {
+		while (first != NULL) {
+			Node *node = first;
+
+			first = first->next;
+			node->line.release(arena);
+			pool.destroy(node);
+		}
 	}
 }
 
 /**
-	Appends a new Node with the specified data at the end of the list.
-	@param data The data that will be appended with the new Node.
+	Creates an empty list sharing the Nodes and the arena of this one, so that lines
+	move between the two without being copied.
+	@returns The new list; the caller owns it.
 */
-void StringLinkedList::add(string data) {
-	Node *node = new Node();
-	node->data = data;
+LineStore* StringLinkedList::createSibling() {
+	return new StringLinkedList(storage);
+}
 
-	if (first == NULL) {
-		first = node;
-		listSize++;
+/**
+	Finds the Node before a position.
+	@param index The position, from 0 to the size of the list.
+	@returns The Node at index - 1, or NULL if index is 0.
+*/
+Node* StringLinkedList::nodeBefore(int index) {
+	Node *prevNode = NULL;
+
+	if (index == listSize) {
+		return last;
+	}
+
+	for (int i = 0; i < index; i++) {
+		prevNode = prevNode != NULL ? prevNode->next : first;
+	}
+
+	return prevNode;
+}
+
+/**
+	Links a new Node into the list and indexes it.
+	@param node The Node, holding its line.
+	@param prevNode The Node to link it after, or NULL to make it the first Node.
+*/
+void StringLinkedList::link(Node *node, Node *prevNode) {
+	Node *next = prevNode != NULL ? prevNode->next : first;
+
+	if (valueIndex != NULL) {
+		valueIndex->inserting(node, prevNode, next);
+	}
+
+	node->next = next;
+
+	if (prevNode != NULL) {
+		prevNode->next = node;
 	}
 	else {
-		Node *currNode = first;
-		Node *prevNode = NULL;
+		first = node;
+	}
 
-		while (currNode != NULL) {
-			prevNode = currNode;
-			currNode = currNode->next;
-		}
+	if (next == NULL) {
+		last = node;
+	}
 
-		if (prevNode != NULL) {
-			prevNode->next = node;
-			listSize++;
-		}
+	listSize++;
+}
+
+/**
+	Unlinks a Node from the list and frees it.
+	@param node The Node.
+	@param prevNode The Node before it, or NULL if it is the first Node.
+*/
+void StringLinkedList::unlink(Node *node, Node *prevNode) {
+	if (valueIndex != NULL) {
+		valueIndex->removing(node);
 	}
+
+	if (prevNode != NULL) {
+		prevNode->next = node->next;
+	}
+	else {
+		first = node->next;
+	}
+
+	if (node == last) {
+		last = prevNode;
+	}
+
+	listSize--;
+	node->line.release(arena);
+	pool.destroy(node);
 }
 
 /**
-	Inserts a new node at the position specified by the index parameter
+	Appends a new Node with the specified data at the end of the list.
+	@param data The data that will be appended with the new Node.
+*/
+void StringLinkedList::add(LineView data) {
+	Node *node = pool.create();
+	node->line.assign(data.data(), data.size(), arena);
+
+	link(node, last);
+}
+
+/**
+	Inserts a new node at the position specified by the index parameter. Out of range
+	positions append the node.
 	@param index The position to insert the new Node at.
 	@param data The data to insert into the new node.
 */
-void StringLinkedList::insertAt(int index, string data) {
-	Node *node = new Node();
-	node->data = data;
-	int i = 0;
+void StringLinkedList::insertAt(int index, LineView data) {
+	Node *node = pool.create();
+	node->line.assign(data.data(), data.size(), arena);
 
-	Node* currNode = first;
-	Node* prevNode = NULL;
+	if (index < 0 || index > listSize) {
+		index = listSize;
+	}
 
-	if (index == 0) {
-		if (first == NULL) {
-			first = node;
-		}
-		else {
-			node->next = first;
-			first = node;
+	link(node, nodeBefore(index));
+}
+
+/**
+	Inserts a sequence of lines, finding the position only once.
+	@param index The position of the first new line. Out of range positions append
+	the lines.
+	@param lines The lines, in order.
+*/
+void StringLinkedList::insertRange(int index, const vector<LineView>& lines) {
+	if (index < 0 || index > listSize) {
+		index = listSize;
+	}
+
+	Node *prevNode = nodeBefore(index);
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		Node *node = pool.create();
+		node->line.assign(lines[i].data(), lines[i].size(), arena);
+
+		link(node, prevNode);
+		prevNode = node;
+	}
+}
+
+/**
+	Copies a block of lines into a new list sharing this one's storage. The copies
+	share the text of the lines instead of storing it again.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns The new list; the caller owns it.
+*/
+LineStore* StringLinkedList::copy(int start, int numItems) {
+	StringLinkedList *block = new StringLinkedList(storage);
+	Node *currNode = NULL;
+
+	if (start < listSize) {
+		currNode = start > 0 ? nodeBefore(start)->next : first;
+	}
+
+	for (int i = 0; i < numItems && currNode != NULL; i++) {
+		Node *node = pool.create();
+
+		node->line.share(currNode->line, arena);
+		block->link(node, block->last);
+		currNode = currNode->next;
+	}
+
+	return block;
+}
+
+/**
+	Unlinks a block of lines and hands its Nodes to a new list sharing this one's
+	storage. Costs one walk to the end of the block; no line is copied.
+	@param start The position of the first line of the block.
+	@param numItems The number of lines in the block.
+	@returns The new list; the caller owns it.
+*/
+LineStore* StringLinkedList::cut(int start, int numItems) {
+	StringLinkedList *block = new StringLinkedList(storage);
+
+	if (start < 0 || start >= listSize || numItems <= 0) {
+		return block;
+	}
+
+	Node *prevNode = nodeBefore(start);
+	Node *head = prevNode != NULL ? prevNode->next : first;
+	Node *tail = head;
+	int count = 1;
+
+	while (count < numItems && tail->next != NULL) {
+		tail = tail->next;
+		count++;
+	}
+
+	if (valueIndex != NULL) {
+		for (Node *node = head; node != tail->next; node = node->next) {
+			valueIndex->removing(node);
 		}
-		listSize++;
+	}
+
+	if (prevNode != NULL) {
+		prevNode->next = tail->next;
+	}
+	else {
+		first = tail->next;
+	}
+
+	if (tail == last) {
+		last = prevNode;
+	}
+
+	tail->next = NULL;
+	listSize -= count;
+
+	block->first = head;
+	block->last = tail;
+	block->listSize = count;
+	return block;
+}
+
+/**
+	Moves every line of a block into the list, leaving the block empty. A block
+	sharing this list's storage is relinked as a whole, in constant time once the
+	position is found, unless the value index has to take in its lines.
+	@param index The position of the first line of the block once moved. Out of range
+	positions append the block.
+	@param block The lines to move.
+*/
+void StringLinkedList::paste(int index, LineStore& block) {
+	StringLinkedList *list = dynamic_cast<StringLinkedList*>(&block);
+
+	if (list == NULL || list == this || list->storage != storage) {
+		LineStore::paste(index, block);
 		return;
 	}
 
-	while (currNode != NULL) {
-		if (i == index) {
-			break;
-		}
+	if (index < 0 || index > listSize) {
+		index = listSize;
+	}
 
-		prevNode = currNode;
-		currNode = currNode->next;
+	Node *prevNode = nodeBefore(index);
+	Node *head = list->first;
+	Node *tail = list->last;
+	int count = list->listSize;
 
-		i++;
+	list->setValueIndex(false);
+	list->first = NULL;
+	list->last = NULL;
+	list->listSize = 0;
+
+	if (head == NULL) {
+		return;
 	}
 
+	// the index has to see the lines arrive one by one
+	if (valueIndex != NULL) {
+		while (head != NULL) {
+			Node *node = head;
+
+			head = head->next;
+			link(node, prevNode);
+			prevNode = node;
+		}
+		return;
+	}
+
+	Node *next = prevNode != NULL ? prevNode->next : first;
+
 	if (prevNode != NULL) {
-		prevNode->next = node;
-		node->next = currNode;
-		listSize++;
+		prevNode->next = head;
 	}
+	else {
+		first = head;
+	}
+
+	tail->next = next;
+
+	if (next == NULL) {
+		last = tail;
+	}
+
+	listSize += count;
 }
 
 /**
@@ -89,13 +296,17 @@ void StringLinkedList::insertAt(int index, string data) {
 	@param index The position of the node to be updated.
 	@param value The new value of the node's data.
 */
-void StringLinkedList::updateValue(int index, string value) {
+void StringLinkedList::updateValue(int index, LineView value) {
 	Node *currNode = first;
 	int i = 0;
 
 	while (currNode != NULL) {
 		if (i == index) {
-			currNode->data = value;
+			currNode->line.assign(value.data(), value.size(), arena);
+
+			if (valueIndex != NULL) {
+				valueIndex->updated(currNode);
+			}
 			break;
 		}
 		
@@ -105,32 +316,31 @@ void StringLinkedList::updateValue(int index, string value) {
 }
 
 /**
-	Deletes the first node that contains the specified value.
+	Deletes the first node that contains the specified value. Looks it up in the
+	value index when there is one, instead of comparing every node.
 	@param value The value of the node to be deleted.
 */
-void StringLinkedList::deleteValue(string value) {
+void StringLinkedList::deleteValue(LineView value) {
 	Node *currNode = first;
 	Node *prevNode = NULL;
 
-	while (currNode != NULL) {
-		if (currNode->data == value) {
-			break;
-		}
-
-		prevNode = currNode;
-		currNode = currNode->next;
+	if (valueIndex != NULL) {
+		currNode = valueIndex->find(value);
+		prevNode = currNode != NULL ? valueIndex->previous(currNode) : NULL;
 	}
+	else {
+		while (currNode != NULL) {
+			if (currNode->line.equals(value)) {
+				break;
+			}
 
-	if (currNode != NULL) {
-		if (currNode == first) {
-			first = currNode->next;
-		}
-		else {
-			prevNode->next = currNode->next;
+			prevNode = currNode;
+			currNode = currNode->next;
 		}
+	}
 
-		listSize--;
-		delete currNode;
+	if (currNode != NULL) {
+		unlink(currNode, prevNode);
 	}
 }
 
@@ -155,16 +365,8 @@ void StringLinkedList::deleteNode(int index) {
 		i++;
 	}
 
-	if (i >= 0) {
-		if (currNode == first) {
-			first = currNode->next;
-		}
-		else {
-			prevNode->next = currNode->next;
-		}
-
-		listSize--;
-		delete currNode;
+	if (currNode != NULL) {
+		unlink(currNode, prevNode);
 	}
 }
 
@@ -181,33 +383,11 @@ void StringLinkedList::deleteRange(int start, int numItems) {
 
 	while (currNode != NULL) {
 		if (i == start) {
-			Node *temp = NULL;
-
-			for (int x = 0; x < numItems; x++) {
-				if (currNode != NULL) {
-					temp = currNode;
-
-					if (currNode->next != NULL) {
-						currNode = currNode->next;
-					}
-					else {
-						currNode = NULL;
-					}
-
-					delete temp;
-					listSize--;
-					temp = NULL;
-				}
-				else {
-					break;
-				}
-			}
+			for (int x = 0; x < numItems && currNode != NULL; x++) {
+				Node *temp = currNode;
 
-			if (prevNode != NULL) {
-				prevNode->next = currNode;
-			}
-			else {
-				first = currNode;
+				currNode = currNode->next;
+				unlink(temp, prevNode);
 			}
 			break;
 		}
@@ -222,42 +402,65 @@ void StringLinkedList::deleteRange(int start, int numItems) {
 /**
 	Inserts a new Node after a Node with the specified value has been found. If no Nodes with
 	the specified value can be found, the Node will be apended at the end of the list.
+	Looks the value up in the value index when there is one, instead of comparing every
+	node.
 	@param value The value of the Node after which the new Node will be insterted.
 	@param data The data of the new Node to be insterted.
 */
-void StringLinkedList::insertAfterValue(string value, string data) {
-	Node *node = new Node();
-	node->data = data;
+void StringLinkedList::insertAfterValue(LineView value, LineView data) {
+	Node *prev = NULL;
 
 	// search for node to insert after
-	Node *prev = first;
-
-	while (prev != NULL) {
-		if (prev->data == value) {
-			break;
+	if (valueIndex != NULL) {
+		prev = valueIndex->find(value);
+	}
+	else {
+		for (prev = first; prev != NULL; prev = prev->next) {
+			if (prev->line.equals(value)) {
+				break;
+			}
 		}
-		prev = prev->next;
 	}
 
-	// insert node into list
-	if (first == NULL) {
-		first = node;
-		listSize++;
+	Node *node = pool.create();
+	node->line.assign(data.data(), data.size(), arena);
+
+	// could not find the node to insert after, so append it
+	link(node, prev != NULL ? prev : last);
+}
+
+/**
+	Checks if lines are looked up by value through an index.
+	@returns True if the value index is on.
+*/
+bool StringLinkedList::hasValueIndex() {
+	return valueIndex != NULL;
+}
+
+/**
+	Turns the value index on or off. Building it costs one pass over the list; from
+	then on, every change to the list keeps it up to date, and deleteValue and
+	insertAfterValue find their line without walking the list.
+	@param enabled Whether the index should be kept.
+*/
+void StringLinkedList::setValueIndex(bool enabled) {
+	if (enabled && valueIndex == NULL) {
+		valueIndex = new ValueIndex(first, listSize);
 	}
-	else {
-		if (prev != NULL) {
-			node->next = prev->next;
-			prev->next = node;
-			listSize++;
-		}
-		else {
-			// could not find the node to insert after
-			// so defaulting to Add function
-			add(data);
-		}
+	else if (!enabled) {
+		delete valueIndex;
+		valueIndex = NULL;
 	}
 }
 
+/**
+	Gets the memory held by the value index.
+	@returns The size of the index in bytes, or 0 if it is off.
+*/
+size_t StringLinkedList::valueIndexMemoryUsage() {
+	return valueIndex != NULL ? valueIndex->memoryUsage() : 0;
+}
+
 /**
 	Gets the value of Node at the position specified by the index parameter.
 	@returns The value of the node.
@@ -270,7 +473,8 @@ string StringLinkedList::get(int index) {
 	while (currNode != NULL)
 	{
 		if (i == index) {
-			value = currNode->data;
+			value = currNode->line.str();
+			break;
 		}
 
 		currNode = currNode->next;
@@ -280,6 +484,119 @@ string StringLinkedList::get(int index) {
 	return value;
 }
 
+/**
+	Gets the value of a Node without copying it.
+	@param index The position of the Node.
+	@returns The value, valid until the list is next modified; empty if the index is
+	out of range.
+*/
+LineView StringLinkedList::getView(int index) {
+	Node *currNode = first;
+
+	for (int i = 0; currNode != NULL && i < index; i++) {
+		currNode = currNode->next;
+	}
+
+	if (currNode == NULL || index < 0) {
+		return LineView();
+	}
+
+	return currNode->line.view();
+}
+
+/**
+	Calls a visitor with up to numItems consecutive lines, without copying them,
+	walking the list only once.
+	@param start The position of the first line.
+	@param numItems The maximum number of lines to visit.
+	@param visitor Receives each line; the visit stops when it returns false. It must
+	not modify the list.
+*/
+void StringLinkedList::visit(int start, int numItems, const LineVisitor& visitor) {
+	Node *currNode = first;
+	int i = 0;
+
+	while (currNode != NULL && i < start + numItems) {
+		if (i >= start && !visitor(i, currNode->line.view())) {
+			break;
+		}
+
+		currNode = currNode->next;
+		i++;
+	}
+}
+
+/**
+	Gets an iterator to the first line.
+	@returns The iterator.
+*/
+StringLinkedList::const_iterator StringLinkedList::begin() const {
+	return const_iterator(first);
+}
+
+/**
+	Gets the iterator past the last line.
+	@returns The iterator.
+*/
+StringLinkedList::const_iterator StringLinkedList::end() const {
+	return const_iterator(NULL);
+}
+
+/**
+	Gets the values of up to numItems Nodes, starting at the position specified by
+	the start parameter, walking the list only once.
+	@param start The position of the first Node.
+	@param numItems The maximum number of values to get.
+	@param lines Receives the values; it is cleared first.
+*/
+void StringLinkedList::getRange(int start, int numItems, vector<string>& lines) {
+	Node *currNode = first;
+	int i = 0;
+
+	lines.clear();
+
+	while (currNode != NULL && (int)lines.size() < numItems) {
+		if (i >= start) {
+			lines.push_back(currNode->line.str());
+		}
+
+		currNode = currNode->next;
+		i++;
+	}
+}
+
+/**
+	Gets up to numItems consecutive lines without copying them. The spans point into
+	the Nodes or the arena and are only valid until the list is next modified.
+	@param start The position of the first line.
+	@param numItems The maximum number of lines to get.
+	@param spans Receives the lines; it is cleared first.
+*/
+void StringLinkedList::getSpans(int start, int numItems, vector<LineSpan>& spans) {
+	Node *currNode = first;
+	int i = 0;
+
+	spans.clear();
+
+	while (currNode != NULL && (int)spans.size() < numItems) {
+		if (i >= start) {
+			spans.push_back(currNode->line.span());
+		}
+
+		currNode = currNode->next;
+		i++;
+	}
+}
+
+/**
+	Gets the allocation counters of the Node pool.
+	@returns The number of Nodes handed out, reused and released, and the slabs
+	requested from the system.
+*/
+PoolStats StringLinkedList::allocationStats() {
+	return pool.getStats();
+}
+
 /**
 	Returns the number of Nodes contained by this LinkedList.
 	@returns The number of Nodes in the list.
@@ -289,22 +606,21 @@ int StringLinkedList::size() {
 }
 
 /**
-	Overridden output (<<) operator.
+	Writes every Node's data to the output stream, separated by line breaks.
+	@param output The stream to write the list to.
 */
-ostream& operator<<(ostream& output, StringLinkedList& list)
+void StringLinkedList::write(ostream& output)
 {
-	Node *currNode = list.first;
+	Node *currNode = first;
 
 	while (currNode != NULL)
 	{
-		output << currNode->data;
+		output.write(currNode->line.data(), currNode->line.size());
 
 		currNode = currNode->next;
 
 		if (currNode != NULL) {
-			output << endl;
+			output << '\n';
 		}
 	}
-
-	return output;
 }
\ No newline at end of file
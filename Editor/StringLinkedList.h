@@ -1,29 +1,111 @@
 #ifndef STRINGLINKEDLIST_H
 #define STRINGLINKEDLIST_H
+#include "LineStorage.h"
+#include "LineStore.h"
 #include "Node.h"
+#include "NodePool.h"
+#include "TextArena.h"
+#include "ValueIndex.h"
+#include <cstddef>
+#include <iterator>
+#include <memory>
 #include <string>
 
 using namespace std;
 
-class StringLinkedList
+class StringLinkedList : public LineStore
 {
 private:
 	Node *first;
+	Node *last;
 	int listSize;
+	// Shared with the siblings of the list.
+	shared_ptr<LineStorage<Node>> storage;
+	NodePool<Node>& pool;
+	TextArena& arena;
+	// Optional: finds lines by value for deleteValue and insertAfterValue.
+	ValueIndex *valueIndex;
+
+	explicit StringLinkedList(shared_ptr<LineStorage<Node>> storage) : first(NULL), last(NULL), listSize(0),
+		storage(storage), pool(storage->pool), arena(storage->arena), valueIndex(NULL) {}
+	Node* nodeBefore(int index);
+	void link(Node *node, Node *prevNode);
+	void unlink(Node *node, Node *prevNode);
+
+protected:
+	void write(ostream& output);
 
 public:
-	friend ostream& operator<<(ostream& output, StringLinkedList& list);
+	/*
+		Walks the lines in order, as views that are valid until the list is modified.
+		Works with the standard algorithms that take forward iterators.
+	*/
+	class const_iterator
+	{
+	private:
+		const Node *node;
+
+	public:
+		typedef forward_iterator_tag iterator_category;
+		typedef LineView value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const LineView* pointer;
+		typedef LineView reference;
+
+		const_iterator(const Node *node = NULL) : node(node) {}
+
+		LineView operator*() const {
+			return node->line.view();
+		}
+
+		const_iterator& operator++() {
+			node = node->next;
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			const_iterator previous = *this;
+			node = node->next;
+			return previous;
+		}
+
+		bool operator==(const const_iterator& other) const {
+			return node == other.node;
+		}
+
+		bool operator!=(const const_iterator& other) const {
+			return node != other.node;
+		}
+	};
+
+	PoolStats allocationStats();
 	int size();
+	const_iterator begin() const;
+	const_iterator end() const;
 	string get(int index);
-	StringLinkedList() : first(NULL), listSize(0) {}
+	void getRange(int start, int numItems, vector<string>& lines);
+	void getSpans(int start, int numItems, vector<LineSpan>& spans);
+	LineView getView(int index);
+	void visit(int start, int numItems, const LineVisitor& visitor);
+	StringLinkedList() : StringLinkedList(make_shared<LineStorage<Node>>()) {}
+	StringLinkedList(const StringLinkedList&) = delete;
+	StringLinkedList& operator=(const StringLinkedList&) = delete;
 	virtual ~StringLinkedList();
-	void add(string data);
+	LineStore* createSibling();
+	LineStore* copy(int start, int numItems);
+	LineStore* cut(int start, int numItems);
+	void add(LineView data);
 	void deleteNode(int index);
 	void deleteRange(int start, int numItems);
-	void deleteValue(string value);
-	void insertAfterValue(string value, string data);
-	void insertAt(int index, string data);
-	void updateValue(int index, string value);
+	void deleteValue(LineView value);
+	void insertAfterValue(LineView value, LineView data);
+	void insertAt(int index, LineView data);
+	void insertRange(int index, const vector<LineView>& lines);
+	void paste(int index, LineStore& block);
+	void updateValue(int index, LineView value);
+	bool hasValueIndex();
+	void setValueIndex(bool enabled);
+	size_t valueIndexMemoryUsage();
 };
 
 #endif
@@ -0,0 +1,145 @@
+#include "TextArena.h"
+#include <cstring>
+#include <new>
+
+/**
+	Virtual destructor. Frees every block at once; any text still stored goes with
+	them.
+*/
+TextArena::~TextArena() {
+	for (map<const char*, ArenaBlock>::iterator i = blocks.begin(); i != blocks.end(); ++i) {
+		::operator delete((void*)i->first);
+	}
+}
+
+/**
+	Copies a piece of text into the arena.
+	@param text The text.
+	@param length The number of characters to copy; must not be 0.
+	@returns The copy, which stays in place until it is released.
+*/
+const char* TextArena::store(const char *text, size_t length) {
+	map<const char*, ArenaBlock>::iterator block;
+
+	if (length >= ARENA_LARGE_TEXT) {
+		block = blocks.find(allocateBlock(length));
+	}
+	else {
+		block = current != NULL ? blocks.find(current) : blocks.end();
+
+		if (block == blocks.end() || block->second.size - block->second.used < length) {
+			current = allocateBlock(ARENA_BLOCK_SIZE);
+			block = blocks.find(current);
+		}
+	}
+
+	char *copy = (char*)block->first + block->second.used;
+
+	memcpy(copy, text, length);
+	block->second.used += length;
+	block->second.live += length;
+	liveBytes += length;
+	return copy;
+}
+
+/**
+	Adds a reference to text stored in the arena, for a line that shares it with the
+	lines already referring to it. The text must be released once more.
+	@param text The text, as returned by store.
+*/
+void TextArena::share(const char *text) {
+	unordered_map<const char*, size_t>::iterator shared = shares.find(text);
+
+	if (shared == shares.end()) {
+		shares[text] = 2;
+	}
+	else {
+		shared->second++;
+	}
+}
+
+/**
+	Releases text stored in the arena. Shared text is only dropped once every line
+	referring to it released it. Frees the block of the text once nothing in it is
+	used.
+	@param text The text, as returned by store.
+	@param length The number of characters that were stored.
+*/
+void TextArena::release(const char *text, size_t length) {
+	if (!shares.empty()) {
+		unordered_map<const char*, size_t>::iterator shared = shares.find(text);
+
+		if (shared != shares.end()) {
+			if (--shared->second == 1) {
+				shares.erase(shared);
+			}
+			return;
+		}
+	}
+
+	map<const char*, ArenaBlock>::iterator block = blocks.upper_bound(text);
+
+	if (block == blocks.begin()) {
+		return;
+	}
+	--block;
+
+	block->second.live -= length;
+	liveBytes -= length;
+
+	if (block->second.live == 0) {
+		if (block->first == current) {
+			block->second.used = 0;
+		}
+		else {
+			freeBlock(block);
+		}
+	}
+}
+
+/**
+	Gets the number of blocks held.
+	@returns The number of blocks.
+*/
+size_t TextArena::getBlockCount() {
+	return blocks.size();
+}
+
+/**
+	Gets the number of bytes of text stored and not released.
+	@returns The number of bytes.
+*/
+size_t TextArena::getLiveBytes() {
+	return liveBytes;
+}
+
+/**
+	Gets the memory held by the blocks, including the unused and released parts.
+	@returns The number of bytes.
+*/
+size_t TextArena::getReservedBytes() {
+	return reservedBytes;
+}
+
+/**
+	Requests a block from the system.
+	@param size The size of the block.
+	@returns The first byte of the block.
+*/
+char* TextArena::allocateBlock(size_t size) {
+	char *memory = (char*)::operator new(size);
+
+	blocks[memory].size = size;
+	reservedBytes += size;
+	return memory;
+}
+
+/**
+	Returns a block to the system.
+	@param block The block.
+*/
+void TextArena::freeBlock(map<const char*, ArenaBlock>::iterator block) {
+	reservedBytes -= block->second.size;
+	::operator delete((void*)block->first);
+	blocks.erase(block);
+}
@@ -0,0 +1,60 @@
+#ifndef TEXTARENA_H
+#define TEXTARENA_H
+
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+// Text is packed into blocks of this size; longer lines get a block of their own.
+const size_t ARENA_BLOCK_SIZE = 1024 * 1024;
+const size_t ARENA_LARGE_TEXT = ARENA_BLOCK_SIZE / 4;
+
+struct ArenaBlock
+{
+public:
+	ArenaBlock() : size(0), used(0), live(0) {}
+
+	size_t size;
+	// Bytes handed out so far; the block is filled front to back.
+	size_t used;
+	// Bytes handed out and not released yet.
+	size_t live;
+};
+
+/**
+	Stores the text of lines back to back in large blocks, so that a line costs its
+	characters and nothing more. Text that is released leaves a hole until every
+	line of its block is gone, at which point the block is returned to the system,
+	or rewound if it is the one being filled. Stored text never changes, so copies of
+	a line may share it; it is then released once every copy released it.
+*/
+class TextArena
+{
+private:
+	// Keyed by the first byte of each block.
+	map<const char*, ArenaBlock> blocks;
+	// The number of lines referring to each text stored once and shared by several.
+	unordered_map<const char*, size_t> shares;
+	char *current;
+	size_t liveBytes;
+	size_t reservedBytes;
+
+	char* allocateBlock(size_t size);
+	void freeBlock(map<const char*, ArenaBlock>::iterator block);
+
+public:
+	TextArena() : current(NULL), liveBytes(0), reservedBytes(0) {}
+	TextArena(const TextArena&) = delete;
+	TextArena& operator=(const TextArena&) = delete;
+	virtual ~TextArena();
+	const char* store(const char *text, size_t length);
+	void share(const char *text);
+	void release(const char *text, size_t length);
+	size_t getBlockCount();
+	size_t getLiveBytes();
+	size_t getReservedBytes();
+};
+
+#endif
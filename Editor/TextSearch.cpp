@@ -0,0 +1,155 @@
+#include "TextSearch.h"
+#include <cstring>
+
+/**
+	Main constructor.
+	@param pattern The text to look for.
+	@param method The scanner implementation to use; falls back to scalar if the
+	processor does not support it.
+*/
+TextSearch::TextSearch(string pattern, ScanMethod method) : pattern(pattern) {
+	if (method == SCAN_AUTO) {
+		method = LineScanner::bestMethod();
+	}
+	else if (!LineScanner::isSupported(method)) {
+		method = SCAN_SCALAR;
+	}
+
+	this->method = method;
+}
+
+/**
+	Gets the text being looked for.
+	@returns The pattern.
+*/
+const string& TextSearch::getPattern() const {
+	return pattern;
+}
+
+/**
+	Finds the first occurrence of the pattern in a block of text. An empty pattern
+	matches at the start of the text.
+	@param text The text to search.
+	@param length The size of the text, in bytes.
+	@returns The start of the first occurrence, or NULL if there is none.
+*/
+const char* TextSearch::find(const char *text, size_t length) const {
+	if (pattern.size() > length) {
+		return NULL;
+	}
+
+	if (pattern.empty()) {
+		return text;
+	}
+
+	switch (method) {
+	case SCAN_AVX2:
+		return findAvx2(text, length);
+	case SCAN_SSE2:
+		return findSse2(text, length);
+	default:
+		return findScalar(text, length);
+	}
+}
+
+/**
+	Portable implementation of find, also used for the tails the vector
+	implementations leave over: finds each occurrence of the first byte of the
+	pattern, then compares the rest.
+*/
+const char* TextSearch::findScalar(const char *text, size_t length) const {
+	if (length < pattern.size()) {
+		return NULL;
+	}
+
+	const char *start = text;
+	const char *last = text + length - pattern.size();
+	size_t rest = pattern.size() - 1;
+
+	while (start <= last) {
+		const char *candidate = (const char*)memchr(start, pattern[0], last - start + 1);
+
+		if (candidate == NULL) {
+			return NULL;
+		}
+
+		if (memcmp(candidate + 1, pattern.data() + 1, rest) == 0) {
+			return candidate;
+		}
+
+		start = candidate + 1;
+	}
+
+	return NULL;
+}
+
+#ifdef LINESCANNER_X86
+
+/**
+	SSE2 implementation of find. Compares the first and the last byte of the pattern
+	against 16 positions at a time, and only compares the whole pattern where both
+	match; in ordinary text that rules out almost every position.
+*/
+const char* TextSearch::findSse2(const char *text, size_t length) const {
+	size_t lastOffset = pattern.size() - 1;
+	const __m128i first = _mm_set1_epi8(pattern[0]);
+	const __m128i last = _mm_set1_epi8(pattern[lastOffset]);
+	size_t i = 0;
+
+	for (; i + lastOffset + 16 <= length; i += 16) {
+		__m128i starts = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(text + i)), first);
+		__m128i ends = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(text + i + lastOffset)), last);
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(starts, ends));
+
+		while (mask != 0) {
+			const char *candidate = text + i + lowestBit(mask);
+
+			if (memcmp(candidate + 1, pattern.data() + 1, lastOffset) == 0) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return findScalar(text + i, length - i);
+}
+
+/**
+	AVX2 implementation of find: the same filter as findSse2, over 32 positions at a
+	time.
+*/
+AVX2_FUNCTION const char* TextSearch::findAvx2(const char *text, size_t length) const {
+	size_t lastOffset = pattern.size() - 1;
+	const __m256i first = _mm256_set1_epi8(pattern[0]);
+	const __m256i last = _mm256_set1_epi8(pattern[lastOffset]);
+	size_t i = 0;
+
+	for (; i + lastOffset + 32 <= length; i += 32) {
+		__m256i starts = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + i)), first);
+		__m256i ends = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + i + lastOffset)), last);
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(starts, ends));
+
+		while (mask != 0) {
+			const char *candidate = text + i + lowestBit(mask);
+
+			if (memcmp(candidate + 1, pattern.data() + 1, lastOffset) == 0) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return findSse2(text + i, length - i);
+}
+
+#else
+
+const char* TextSearch::findSse2(const char *text, size_t length) const {
+	return findScalar(text, length);
+}
+
+const char* TextSearch::findAvx2(const char *text, size_t length) const {
+	return findScalar(text, length);
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include "LineScanner.h"
+#include <string>
+
+using namespace std;
+
+class TextSearch
+{
+private:
+	string pattern;
+	ScanMethod method;
+
+	const char* findScalar(const char *text, size_t length) const;
+	const char* findSse2(const char *text, size_t length) const;
+	const char* findAvx2(const char *text, size_t length) const;
+
+public:
+	TextSearch(string pattern = "", ScanMethod method = SCAN_AUTO);
+	const char* find(const char *text, size_t length) const;
+	const string& getPattern() const;
+};
+
+#endif
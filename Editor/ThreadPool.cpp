@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+
+/**
+	Main constructor. Starts the worker threads, which sleep until there is work.
+	@param numThreads The number of threads that run tasks, including the thread
+	calling run; 0 uses one per processor.
+*/
+ThreadPool::ThreadPool(int numThreads) : task(NULL), numTasks(0), nextTask(0), doneTasks(0), stopping(false) {
+	if (numThreads <= 0) {
+		numThreads = (int)thread::hardware_concurrency();
+	}
+
+	// the thread calling run works too
+	for (int i = 1; i < numThreads; i++) {
+		workers.push_back(thread(&ThreadPool::work, this));
+	}
+}
+
+/**
+	Virtual destructor. Stops the worker threads.
+*/
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+/**
+	Gets the number of threads that run tasks.
+	@returns The number of workers, plus the thread calling run.
+*/
+int ThreadPool::size() {
+	return (int)workers.size() + 1;
+}
+
+/**
+	Runs a task once for each index from 0 to numTasks - 1, spread over the pool,
+	and waits for every run to finish. Not reentrant: only one thread may call run
+	at a time.
+	@param numTasks The number of times to run the task.
+	@param task The task; receives the index of the run.
+*/
+void ThreadPool::run(int numTasks, const function<void(int)>& task) {
+	unique_lock<mutex> guard(lock);
+
+	this->task = &task;
+	this->numTasks = numTasks;
+	nextTask = 0;
+	doneTasks = 0;
+	wake.notify_all();
+
+	while (runNext(guard)) {
+	}
+
+	finished.wait(guard, [this] { return doneTasks == this->numTasks; });
+	this->task = NULL;
+}
+
+/**
+	Runs the next task index, if any is left, with the lock released.
+	@param guard The held lock.
+	@returns True if a task was run.
+*/
+bool ThreadPool::runNext(unique_lock<mutex>& guard) {
+	if (task == NULL || nextTask >= numTasks) {
+		return false;
+	}
+
+	int index = nextTask++;
+	const function<void(int)> *current = task;
+
+	guard.unlock();
+	(*current)(index);
+	guard.lock();
+
+	if (++doneTasks == numTasks) {
+		finished.notify_all();
+	}
+
+	return true;
+}
+
+/**
+	Worker thread body.
+*/
+void ThreadPool::work() {
+	unique_lock<mutex> guard(lock);
+
+	while (!stopping) {
+		if (!runNext(guard)) {
+			wake.wait(guard);
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool
+{
+private:
+	vector<thread> workers;
+	mutex lock;
+	condition_variable wake;
+	condition_variable finished;
+	const function<void(int)> *task;
+	int numTasks;
+	int nextTask;
+	int doneTasks;
+	bool stopping;
+
+	bool runNext(unique_lock<mutex>& guard);
+	void work();
+
+public:
+	ThreadPool(int numThreads = 0);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	virtual ~ThreadPool();
+	int size();
+	void run(int numTasks, const function<void(int)>& task);
+};
+
+#endif
@@ -0,0 +1,315 @@
+#include "TrigramIndex.h"
+#include <algorithm>
+
+// The number of possible trigrams, three bytes each.
+const unsigned int TRIGRAM_COUNT = 1 << 24;
+
+// Builds go through the store this many blocks at a time, expiring the views of the
+// lines read before the next round, so that paged stores don't keep every line.
+const int BUILD_ROUND_BLOCKS = 64;
+
+/*
+	The index splits the buffer into blocks of consecutive lines and keeps, for each
+	block, the set of trigrams (runs of three bytes) found in its lines. A line can
+	only contain a pattern if its block holds every trigram of the pattern, so a
+	search only has to visit the blocks that pass that test.
+
+	Blocks are identified by their order, not by line numbers, so inserting or
+	deleting lines only changes the size of the blocks around the edit. Trigrams are
+	added as lines are inserted but not taken out as lines are removed; a block that
+	has lost many of its lines is rebuilt from the buffer, and one that has grown too
+	large is split.
+*/
+
+/**
+	Checks if the index is in use.
+	@returns True once built, until cleared.
+*/
+bool TrigramIndex::isEnabled() {
+	return enabled;
+}
+
+/**
+	Gets the number of blocks the buffer is split into.
+	@returns The number of blocks.
+*/
+size_t TrigramIndex::getBlockCount() {
+	return blocks.size();
+}
+
+/**
+	Gets the memory held by the index.
+	@returns The size of the index, in bytes.
+*/
+size_t TrigramIndex::memoryUsage() {
+	size_t bytes = blocks.capacity() * sizeof(TrigramBlock);
+
+	for (size_t i = 0; i < blocks.size(); i++) {
+		bytes += blocks[i].trigrams.capacity() * sizeof(unsigned int);
+	}
+
+	return bytes;
+}
+
+/**
+	Builds the index of every line in a store, replacing any previous contents. The
+	blocks are built in parallel; the store must not change meanwhile, and the
+	caller must not hold views of its lines.
+	@param store The store to index.
+	@param pool The threads to build the blocks with.
+*/
+void TrigramIndex::build(LineStore& store, ThreadPool& pool) {
+	int numLines = store.size();
+	int numBlocks = (numLines + TRIGRAM_BLOCK_LINES - 1) / TRIGRAM_BLOCK_LINES;
+
+	blocks.clear();
+	blocks.resize(numBlocks);
+
+	for (int i = 0; i < numBlocks; i++) {
+		blocks[i].numLines = min(TRIGRAM_BLOCK_LINES, numLines - i * TRIGRAM_BLOCK_LINES);
+	}
+
+	for (int round = 0; round < numBlocks; round += BUILD_ROUND_BLOCKS) {
+		pool.run(min(BUILD_ROUND_BLOCKS, numBlocks - round), [&](int task) {
+			int block = round + task;
+
+			buildBlock(blocks[block], block * TRIGRAM_BLOCK_LINES, store);
+		});
+
+		store.expireViews();
+	}
+
+	enabled = true;
+}
+
+/**
+	Discards the index.
+*/
+void TrigramIndex::clear() {
+	vector<TrigramBlock>().swap(blocks);
+	enabled = false;
+}
+
+/**
+	Updates the index after a change has been applied to the store.
+	@param change The change.
+	@param store The store, with the change applied.
+*/
+void TrigramIndex::apply(const Change& change, LineStore& store) {
+	int position = change.position;
+	int remaining = (int)change.removed.size();
+	int firstLine;
+
+	if (!enabled) {
+		return;
+	}
+
+	while (remaining > 0) {
+		size_t index = findBlock(position, firstLine);
+
+		if (index == blocks.size() || position >= firstLine + blocks[index].numLines) {
+			break;
+		}
+
+		TrigramBlock& block = blocks[index];
+		int count = min(remaining, firstLine + block.numLines - position);
+
+		block.numLines -= count;
+		block.staleLines += count;
+		remaining -= count;
+
+		if (block.numLines == 0) {
+			blocks.erase(blocks.begin() + index);
+		}
+	}
+
+	if (!change.inserted.empty()) {
+		size_t index = findBlock(position, firstLine);
+		vector<unsigned int> added;
+
+		if (index == blocks.size()) {
+			blocks.push_back(TrigramBlock());
+		}
+
+		for (size_t i = 0; i < change.inserted.size(); i++) {
+			addTrigrams(change.inserted[i].data(), change.inserted[i].size(), added);
+		}
+		sortTrigrams(added);
+
+		TrigramBlock& block = blocks[index];
+		size_t middle = block.trigrams.size();
+
+		block.numLines += (int)change.inserted.size();
+		block.trigrams.insert(block.trigrams.end(), added.begin(), added.end());
+		inplace_merge(block.trigrams.begin(), block.trigrams.begin() + middle, block.trigrams.end());
+		block.trigrams.erase(unique(block.trigrams.begin(), block.trigrams.end()), block.trigrams.end());
+	}
+
+	maintain(position - 1, position + (int)change.inserted.size(), store);
+}
+
+/**
+	Finds the blocks that may hold lines containing a pattern.
+	@param pattern The text to look for.
+	@param start The position of the first line to search.
+	@param end The position just past the last line to search.
+	@param ranges Receives the ranges of lines to search, as [first, last) pairs in
+	order; it is cleared first.
+	@returns The number of candidate blocks.
+*/
+size_t TrigramIndex::getCandidates(const string& pattern, int start, int end, vector<pair<int, int>>& ranges) {
+	vector<unsigned int> query;
+	size_t numCandidates = 0;
+	int firstLine = 0;
+
+	ranges.clear();
+	addTrigrams(pattern.data(), pattern.size(), query);
+	sortTrigrams(query);
+
+	for (size_t i = 0; i < blocks.size() && firstLine < end; i++) {
+		TrigramBlock& block = blocks[i];
+		int lastLine = firstLine + block.numLines;
+		bool matches = lastLine > start;
+
+		for (size_t j = 0; matches && j < query.size(); j++) {
+			matches = binary_search(block.trigrams.begin(), block.trigrams.end(), query[j]);
+		}
+
+		if (matches) {
+			int first = max(firstLine, start);
+			int last = min(lastLine, end);
+
+			if (!ranges.empty() && ranges.back().second == first) {
+				ranges.back().second = last;
+			}
+			else {
+				ranges.push_back(make_pair(first, last));
+			}
+			numCandidates++;
+		}
+
+		firstLine = lastLine;
+	}
+
+	return numCandidates;
+}
+
+/**
+	Appends the trigrams of a line, each packed as three bytes, in no particular
+	order and possibly repeated.
+	@param text The line.
+	@param length The number of characters in the line.
+	@param trigrams Receives the trigrams.
+*/
+void TrigramIndex::addTrigrams(const char *text, size_t length, vector<unsigned int>& trigrams) {
+	const unsigned char *bytes = (const unsigned char*)text;
+
+	for (size_t i = 0; i + 3 <= length; i++) {
+		trigrams.push_back((bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2]);
+	}
+}
+
+/**
+	Sorts a list of trigrams and removes the repeated ones.
+	@param trigrams The trigrams.
+*/
+void TrigramIndex::sortTrigrams(vector<unsigned int>& trigrams) {
+	sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
+
+/**
+	Finds the block holding a line.
+	@param line The position of the line.
+	@param firstLine Receives the position of the block's first line.
+	@returns The index of the block; the last block if the line is past the end, or
+	the number of blocks if there are none.
+*/
+size_t TrigramIndex::findBlock(int line, int& firstLine) {
+	firstLine = 0;
+
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (line < firstLine + blocks[i].numLines || i + 1 == blocks.size()) {
+			return i;
+		}
+		firstLine += blocks[i].numLines;
+	}
+
+	return blocks.size();
+}
+
+/**
+	Collects the trigrams of a block's lines from the store. Repeats are filtered out
+	with a bitmap of every possible trigram as they are found, so that only distinct
+	trigrams need sorting.
+	@param block The block; its number of lines must be set.
+	@param firstLine The position of the block's first line.
+	@param store The store.
+*/
+void TrigramIndex::buildBlock(TrigramBlock& block, int firstLine, LineStore& store) {
+	static thread_local vector<unsigned long long> seen;
+	vector<LineSpan> spans;
+
+	if (seen.empty()) {
+		seen.resize(TRIGRAM_COUNT / 64);
+	}
+
+	block.trigrams.clear();
+	block.staleLines = 0;
+	store.getSpans(firstLine, block.numLines, spans);
+
+	for (size_t i = 0; i < spans.size(); i++) {
+		const unsigned char *bytes = (const unsigned char*)spans[i].text;
+
+		for (size_t j = 0; j + 3 <= spans[i].length; j++) {
+			unsigned int trigram = (bytes[j] << 16) | (bytes[j + 1] << 8) | bytes[j + 2];
+			unsigned long long bit = 1ULL << (trigram % 64);
+
+			if ((seen[trigram / 64] & bit) == 0) {
+				seen[trigram / 64] |= bit;
+				block.trigrams.push_back(trigram);
+			}
+		}
+	}
+
+	sort(block.trigrams.begin(), block.trigrams.end());
+	block.trigrams.shrink_to_fit();
+
+	for (size_t i = 0; i < block.trigrams.size(); i++) {
+		seen[block.trigrams[i] / 64] = 0;
+	}
+}
+
+/**
+	Rebuilds the blocks around an edit that have lost too many lines, and splits the
+	ones that have grown too large.
+	@param from The position of the first line edited.
+	@param to The position of the last line edited.
+	@param store The store, with the edit applied.
+*/
+void TrigramIndex::maintain(int from, int to, LineStore& store) {
+	int firstLine = 0;
+
+	for (size_t i = 0; i < blocks.size() && firstLine <= to; i++) {
+		int numLines = blocks[i].numLines;
+
+		if (firstLine + numLines > from) {
+			if (numLines > 2 * TRIGRAM_BLOCK_LINES) {
+				int numBlocks = (numLines + TRIGRAM_BLOCK_LINES - 1) / TRIGRAM_BLOCK_LINES;
+
+				blocks.insert(blocks.begin() + i + 1, numBlocks - 1, TrigramBlock());
+
+				for (int j = 0; j < numBlocks; j++) {
+					blocks[i + j].numLines = min(TRIGRAM_BLOCK_LINES, numLines - j * TRIGRAM_BLOCK_LINES);
+					buildBlock(blocks[i + j], firstLine + j * TRIGRAM_BLOCK_LINES, store);
+				}
+				i += numBlocks - 1;
+			}
+			else if (blocks[i].staleLines > numLines / 2) {
+				buildBlock(blocks[i], firstLine, store);
+			}
+		}
+
+		firstLine += numLines;
+	}
+}
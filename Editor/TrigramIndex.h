@@ -0,0 +1,50 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include "EditHistory.h"
+#include "LineStore.h"
+#include "ThreadPool.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+const int TRIGRAM_BLOCK_LINES = 256;
+
+struct TrigramBlock
+{
+public:
+	TrigramBlock() : numLines(0), staleLines(0) {}
+
+	int numLines;
+	// Lines removed or replaced since the block was built; their trigrams linger.
+	int staleLines;
+	// Every trigram found in the block's lines, sorted.
+	vector<unsigned int> trigrams;
+};
+
+class TrigramIndex
+{
+private:
+	vector<TrigramBlock> blocks;
+	bool enabled;
+
+	static void addTrigrams(const char *text, size_t length, vector<unsigned int>& trigrams);
+	static void sortTrigrams(vector<unsigned int>& trigrams);
+	size_t findBlock(int line, int& firstLine);
+	void buildBlock(TrigramBlock& block, int firstLine, LineStore& store);
+	void maintain(int from, int to, LineStore& store);
+
+public:
+	TrigramIndex() : enabled(false) {}
+	bool isEnabled();
+	size_t getBlockCount();
+	size_t memoryUsage();
+	size_t getCandidates(const string& pattern, int start, int end, vector<pair<int, int>>& ranges);
+	void apply(const Change& change, LineStore& store);
+	void build(LineStore& store, ThreadPool& pool);
+	void clear();
+};
+
+#endif
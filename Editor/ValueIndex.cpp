@@ -0,0 +1,256 @@
+#include "ValueIndex.h"
+#include <algorithm>
+#include <climits>
+
+// The distance between the labels of lines appended at the end of the list.
+const unsigned long long ORDER_GAP = 1ull << 32;
+
+// How much fuller a range of labels twice as large may be before it is spread
+// out; the ranges are allowed (2 / 1.3)^bits lines.
+const double RELABEL_DENSITY = 2 / 1.3;
+
+/*
+	Every indexed line gets a label that grows along the list. Labels are spaced out
+	when the index is built, and a new line takes a label between those of its
+	neighbours, so positions can be compared without counting lines. When two
+	neighbours have no label left between them, the smallest aligned range of labels
+	around them that is sparse enough is spread out evenly (Bender et al., "Two
+	simplified algorithms for maintaining order in a list"), which costs O(log n)
+	relabels per insertion on average.
+
+	Lines are grouped by the hash of their value, ordered by label, so the first line
+	holding a value is the first entry of its group whose text matches. Entries stay
+	in place in their hash table, so the groups can point to them.
+*/
+
+/**
+	Indexes every line of a list.
+	@param first The first Node of the list.
+	@param size The number of Nodes in the list.
+*/
+ValueIndex::ValueIndex(Node *first, int size) {
+	unsigned long long spacing = min(ORDER_GAP, ULLONG_MAX / ((unsigned long long)size + 2));
+	unsigned long long label = 0;
+	Node *previous = NULL;
+
+	entries.reserve(size);
+	groups.reserve(size);
+
+	for (Node *node = first; node != NULL; node = node->next) {
+		ValueIndexEntry& entry = entries[node];
+
+		label += spacing;
+		entry.node = node;
+		entry.previous = previous;
+		entry.order = label;
+		entry.hash = hash(node->line.view());
+		groups[entry.hash].insert(&entry);
+		previous = node;
+	}
+}
+
+/**
+	FNV-1a hash, 64 bit.
+	@param value The text to hash.
+	@returns The hash.
+*/
+unsigned long long ValueIndex::hash(LineView value) {
+	unsigned long long result = 14695981039346656037ull;
+
+	for (size_t i = 0; i < value.size(); i++) {
+		result ^= (unsigned char)value[i];
+		result *= 1099511628211ull;
+	}
+
+	return result;
+}
+
+/**
+	Gets the label of an indexed line.
+	@param node The line.
+	@returns The label.
+*/
+unsigned long long ValueIndex::order(const Node *node) {
+	return entries.find(node)->second.order;
+}
+
+/**
+	Gets the memory held by the index, estimated from the size of its entries and
+	the bookkeeping of the containers holding them.
+	@returns The size of the index, in bytes.
+*/
+size_t ValueIndex::memoryUsage() {
+	// A hash table node holds its value and a link; a tree node holds its value,
+	// three links and a color.
+	size_t entryBytes = sizeof(pair<const Node*, ValueIndexEntry>) + sizeof(void*);
+	size_t groupBytes = sizeof(pair<unsigned long long, ValueGroup>) + sizeof(void*);
+	size_t memberBytes = sizeof(ValueIndexEntry*) + 4 * sizeof(void*);
+
+	return entries.size() * (entryBytes + memberBytes) + entries.bucket_count() * sizeof(void*)
+		+ groups.size() * groupBytes + groups.bucket_count() * sizeof(void*);
+}
+
+/**
+	Finds the first line holding a value.
+	@param value The value to look for.
+	@returns The line, or NULL if no line holds the value.
+*/
+Node* ValueIndex::find(LineView value) {
+	unordered_map<unsigned long long, ValueGroup>::iterator group = groups.find(hash(value));
+
+	if (group == groups.end()) {
+		return NULL;
+	}
+
+	// Values with the same hash share the group, so the text is compared too.
+	for (ValueGroup::iterator i = group->second.begin(); i != group->second.end(); ++i) {
+		if ((*i)->node->line.equals(value)) {
+			return (*i)->node;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+	Gets the line before an indexed line.
+	@param node The line.
+	@returns The line before it, or NULL if it is the first line.
+*/
+Node* ValueIndex::previous(const Node *node) {
+	return entries.find(node)->second.previous;
+}
+
+/**
+	Indexes a line that is about to be linked into the list. Its text must be set.
+	@param node The new line.
+	@param previous The line it will follow, or NULL if it will be the first line.
+	@param next The line it will precede, or NULL if it will be the last line.
+*/
+void ValueIndex::inserting(Node *node, Node *previous, Node *next) {
+	unsigned long long low = previous != NULL ? order(previous) : 0;
+	unsigned long long high = next != NULL ? order(next) : ULLONG_MAX;
+
+	if (high - low < 2) {
+		relabel(previous != NULL ? previous : next);
+		low = previous != NULL ? order(previous) : 0;
+		high = next != NULL ? order(next) : ULLONG_MAX;
+	}
+
+	// Lines appended one after the other get evenly spaced labels; any other line
+	// splits the room it is given in two.
+	unsigned long long label = low + (high - low) / 2;
+
+	if (next == NULL && high - low > 2 * ORDER_GAP) {
+		label = low + ORDER_GAP;
+	}
+
+	ValueIndexEntry& entry = entries[node];
+
+	entry.node = node;
+	entry.previous = previous;
+	entry.order = label;
+	entry.hash = hash(node->line.view());
+	groups[entry.hash].insert(&entry);
+
+	if (next != NULL) {
+		entries.find(next)->second.previous = node;
+	}
+}
+
+/**
+	Forgets a line that is about to be unlinked from the list. Its link to the next
+	line must still be set.
+	@param node The line.
+*/
+void ValueIndex::removing(Node *node) {
+	unordered_map<const Node*, ValueIndexEntry>::iterator entry = entries.find(node);
+
+	if (node->next != NULL) {
+		entries.find(node->next)->second.previous = entry->second.previous;
+	}
+
+	leaveGroup(&entry->second);
+	entries.erase(entry);
+}
+
+/**
+	Moves a line whose text was replaced to the group of its new value.
+	@param node The line.
+*/
+void ValueIndex::updated(Node *node) {
+	ValueIndexEntry& entry = entries.find(node)->second;
+	unsigned long long newHash = hash(node->line.view());
+
+	if (newHash == entry.hash) {
+		return;
+	}
+
+	leaveGroup(&entry);
+	entry.hash = newHash;
+	groups[newHash].insert(&entry);
+}
+
+/**
+	Takes a line out of the group of its value, dropping the group if it is left empty.
+	@param entry The line's entry.
+*/
+void ValueIndex::leaveGroup(ValueIndexEntry *entry) {
+	unordered_map<unsigned long long, ValueGroup>::iterator group = groups.find(entry->hash);
+
+	group->second.erase(entry);
+
+	if (group->second.empty()) {
+		groups.erase(group);
+	}
+}
+
+/**
+	Spreads out the labels around a line so that there is room for a new label on
+	both sides of it. Widens an aligned range of labels around the line until it is
+	sparse enough, then gives the lines in it evenly spaced labels.
+	@param anchor The line.
+*/
+void ValueIndex::relabel(Node *anchor) {
+	ValueIndexEntry *low = &entries.find(anchor)->second;
+	ValueIndexEntry *high = low;
+	unsigned long long label = low->order;
+	unsigned long long count = 1;
+	double limit = 1;
+
+	for (int bits = 1; bits <= 64; bits++) {
+		unsigned long long mask = bits < 64 ? (1ull << bits) - 1 : ULLONG_MAX;
+		unsigned long long from = label & ~mask;
+		ValueIndexEntry *entry;
+
+		while (low->previous != NULL && (entry = &entries.find(low->previous)->second)->order >= from) {
+			low = entry;
+			count++;
+		}
+
+		while (high->node->next != NULL && (entry = &entries.find(high->node->next)->second)->order - from <= mask) {
+			high = entry;
+			count++;
+		}
+
+		limit *= RELABEL_DENSITY;
+
+		if (bits < 64 && (count > limit || mask / (count + 1) < 2)) {
+			continue;
+		}
+
+		unsigned long long spacing = mask / (count + 1);
+
+		for (entry = low, label = from + spacing; ; label += spacing) {
+			entry->order = label;
+
+			if (entry == high) {
+				break;
+			}
+
+			entry = &entries.find(entry->node->next)->second;
+		}
+
+		return;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef VALUEINDEX_H
+#define VALUEINDEX_H
+
+#include "LineView.h"
+#include "Node.h"
+#include <set>
+#include <unordered_map>
+
+using namespace std;
+
+struct ValueIndexEntry
+{
+public:
+	ValueIndexEntry() : node(NULL), previous(NULL), order(0), hash(0) {}
+
+	Node *node;
+	Node *previous;
+	// Grows along the list, so comparing two labels compares two positions.
+	unsigned long long order;
+	unsigned long long hash;
+};
+
+struct ValueIndexOrder
+{
+public:
+	bool operator()(const ValueIndexEntry *a, const ValueIndexEntry *b) const {
+		return a->order < b->order;
+	}
+};
+
+// The entries of the lines holding one hash of a value, in list order. Relabelling
+// keeps the order of the lines, so labels are changed in place.
+typedef set<ValueIndexEntry*, ValueIndexOrder> ValueGroup;
+
+/**
+	Finds the first line of a StringLinkedList holding a given value without walking
+	the list, and the line before any indexed line, so that the list can unlink it.
+	The list tells the index about every line it links, unlinks or changes.
+*/
+class ValueIndex
+{
+private:
+	unordered_map<const Node*, ValueIndexEntry> entries;
+	unordered_map<unsigned long long, ValueGroup> groups;
+
+	static unsigned long long hash(LineView value);
+	unsigned long long order(const Node *node);
+	void leaveGroup(ValueIndexEntry *entry);
+	void relabel(Node *anchor);
+
+public:
+	ValueIndex(Node *first, int size);
+	size_t memoryUsage();
+	Node* find(LineView value);
+	Node* previous(const Node *node);
+	void inserting(Node *node, Node *previous, Node *next);
+	void removing(Node *node);
+	void updated(Node *node);
+};
+
+#endif
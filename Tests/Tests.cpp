@@ -0,0 +1,698 @@
+#include "BlockCodec.h"
+#include "Editor.h"
+#include "Journal.h"
+#include "LineStore.h"
+#include "PagedLineStore.h"
+#include "StringLinkedList.h"
+#include "TextArena.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const char *INPUT_PATH = "tests_input.tmp";
+const char *OUTPUT_PATH = "tests_output.tmp";
+const char *PASTE_PATH = "tests_paste.tmp";
+
+const StoreType STORE_TYPES[] = { LINKED_LIST_STORE, ROPE_STORE, PAGED_STORE, COMPRESSED_STORE };
+const char *STORE_NAMES[] = { "list", "rope", "paged", "compressed" };
+const int NUM_STORE_TYPES = sizeof(STORE_TYPES) / sizeof(STORE_TYPES[0]);
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+/**
+	Counts a check, reporting it if it failed.
+	@param passed The outcome of the check.
+	@param test The name of the test making the check.
+	@param description What was checked.
+*/
+static void check(bool passed, const string& test, const string& description) {
+	numChecks++;
+
+	if (!passed) {
+		cerr << "FAILED " << test << " : " << description << endl;
+		numFailures++;
+	}
+}
+
+/**
+	Replaces the contents of a file.
+	@param path The path of the file.
+	@param text The new contents.
+*/
+static void writeFile(const char *path, const string& text) {
+	ofstream out(path, ios::out | ios::binary | ios::trunc);
+
+	out << text;
+}
+
+/**
+	Reads a whole file.
+	@param path The path of the file.
+	@returns The contents, or an empty string if the file could not be read.
+*/
+static string readFile(const char *path) {
+	ifstream in(path, ios::in | ios::binary);
+	stringstream text;
+
+	text << in.rdbuf();
+	return text.str();
+}
+
+/**
+	Edits a file in batch mode, as --batch does, and removes the files it made.
+	@param input The contents of the file to edit.
+	@param script The commands to apply.
+	@param storeType The store to hold the lines in.
+	@returns The contents of the output file.
+*/
+static string runBatch(const string& input, const string& script, StoreType storeType) {
+	string output;
+
+	writeFile(INPUT_PATH, input);
+	remove(OUTPUT_PATH);
+
+	{
+		Editor editor(INPUT_PATH, OUTPUT_PATH, storeType, STREAM_LOAD);
+		istringstream commands(script);
+
+		editor.runScript(commands);
+	}
+
+	output = readFile(OUTPUT_PATH);
+	remove(INPUT_PATH);
+	remove(OUTPUT_PATH);
+	remove((string(INPUT_PATH) + ".journal").c_str());
+
+	return output;
+}
+
+/**
+	Checks that the line following I, S and A commands in a script is taken as their
+	text even when their position is invalid, rather than run as a command.
+*/
+static void testBatchPayloads() {
+	const string input = "one\ntwo\nthree\nfour\nfive";
+
+	writeFile(PASTE_PATH, input);
+
+	for (int i = 0; i < NUM_STORE_TYPES; i++) {
+		string test = string("batch payloads (") + STORE_NAMES[i] + ")";
+
+		check(runBatch(input, "I 9\nD 1 3\nS 42\nE\n", STORE_TYPES[i]) == input, test,
+			"text of an insertion or substitution out of range is not run");
+		check(runBatch("", string("S\nA 0\n") + PASTE_PATH + "\nE\n", STORE_TYPES[i]).empty(), test,
+			"text of a substitution in an empty buffer is not run");
+		check(runBatch(input, "A 9\nD 1 4\nE\n", STORE_TYPES[i]) == input, test,
+			"path of a paste out of range is not run");
+		check(runBatch(input, "I 2\nD 1 3\nE\n", STORE_TYPES[i]) == "one\nD 1 3\ntwo\nthree\nfour\nfive", test,
+			"text of a valid insertion is inserted");
+	}
+
+	remove(PASTE_PATH);
+}
+
+/**
+	Checks that a script whose buffer can't be saved fails, so that the process exits
+	with an error, and that one saved successfully doesn't.
+*/
+static void testBatchSaveFailure() {
+	const string test = "batch save failure";
+	const char *missingPath = "tests_missing_directory/output.tmp";
+	const string journalPath = string(INPUT_PATH) + ".journal";
+	string scripts[] = { "S 1\nchanged\n", "S 1\nchanged\nE\n" };
+
+	for (int i = 0; i < 2; i++) {
+		writeFile(INPUT_PATH, "one\ntwo");
+
+		{
+			Editor editor(INPUT_PATH, missingPath, ROPE_STORE, STREAM_LOAD);
+			istringstream commands(scripts[i]);
+
+			check(editor.runScript(commands) > 0, test, i == 0 ? "a failed save at the end of a script is counted" :
+				"a failed save by E is counted");
+		}
+		remove(journalPath.c_str());
+
+		{
+			Editor editor(INPUT_PATH, OUTPUT_PATH, ROPE_STORE, STREAM_LOAD);
+			istringstream commands(scripts[i]);
+
+			check(editor.runScript(commands) == 0, test, "a successful save is not counted");
+		}
+		check(readFile(OUTPUT_PATH) == "changed\ntwo", test, "the buffer is saved");
+		remove(journalPath.c_str());
+		remove(OUTPUT_PATH);
+	}
+
+	remove(INPUT_PATH);
+}
+
+/**
+	Checks that saving a file in place replaces its contents without touching a file
+	named like a temporary file, and keeps its permissions and the link it was saved
+	through on POSIX systems.
+*/
+static void testSaveInPlace() {
+	const string test = "save in place";
+	const string tempPath = string(INPUT_PATH) + ".tmp";
+	const string journalPath = string(INPUT_PATH) + ".journal";
+
+	writeFile(INPUT_PATH, "one\ntwo");
+	writeFile(tempPath.c_str(), "a file of the user's");
+
+	{
+		Editor editor(INPUT_PATH, INPUT_PATH, ROPE_STORE, STREAM_LOAD);
+		istringstream commands("S 1\nchanged\n");
+
+		check(editor.runScript(commands) == 0, test, "the file is saved");
+	}
+	check(readFile(INPUT_PATH) == "changed\ntwo", test, "the file holds the new contents");
+	check(readFile(tempPath.c_str()) == "a file of the user's", test, "a file named like the temporary file is kept");
+
+#ifndef _WIN32
+	const char *linkPath = "tests_link.tmp";
+	struct stat status;
+
+	chmod(INPUT_PATH, 0754);
+	remove(linkPath);
+	check(symlink(INPUT_PATH, linkPath) == 0, test, "a link to the file is made");
+
+	{
+		Editor editor(linkPath, linkPath, ROPE_STORE, STREAM_LOAD);
+		istringstream commands("S 2\nthrough the link\n");
+
+		check(editor.runScript(commands) == 0, test, "the file is saved through the link");
+	}
+	check(readFile(INPUT_PATH) == "changed\nthrough the link", test, "the file linked to holds the new contents");
+	check(lstat(linkPath, &status) == 0 && S_ISLNK(status.st_mode), test, "the link is kept");
+	check(stat(INPUT_PATH, &status) == 0 && (status.st_mode & 07777) == 0754, test, "the permissions are kept");
+	remove(linkPath);
+	remove((string(linkPath) + ".journal").c_str());
+#endif
+
+	remove(journalPath.c_str());
+	remove(tempPath.c_str());
+	remove(INPUT_PATH);
+}
+
+/**
+	Makes a change replacing lines.
+	@param position The position of the first line replaced.
+	@param removed The lines replaced.
+	@param inserted The new lines.
+	@returns The change.
+*/
+static Change makeChange(int position, const vector<string>& removed, const vector<string>& inserted) {
+	Change change;
+
+	change.position = position;
+	change.removed = removed;
+	change.inserted = inserted;
+	return change;
+}
+
+/**
+	Loads the input file and replays its journal onto it, as opening it does.
+	@param numChanges Receives the number of changes replayed.
+	@returns The lines once replayed, separated by line breaks.
+*/
+static string replayJournal(int& numChanges) {
+	LineStore *store = LineStore::create(ROPE_STORE);
+	istringstream input(readFile(INPUT_PATH));
+	vector<string> lines;
+	string line;
+	string text;
+
+	while (getline(input, line)) {
+		store->add(line);
+	}
+
+	{
+		Journal journal;
+
+		numChanges = journal.recover(INPUT_PATH, *store);
+	}
+
+	store->getRange(0, store->size(), lines);
+	delete store;
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		text += (i > 0 ? "\n" : "") + lines[i];
+	}
+	return text;
+}
+
+/**
+	Writes a journal of two changes to the input file, as a session that did not end
+	normally leaves it: the first line is replaced, and a line is appended.
+	@param input The contents of the input file.
+*/
+static void writeJournal(const string& input) {
+	Journal journal;
+
+	writeFile(INPUT_PATH, input);
+	remove((string(INPUT_PATH) + ".journal").c_str());
+
+	journal.recover(INPUT_PATH, *unique_ptr<LineStore>(LineStore::create(ROPE_STORE)));
+	journal.append(makeChange(0, vector<string>(1, "one"), vector<string>(1, "uno")));
+	journal.append(makeChange(3, vector<string>(), vector<string>(1, "four")));
+}
+
+/**
+	Checks that the changes in a journal are replayed onto the file they were made
+	to, up to a record that was cut short or corrupted, and never onto another file;
+	that saving over the input keeps only the changes made since; and that scripts
+	don't open files with changes to recover unless allowed to.
+*/
+static void testJournalRecovery() {
+	const string test = "journal recovery";
+	const string input = "one\ntwo\nthree";
+	const string journalPath = string(INPUT_PATH) + ".journal";
+	string journal;
+	int numChanges;
+
+	writeJournal(input);
+	check(Journal::hasChanges(INPUT_PATH), test, "the journal holds changes");
+	check(replayJournal(numChanges) == "uno\ntwo\nthree\nfour" && numChanges == 2, test, "every change is replayed");
+	check(replayJournal(numChanges) == "uno\ntwo\nthree\nfour" && numChanges == 2, test,
+		"replaying leaves the journal as it was");
+
+	writeJournal(input);
+	journal = readFile(journalPath.c_str());
+	writeFile(journalPath.c_str(), journal.substr(0, journal.size() - 3));
+	check(replayJournal(numChanges) == "uno\ntwo\nthree" && numChanges == 1, test,
+		"a record cut short ends the replay");
+	check(readFile(journalPath.c_str()).size() < journal.size() - 3, test, "the record cut short is dropped");
+
+	{
+		Journal session;
+
+		session.recover(INPUT_PATH, *unique_ptr<LineStore>(LineStore::create(ROPE_STORE)));
+		session.append(makeChange(1, vector<string>(1, "two"), vector<string>(1, "dos")));
+	}
+	check(replayJournal(numChanges) == "uno\ndos\nthree" && numChanges == 2, test,
+		"changes made after a record cut short are replayed");
+
+	writeJournal(input);
+	journal = readFile(journalPath.c_str());
+	journal[journal.size() - 6] ^= 1;
+	writeFile(journalPath.c_str(), journal);
+	check(replayJournal(numChanges) == "uno\ntwo\nthree" && numChanges == 1, test,
+		"a record failing its checksum ends the replay");
+
+	writeJournal(input);
+	writeFile(INPUT_PATH, "ONE\ntwo\nthree");
+	check(!Journal::hasChanges(INPUT_PATH), test, "a journal of another file holds no changes for this one");
+	check(replayJournal(numChanges) == "ONE\ntwo\nthree" && numChanges == 0, test,
+		"a journal of another file is not replayed");
+
+	writeFile(INPUT_PATH, input);
+	remove(journalPath.c_str());
+
+	{
+		Journal session;
+		long long checkpoint;
+
+		session.recover(INPUT_PATH, *unique_ptr<LineStore>(LineStore::create(ROPE_STORE)));
+		session.append(makeChange(0, vector<string>(1, "one"), vector<string>(1, "uno")));
+		checkpoint = session.checkpoint();
+		// made while the save runs, so not in the saved file
+		session.append(makeChange(3, vector<string>(), vector<string>(1, "four")));
+		writeFile(INPUT_PATH, "uno\ntwo\nthree");
+		session.rebase(checkpoint);
+	}
+	check(replayJournal(numChanges) == "uno\ntwo\nthree\nfour" && numChanges == 1, test,
+		"saving over the input keeps only the changes made since the checkpoint");
+
+	writeJournal(input);
+
+	for (int allowed = 0; allowed < 2; allowed++) {
+		writeFile(OUTPUT_PATH, "main");
+		remove((string(OUTPUT_PATH) + ".journal").c_str());
+
+		{
+			Editor editor(OUTPUT_PATH, OUTPUT_PATH, ROPE_STORE, STREAM_LOAD);
+			istringstream commands(string("O\n") + INPUT_PATH + "\nS 1\nchanged\nE\n");
+
+			editor.setBatchRecovery(allowed != 0);
+			editor.runScript(commands);
+		}
+
+		if (allowed) {
+			check(readFile(OUTPUT_PATH) == "main" && readFile(INPUT_PATH) == "changed\ntwo\nthree\nfour", test,
+				"a script allowed to recover opens the file and replays its journal");
+		}
+		else {
+			check(readFile(OUTPUT_PATH) == "changed" && readFile(INPUT_PATH) == input, test,
+				"a script does not open a file whose journal holds changes");
+			check(Journal::hasChanges(INPUT_PATH), test, "the journal of a file not opened is kept");
+		}
+	}
+
+	remove(journalPath.c_str());
+	remove((string(OUTPUT_PATH) + ".journal").c_str());
+	remove(INPUT_PATH);
+	remove(OUTPUT_PATH);
+}
+
+/**
+	Checks that copies of lines share their text with the lines copied, and that the
+	text lasts until the last line referring to it is gone, whichever goes first.
+*/
+static void testSharedCopies() {
+	const string text = "a line too long to be stored in place, number ";
+	const int numLines = 10;
+	TextArena arena;
+	const char *stored = arena.store(text.data(), text.size());
+
+	arena.share(stored);
+	arena.release(stored, text.size());
+	check(arena.getLiveBytes() == text.size(), "shared copies", "shared text outlives one of its lines");
+	arena.release(stored, text.size());
+	check(arena.getLiveBytes() == 0, "shared copies", "shared text is released with its last line");
+
+	for (int i = 0; i < NUM_STORE_TYPES; i++) {
+		string test = string("shared copies (") + STORE_NAMES[i] + ")";
+		LineStore *store = LineStore::create(STORE_TYPES[i]);
+		LineStore *sibling = store->createSibling();
+		bool copied = true;
+
+		for (int j = 0; j < numLines; j++) {
+			store->add(text + to_string(j));
+		}
+
+		LineStore *block = store->copy(2, 5);
+
+		sibling->paste(0, *block);
+		delete block;
+		store->updateValue(2, "changed after the copy, and long enough to be stored");
+		check(sibling->get(0) == text + "2", test, "changing a line leaves its copy alone");
+
+		// the text freed by the original lines is stored over if it was released
+		store->deleteRange(0, store->size());
+		for (int j = 0; j < numLines; j++) {
+			store->add(string(text.size() + 10, 'x'));
+		}
+		delete store;
+
+		for (int j = 0; j < 5; j++) {
+			copied = copied && sibling->get(j) == text + to_string(j + 2);
+		}
+		check(sibling->size() == 5 && copied, test, "copies outlive the lines copied and their store");
+
+		sibling->deleteRange(0, sibling->size());
+		check(sibling->size() == 0, test, "copies can be deleted");
+
+		// a copy of a line pointing into a file must not point into it too
+		string file = text + "in a file\n";
+
+		sibling->addView(file.data(), file.size() - 1);
+		block = sibling->copy(0, 1);
+		file.assign(file.size(), 'x');
+		check(block->get(0) == text + "in a file", test, "copies of views own their text");
+		delete block;
+		delete sibling;
+	}
+}
+
+/**
+	Makes text that does not compress, the same for every run.
+	@param length The number of characters.
+	@param seed Picks the text.
+	@returns The text.
+*/
+static string noise(size_t length, unsigned int seed) {
+	string text(length, '\0');
+
+	for (size_t i = 0; i < length; i++) {
+		seed = seed * 1103515245u + 12345u;
+		text[i] = (char)(seed >> 23);
+	}
+	return text;
+}
+
+/**
+	Compresses a text and restores it.
+	@param text The text.
+	@param packed Receives the compressed block.
+	@returns True if the text was restored as it was.
+*/
+static bool roundTrip(const string& text, string& packed) {
+	string restored = "left over";
+
+	BlockCodec::compress(text.data(), text.size(), packed);
+	return BlockCodec::decompress(packed, restored) && restored == text;
+}
+
+/**
+	Makes a compressed block by hand: the size of the text, then the sequences.
+	@param size The size of the text.
+	@param sequences The token, literals, distance and length bytes.
+	@returns The block.
+*/
+static string makeBlock(unsigned int size, const string& sequences) {
+	return string((const char*)&size, sizeof(size)) + sequences;
+}
+
+/**
+	Checks that the codec restores what it compressed, whatever the lengths of the
+	literals and matches and however far back matches are, and that it rejects
+	blocks that are cut short or point outside the text instead of reading or
+	writing past them.
+*/
+static void testBlockCodec() {
+	const string test = "block codec";
+	const size_t lengths[] = { 0, 1, 4, 12, 13, 14, 15, 16, 29, 254, 255, 256, 269, 270, 271, 1000 };
+	const string repeat = "a repeat of sixty four characters, found again far back........";
+	string packed;
+	string restored;
+	bool restoredAll = true;
+	size_t farPacked;
+
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		restoredAll = roundTrip(noise(lengths[i], (unsigned int)i), packed) && restoredAll;
+		restoredAll = roundTrip(string(lengths[i], 'a'), packed) && restoredAll;
+		restoredAll = roundTrip(noise(lengths[i], 7) + "abcd" + noise(lengths[i], 7), packed) && restoredAll;
+	}
+	check(restoredAll, test, "runs of literals and matches of every length class are restored");
+
+	check(roundTrip(string(), packed) && packed.size() == 5, test, "an empty text is restored");
+	check(roundTrip(string(100000, 'x'), packed) && packed.size() < 1000, test,
+		"a match overlapping the bytes it produces is restored");
+	check(roundTrip(noise(300, 1) + string(600, '=') + noise(300, 1), packed) && packed.size() < 700, test,
+		"literals and matches longer than 255 are restored");
+
+	// the filler is a single match, so the hash of the repeat is still found at its start
+	check(roundTrip(repeat + string(65535 - repeat.size(), 'z') + repeat + "tail", packed), test,
+		"a match at the largest distance is restored");
+	farPacked = packed.size();
+	check(roundTrip(repeat + string(65536 - repeat.size(), 'z') + repeat + "tail", packed), test,
+		"a repeat beyond the largest distance is restored");
+	check(farPacked + repeat.size() / 2 < packed.size(), test,
+		"a match is used at the largest distance and not beyond");
+
+	BlockCodec::compress(repeat.data(), repeat.size(), packed);
+	check(!BlockCodec::decompress(packed.substr(0, 3), restored), test, "a block without its size is rejected");
+	check(!BlockCodec::decompress(packed.substr(0, packed.size() - 1), restored), test,
+		"a block cut short is rejected");
+	check(!BlockCodec::decompress(makeBlock(4, string(1, '\x50') + "abc"), restored), test,
+		"literals past the end of the block are rejected");
+	check(!BlockCodec::decompress(makeBlock(3, string(1, '\x40') + "abcd"), restored), test,
+		"literals past the size of the text are rejected");
+	check(!BlockCodec::decompress(makeBlock(8, string(1, '\x10') + "a" + string(2, '\0') + string(1, '\0')), restored),
+		test, "a match at distance 0 is rejected");
+	check(!BlockCodec::decompress(makeBlock(8, string(1, '\x10') + "a\x02" + string(1, '\0') + string(1, '\0')), restored),
+		test, "a match before the start of the text is rejected");
+	check(!BlockCodec::decompress(makeBlock(4, string(1, '\x10') + "a\x01" + string(1, '\0') + string(1, '\0')), restored),
+		test, "a match past the size of the text is rejected");
+	check(!BlockCodec::decompress(makeBlock(1000, string(1, '\xf0') + "\xff"), restored), test,
+		"a length cut short is rejected");
+	check(!BlockCodec::decompress(makeBlock(1000000, string(1, '\x10') + "a"), restored), test,
+		"a size no block this small can hold is rejected");
+	check(!BlockCodec::decompress(makeBlock(8, string(1, '\x40') + "abcd"), restored), test,
+		"a block ending before the size of the text is rejected");
+
+	// damaged blocks are rejected or restored to something, but never read or written past
+	BlockCodec::compress((noise(500, 5) + string(500, 'b') + noise(500, 5)).data(), 1500, packed);
+	for (size_t i = 0; i < packed.size(); i++) {
+		string damaged = packed;
+
+		damaged[i] ^= (char)(1 << (i % 8));
+		BlockCodec::decompress(damaged, restored);
+	}
+	check(true, test, "damaged blocks are read safely");
+}
+
+/**
+	Checks that a list with a value index finds, inserts and deletes the same lines
+	as one without, through random edits, some of them in bursts at one position so
+	that the labels there run out and have to be spread out again.
+*/
+static void testValueIndex() {
+	const string test = "value index";
+	const string values[] = { "alpha", "beta", "gamma", "a value long enough to be stored in the arena" };
+	const int numValues = sizeof(values) / sizeof(values[0]);
+	const int numSteps = 5000;
+	StringLinkedList indexed;
+	StringLinkedList plain;
+	vector<string> indexedLines;
+	vector<string> plainLines;
+	unsigned int seed = 12345;
+	int firstMismatch = -1;
+
+	indexed.setValueIndex(true);
+
+	for (int step = 0; step < numSteps && firstMismatch < 0; step++) {
+		seed = seed * 1103515245u + 12345u;
+
+		unsigned int choice = (seed >> 16) % 100;
+		int size = plain.size();
+		// half of the edits land at the front or next to the middle line
+		int index = (seed >> 8) % 2 == 0 ? (int)((seed >> 4) % (size + 1)) : ((seed >> 12) % 2 == 0 ? 0 : size / 2);
+		string value = values[(seed >> 20) % numValues] + (choice % 3 == 0 ? "" : to_string(step % 7));
+
+		if (choice < 2) {
+			// each line splits the room left before the last one in two
+			for (int i = 0; i < 80; i++) {
+				indexed.insertAt(index, values[i % numValues]);
+				plain.insertAt(index, values[i % numValues]);
+			}
+		}
+		else if (choice < 35) {
+			indexed.insertAt(index, value);
+			plain.insertAt(index, value);
+		}
+		else if (choice < 55) {
+			string after = values[(seed >> 24) % numValues] + to_string((seed >> 26) % 7);
+
+			indexed.insertAfterValue(after, value);
+			plain.insertAfterValue(after, value);
+		}
+		else if (choice < 70) {
+			indexed.deleteValue(value);
+			plain.deleteValue(value);
+		}
+		else if (choice < 80) {
+			int count = (int)((seed >> 2) % 6);
+
+			indexed.deleteRange(index, count);
+			plain.deleteRange(index, count);
+		}
+		else if (choice < 90) {
+			indexed.updateValue(index, value);
+			plain.updateValue(index, value);
+		}
+		else if (choice < 99) {
+			indexed.deleteNode(index);
+			plain.deleteNode(index);
+		}
+		else {
+			// rebuilt from scratch over whatever the list holds now
+			indexed.setValueIndex(false);
+			indexed.setValueIndex(true);
+		}
+
+		indexed.getRange(0, indexed.size(), indexedLines);
+		plain.getRange(0, plain.size(), plainLines);
+
+		if (indexedLines != plainLines) {
+			firstMismatch = step;
+		}
+	}
+
+	check(firstMismatch < 0, test, "every edit leaves the same lines as without the index" +
+		(firstMismatch < 0 ? string() : ", until step " + to_string(firstMismatch)));
+	check(indexed.hasValueIndex() && indexed.valueIndexMemoryUsage() > 0, test, "the index is kept through the edits");
+
+	for (int i = 0; i < numValues; i++) {
+		indexed.deleteValue(values[i]);
+		plain.deleteValue(values[i]);
+	}
+	indexed.deleteRange(0, indexed.size() / 2);
+	plain.deleteRange(0, plain.size() / 2);
+	indexed.getRange(0, indexed.size(), indexedLines);
+	plain.getRange(0, plain.size(), plainLines);
+	check(indexedLines == plainLines, test, "the lines left after deleting half of them match");
+}
+
+/**
+	Checks that reading every line of a paged store, the ways searches, replacements
+	and saves do, keeps the lines in memory within the budget. The page in use may
+	go over it, and so may the lines of the pages seen through the window of views
+	being read.
+	@param compress Whether evicted pages are compressed rather than swapped.
+*/
+static void testPagedScanMemory(bool compress) {
+	const size_t limit = 1024 * 1024;
+	const int numLines = 200000;
+	const string test = compress ? "compressed scan memory" : "paged scan memory";
+	const string text = "a line long enough to live on the heap, number ";
+	size_t pageBytes = 2 * PAGE_LINES * (sizeof(string) + text.size() + 8);
+	PagedLineStore store(limit, compress);
+	vector<LineSpan> spans;
+	LineSnapshot snapshot;
+	ostringstream output;
+	size_t peak = 0;
+
+	for (int i = 0; i < numLines; i++) {
+		store.add(text + to_string(i));
+	}
+	store.expireViews();
+
+	store.visit(0, numLines, [&](int, LineView) {
+		peak = max(peak, store.getResidentBytes());
+		return true;
+	});
+	check(peak <= limit + pageBytes, test, "a visit stays within the budget");
+
+	peak = 0;
+	for (int i = 0; i < numLines; i++) {
+		store.get(i);
+		peak = max(peak, store.getResidentBytes());
+	}
+	check(peak <= limit + pageBytes, test, "reading every line with get stays within the budget");
+
+	peak = 0;
+	for (int first = 0; first < numLines; first += PAGE_LINES) {
+		store.getSpans(first, PAGE_LINES, spans);
+		peak = max(peak, store.getResidentBytes());
+		store.expireViews();
+	}
+	check(peak <= limit + 3 * pageBytes, test, "windows of views expired in turn stay within the budget");
+
+	store.snapshot(snapshot);
+	check(store.getResidentBytes() <= limit + pageBytes, test, "a snapshot stays within the budget");
+
+	output << store;
+	check(store.getResidentBytes() <= limit + pageBytes, test, "writing the lines stays within the budget");
+	check(snapshot.lines.size() == (size_t)numLines && output.str().size() > numLines * text.size(), test,
+		"every line was read");
+}
+
+int main() {
+	testBatchPayloads();
+	testBatchSaveFailure();
+	testSaveInPlace();
+	testJournalRecovery();
+	testSharedCopies();
+	testBlockCodec();
+	testValueIndex();
+	testPagedScanMemory(false);
+	testPagedScanMemory(true);
+
+	cerr << numChecks - numFailures << " of " << numChecks << " checks passed" << endl;
+
+	return numFailures == 0 ? 0 : 1;
+}